@@ -29,6 +29,9 @@
 #cmakedefine HAVE_GETOPT_H
 #cmakedefine HAVE_STDINT_H
 #cmakedefine HAVE_GRP_H
+#cmakedefine HAVE_SYS_SENDFILE_H
+#cmakedefine HAVE_SYS_UIO_H
+#cmakedefine HAVE_SYS_EPOLL_H
 
 
 /* functions */
@@ -108,6 +111,10 @@
 #cmakedefine HAVE_GETGROUPS
 #cmakedefine HAVE_REALPATH
 #cmakedefine HAVE_MEMMEM
+#cmakedefine HAVE_SENDFILE
+#cmakedefine HAVE_ACCEPT4
+#cmakedefine HAVE_RECVMMSG
+#cmakedefine HAVE_SENDMMSG
 #cmakedefine HAVE_GETHOSTBYADDR_R
 #cmakedefine HAVE_GETHOSTBYNAME_R
 #cmakedefine HAVE_STRTOIMAX
@@ -74,6 +74,9 @@ static const char* exec_class_name = 0;
 // time zone to set after initialization
 const char* cmd_zone = 0;
 
+// maximum number of idle pthreads kept for the background operator (0 = no pooling)
+static unsigned bg_pool_max = 0;
+
 // show module errors
 static bool show_mod_errs = false;
 
@@ -110,6 +113,8 @@ static const char helpstr[] =
    "  -a, --show-aliases           displays the list of character sets aliases\n"
    "  -b, --disable-signals        disables signal handling\n"
    "  -B, --show-build-options     show Qore build options and quit\n"
+   "      --background-pool=arg    keep up to arg idle threads for reuse by the\n"
+   "                               background operator\n"
    "  -c, --charset=arg            sets default character set encoding\n"
    "  -D, --define=arg             sets the value of a parse define\n"
    "  -e, --exec=arg               execute program given on command-line\n"
@@ -452,6 +457,16 @@ static void set_time_zone(const char* arg) {
    cmd_zone = arg;
 }
 
+static void set_background_pool(const char* arg) {
+   char* end;
+   long n = strtol(arg, &end, 10);
+   if (*end || n < 0) {
+      fprintf(stderr, "invalid argument for --background-pool: '%s'; expecting a non-negative integer\n", arg);
+      exit(1);
+   }
+   bg_pool_max = (unsigned)n;
+}
+
 static void set_define(const char* carg) {
    QoreString str(carg);
    // trim trailing and leading whitespace
@@ -646,6 +661,7 @@ static struct opt_struct_s {
    { 'X', "eval",                  ARG_MAND, set_eval_arg },
    { 'Y', "no-network",            ARG_NONE, do_no_network },
    { 'z', "time-zone",             ARG_MAND, set_time_zone },
+   { '\0', "background-pool",      ARG_MAND, set_background_pool },
    { '\0', "no-terminal-io",       ARG_NONE, do_no_terminal_io },
    { '\0', "no-gui",               ARG_NONE, do_no_gui },
    { '\0', "no-io",                ARG_NONE, do_no_io },
@@ -886,6 +902,10 @@ int qore_main_intern(int argc, char* argv[], int other_po) {
    // initialize Qore subsystem
    qore_init(license, def_charset, show_mod_errs, qore_lib_options);
 
+   // enable background thread pooling if requested
+   if (bg_pool_max)
+      qore_set_background_thread_pool(bg_pool_max);
+
    ExceptionSink wsink, xsink;
    {
       QoreProgramHelper qpgm(parse_options, xsink);
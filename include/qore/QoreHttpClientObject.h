@@ -43,6 +43,7 @@
 #define HTTPCLIENT_DEFAULT_MAX_REDIRECTS 5         //!< maximum number of HTTP redirects allowed
 
 class Queue;
+class QoreFile;
 
 //! provides a way to communicate with HTTP servers using Qore data structures
 /** thread-safe, uses QoreSocket for socket communication
@@ -242,6 +243,12 @@ public:
 
    DLLEXPORT void sendWithRecvCallback(const char* meth, const char* mpath, const QoreHashNode* headers, const void* data, unsigned size, bool getbody, QoreHashNode* info, int timeout_ms, const ResolvedCallReferenceNode* recv_callback, QoreObject* obj, ExceptionSink* xsink);
 
+   //! sends an HTTP request and writes the response body to the given file as it is received, decompressing it if necessary; the body is never held in memory
+   /** error responses are not written to the file; they raise an exception as with send()
+       @return the response headers as a hash, caller owns the QoreHashNode reference returned (0 if there was an error)
+   */
+   DLLEXPORT QoreHashNode* sendToFile(const char* meth, const char* mpath, const QoreHashNode* headers, const void* data, unsigned size, QoreFile* file, QoreHashNode* info, int timeout_ms, ExceptionSink* xsink);
+
    DLLEXPORT void sendWithCallbacks(const char* meth, const char* mpath, const QoreHashNode* headers, const ResolvedCallReferenceNode* send_callback, bool getbody, QoreHashNode* info, int timeout_ms, const ResolvedCallReferenceNode* recv_callback, QoreObject* obj, ExceptionSink* xsink);
 
    //! sends an HTTP "GET" method and returns the value of the message body returned, the caller owns the AbstractQoreNode reference returned
@@ -319,6 +326,18 @@ public:
    //! returns the value of the TCP_NODELAY flag on the object
    DLLEXPORT bool getNoDelay() const;
 
+   //! sets whether content-encoded message bodies are decompressed before being passed to receive callbacks
+   DLLEXPORT void setRecvDecompression(bool b);
+
+   //! returns true if content-encoded message bodies are decompressed before being passed to receive callbacks
+   DLLEXPORT bool getRecvDecompression() const;
+
+   //! sets whether non-chunked message bodies are passed to receive callbacks in blocks as they are read instead of in one call
+   DLLEXPORT void setRecvStreaming(bool b);
+
+   //! returns true if non-chunked message bodies are passed to receive callbacks in blocks as they are read
+   DLLEXPORT bool getRecvStreaming() const;
+
    //! returns the connection status of the object
    DLLEXPORT bool isConnected() const;
 
@@ -344,6 +344,19 @@ public:
    */
    DLLEXPORT QoreListNode* sortDescendingStable(const ResolvedCallReferenceNode* fr, ExceptionSink* xsink) const;
 
+   //! returns a new list based on a stable sort of the source list ("this") by the keys returned by the passed function reference
+   /** the function reference is executed once for each element to get its sort key; the keys are then compared natively using
+       "soft" comparisons as with OP_LOG_LT, and elements with no key are sorted last; large lists with integer, float or string keys
+       are sorted in parallel threads
+       @param fr the function reference to be executed with each element to get its sort key
+       @param descending if true the list is sorted in descending order
+       @param max_threads the maximum number of threads to use for sorting; 0 means the number of online CPUs and 1 disables parallel sorting
+       @param xsink if an error occurs, the Qore-language exception information will be added here
+
+       @since %Qore 0.8.12
+   */
+   DLLEXPORT QoreListNode* sortBy(const ResolvedCallReferenceNode* fr, bool descending, int max_threads, ExceptionSink* xsink) const;
+
    //! returns the element having the lowest value (determined by calling OP_LOG_LT - the less-than "<" operator)
    /** so "soft" comparisons are made, meaning that the list can be made up of different types, and, as long
        as the comparisons are meaningful, the minimum value can be returned
@@ -39,9 +39,20 @@
 class QoreThreadLock;
 
 //! provides atomic reference counting to Qore objects
+/** when the library is built with QORE_BIASED_REFCOUNT (configure --enable-biased-refcount), references
+    made by the thread that created the object are counted in a non-atomic counter, and only references
+    from other threads use atomic operations; the object's layout changes in this case, so modules must be
+    built with the same setting (it is exported in the qore.pc and QoreConfig.cmake compiler flags)
+ */
 class QoreReferenceCounter {
 protected:
    mutable int references;
+#ifdef QORE_BIASED_REFCOUNT
+   //! atomic count of references held by threads other than the owner, shifted left by one; the low bit is set once the owner's count has been merged
+   mutable int shared_references;
+   //! the ID of the owning thread (thread generation in the high 32 bits, TID in the low), -1 if no thread owns the biased count
+   mutable int64 owner_id;
+#endif
 #ifndef HAVE_ATOMIC_MACROS
    //! pthread lock to ensure atomicity of updates for architectures where we don't have an atomic increment and decrement implementation
    mutable QoreThreadLock mRO;
@@ -59,16 +70,26 @@ public:
       @return returns the current reference count
    */
    DLLLOCAL int reference_count() const { 
+#ifdef QORE_BIASED_REFCOUNT
+      return references + (shared_references >> 1);
+#else
       return references; 
+#endif
    }
 
    //! returns true if the reference count is 1
-   /**
+   /** with QORE_BIASED_REFCOUNT, threads other than the owner get false until the owner's count has been merged,
+       since only the owner can read its count
+
       @return returns true if the reference count is 1
    */
+#ifdef QORE_BIASED_REFCOUNT
+   DLLEXPORT bool is_unique() const;
+#else
    DLLLOCAL bool is_unique() const { 
       return references == 1; 
    }
+#endif
 
    //! atomically increments the reference count
    DLLEXPORT void ROreference() const;
@@ -79,6 +100,14 @@ public:
       @return true if the reference count is now zero
    */
    DLLEXPORT bool ROdereference() const;
+
+#ifdef QORE_BIASED_REFCOUNT
+   //! hands the owner's references over to the shared counter when the object becomes reachable from other threads
+   /** does nothing if the calling thread does not own the object or if it has already been handed off
+       @return true if the calling thread's references were handed off
+    */
+   DLLEXPORT bool ROshare() const;
+#endif
 };
 
 #endif // _QORE_QOREREFERENCECOUNTER_H
@@ -123,6 +123,8 @@ public:
 class QoreSocket {
    friend struct qore_socket_private;
    friend struct qore_httpclient_priv;
+   friend class QoreSocketMultiplexer;
+   friend class QoreSocketEventLoop;
    friend class QoreSocketObject;
 
 private:
@@ -651,6 +653,22 @@ public:
    */
    DLLEXPORT int send(int fd, qore_offset_t size = -1);
 
+   //! sends untranslated data from an open file descriptor starting at the given offset without changing the file position
+   /** For non-SSL sockets the data is sent with sendfile() where available without being copied through user space;
+       otherwise it is read and sent in blocks
+
+       @param fd a file descriptor, open for reading
+       @param offset the file offset to start sending from
+       @param size the number of bytes to send (-1 = send all until EOF)
+       @param timeout_ms the maximum time a single send operation may take in milliseconds (-1 = no timeout)
+       @param xsink if an error occurs, the Qore-language exception information will be added here
+
+       @return 0 for OK, not 0 if an error occured
+
+       @since %Qore 0.8.12
+   */
+   DLLEXPORT int sendFile(int fd, int64 offset, int64 size, int timeout_ms, ExceptionSink* xsink);
+
    //! sends a 1-byte binary integer data to a connected socket
    /** The socket must be connected before this call is made.
        @param i the 1-byte integer to send through the socket
@@ -1661,6 +1679,18 @@ public:
    DLLLOCAL int setNoDelay(int nodelay);
    DLLLOCAL int getNoDelay() const;
 
+   DLLLOCAL int setReusePort(bool b);
+   DLLLOCAL bool getReusePort() const;
+
+   //! waits for a connection and accepts all other pending connections up to the given maximum without waiting; the new sockets are added to the vector
+   DLLLOCAL int acceptMany(std::vector<QoreSocket*>& l, int max, int timeout_ms, ExceptionSink* xsink);
+
+   //! receives up to the given number of datagrams with as few system calls as possible (not part of the library's public API)
+   DLLLOCAL QoreListNode* recvDatagrams(int max, int size, int timeout_ms, ExceptionSink* xsink);
+
+   //! sends a list of datagrams with as few system calls as possible (not part of the library's public API)
+   DLLLOCAL int sendDatagrams(const QoreListNode* l, ExceptionSink* xsink);
+
    //! sets backwards-compatible members on accept in a new object - will be removed in a future version of qore
    DLLLOCAL void setAccept(QoreObject* o);
 };
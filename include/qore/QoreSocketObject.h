@@ -48,6 +48,8 @@ class QoreSocketObject : public AbstractPrivateData {
 private:
    friend class my_socket_priv;
    friend struct qore_httpclient_priv;
+   friend class QoreSocketMultiplexer;
+   friend class QoreSocketEventLoop;
 
    DLLLOCAL QoreSocketObject(QoreSocket* s, QoreSSLCertificate* cert = 0, QoreSSLPrivateKey* pk = 0);
 
@@ -98,6 +100,8 @@ public:
    DLLEXPORT int send(const BinaryNode* b, int timeout_ms, ExceptionSink* xsink);
    // send from a file descriptor
    DLLEXPORT int send(int fd, int size = -1);
+   // send file data from an offset
+   DLLEXPORT int sendFile(int fd, int64 offset, int64 size, int timeout_ms, ExceptionSink* xsink);
    // send bytes and convert to network order
    DLLEXPORT int sendi1(char b, int timeout_ms, ExceptionSink* xsink);
    DLLEXPORT int sendi2(short b, int timeout_ms, ExceptionSink* xsink);
@@ -176,6 +180,11 @@ public:
    DLLEXPORT void setPrivateKey(QoreSSLPrivateKey* p);
    DLLEXPORT int setNoDelay(int nodelay);
    DLLEXPORT int getNoDelay();
+   DLLEXPORT int setReusePort(bool b);
+   DLLEXPORT bool getReusePort();
+   DLLLOCAL int acceptMany(std::vector<QoreSocketObject*>& l, int max, int timeout_ms, ExceptionSink* xsink);
+   DLLLOCAL QoreListNode* recvDatagrams(int max, int size, int timeout_ms, ExceptionSink* xsink);
+   DLLLOCAL int sendDatagrams(const QoreListNode* l, ExceptionSink* xsink);
    DLLEXPORT void setEventQueue(Queue *cbq, ExceptionSink* xsink);
    DLLEXPORT QoreHashNode* getPeerInfo(ExceptionSink* xsink, bool host_lookup = true) const;
    DLLEXPORT QoreHashNode* getSocketInfo(ExceptionSink* xsink, bool host_lookup = true) const;
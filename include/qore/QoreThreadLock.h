@@ -45,6 +45,10 @@
 //! provides a mutually-exclusive thread lock
 /** This class is just a simple wrapper for pthread_mutex_t.  It does not provide any special
     logic for checking for correct usage, etc.
+
+    Where supported (glibc), locks created without explicit attributes are adaptive mutexes: a thread
+    trying to acquire a held lock spins for a bounded number of iterations before blocking on the
+    lock's futex, which avoids a kernel round trip when the lock is only held for a short time
 */
 class QoreThreadLock {
    friend class QoreCondition;
@@ -58,6 +62,14 @@ private:
 
    //! internal initialization
    DLLLOCAL void init(const pthread_mutexattr_t* pma = 0) {
+#ifdef PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP
+      if (!pma) {
+         // the static initializer is equivalent to pthread_mutex_init() with the adaptive mutex type
+         static const pthread_mutex_t adaptive = PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP;
+         ptm_lock = adaptive;
+         return;
+      }
+#endif
 #ifndef NDEBUG
       int rc =
 #endif
@@ -37,6 +37,7 @@
 #include <qore/QoreThreadLock.h>
 #include <qore/QoreCondition.h>
 #include <qore/AbstractThreadResource.h>
+#include <qore/intern/QoreLockStats.h>
 
 class VLock;
 
@@ -49,6 +50,7 @@ protected:
    VLock *vl;
    int tid, waiting;
    cond_map_t cmap;       // map of condition variables to wait counts
+   QoreLockStats* stats;  // optional contention statistics, 0 if not enabled
 
    virtual int releaseImpl() = 0;
    virtual int releaseImpl(ExceptionSink *xsink) = 0;
@@ -71,8 +73,10 @@ public:
    mutable QoreThreadLock asl_lock;
    QoreCondition asl_cond;
 
-   DLLLOCAL AbstractSmartLock() : vl(NULL), tid(-1), waiting(0)  {}
-   DLLLOCAL virtual ~AbstractSmartLock() {}
+   DLLLOCAL AbstractSmartLock() : vl(NULL), tid(-1), waiting(0), stats(0)  {}
+   DLLLOCAL virtual ~AbstractSmartLock() {
+      delete stats;
+   }
    DLLLOCAL void destructor(ExceptionSink *xsink);
    DLLLOCAL virtual void cleanup(ExceptionSink *xsink);
 
@@ -91,7 +95,15 @@ public:
 
    DLLLOCAL int extern_wait(QoreCondition *cond, ExceptionSink *xsink, int64 timeout_ms = 0);
 
+   // enables or disables contention statistics; disabling discards the statistics collected so far
+   DLLLOCAL void setLockStats(bool enable);
+   // returns the contention statistics or 0 if not enabled
+   DLLLOCAL QoreHashNode* getLockStats() const;
+   DLLLOCAL bool lockStatsEnabled() const { return stats; }
+
    DLLLOCAL int get_tid() const { return tid; }
+   // returns the lock list of the thread holding the lock exclusively; must be called with asl_lock held
+   DLLLOCAL VLock *get_vl() const { return vl; }
    DLLLOCAL int get_waiting() const { return waiting; }
    DLLLOCAL virtual const char *getName() const = 0;
    DLLLOCAL int cond_count(QoreCondition *cond) const {
@@ -0,0 +1,216 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_CONCURRENTHASH_H
+#define _QORE_CONCURRENTHASH_H
+
+// the number of independently-locked stripes; must be a power of 2
+#define QORE_CH_STRIPES 64
+
+#include <qore/QoreRWLock.h>
+#include <qore/intern/xxhash.h>
+
+#include <string>
+#include <vector>
+
+#ifdef HAVE_QORE_HASH_MAP
+#include <qore/hash_map_include.h>
+
+typedef HASH_MAP<std::string, AbstractQoreNode*, qore_hash_std_str> ch_map_t;
+#else
+#include <map>
+typedef std::map<std::string, AbstractQoreNode*> ch_map_t;
+#endif
+
+typedef std::vector<AbstractQoreNode*> ch_node_list_t;
+
+// a hash of string keys to values that can be used from many threads at once; keys are spread over
+// QORE_CH_STRIPES independent maps with their own read-write locks, so threads only contend when they
+// access keys in the same stripe and readers never block each other
+class ConcurrentHash : public AbstractPrivateData {
+protected:
+   struct ch_stripe {
+      mutable QoreRWLock l;
+      ch_map_t map;
+   };
+
+   ch_stripe stripes[QORE_CH_STRIPES];
+
+   DLLLOCAL ch_stripe& getStripe(const std::string& key) {
+      // the high bits of a 32-bit hash are used so that the keys of a stripe are still spread over all buckets of the stripe's map
+      return stripes[(XXH32(key.data(), key.size(), 0) >> 16) & (QORE_CH_STRIPES - 1)];
+   }
+
+   DLLLOCAL const ch_stripe& getStripe(const std::string& key) const {
+      return const_cast<ConcurrentHash*>(this)->getStripe(key);
+   }
+
+   DLLLOCAL static void derefList(ch_node_list_t& l, ExceptionSink* xsink) {
+      for (ch_node_list_t::iterator i = l.begin(), e = l.end(); i != e; ++i)
+         if (*i)
+            (*i)->deref(xsink);
+   }
+
+   DLLLOCAL virtual ~ConcurrentHash() {
+   }
+
+public:
+   DLLLOCAL ConcurrentHash() {
+   }
+
+   // creates a copy with a weakly consistent snapshot of the original's contents
+   DLLLOCAL ConcurrentHash(const ConcurrentHash& old) {
+      for (unsigned i = 0; i < QORE_CH_STRIPES; ++i) {
+         QoreAutoRWReadLocker al(old.stripes[i].l);
+         for (ch_map_t::const_iterator mi = old.stripes[i].map.begin(), e = old.stripes[i].map.end(); mi != e; ++mi)
+            stripes[i].map[mi->first] = mi->second ? mi->second->refSelf() : 0;
+      }
+   }
+
+   DLLLOCAL virtual void deref(ExceptionSink* xsink) {
+      if (ROdereference()) {
+         clear(xsink);
+         delete this;
+      }
+   }
+
+   // returns the value of the given key with a new reference
+   DLLLOCAL AbstractQoreNode* get(const std::string& key) const {
+      const ch_stripe& s = getStripe(key);
+      QoreAutoRWReadLocker al(s.l);
+      ch_map_t::const_iterator i = s.map.find(key);
+      return i != s.map.end() && i->second ? i->second->refSelf() : 0;
+   }
+
+   DLLLOCAL bool exists(const std::string& key) const {
+      const ch_stripe& s = getStripe(key);
+      QoreAutoRWReadLocker al(s.l);
+      return s.map.find(key) != s.map.end();
+   }
+
+   // sets the value of the given key; takes over the reference to "val" and returns the old value (must be dereferenced by the caller)
+   DLLLOCAL AbstractQoreNode* put(const std::string& key, AbstractQoreNode* val) {
+      ch_stripe& s = getStripe(key);
+      QoreAutoRWWriteLocker al(s.l);
+      AbstractQoreNode*& v = s.map[key];
+      AbstractQoreNode* rv = v;
+      v = val;
+      return rv;
+   }
+
+   // sets the value of the given key only if the key is not present and returns 0; takes over the reference to "val" only if it was added,
+   // otherwise returns a new reference to the existing value in "existing"
+   DLLLOCAL bool putIfAbsent(const std::string& key, AbstractQoreNode* val, AbstractQoreNode*& existing) {
+      ch_stripe& s = getStripe(key);
+      QoreAutoRWWriteLocker al(s.l);
+      ch_map_t::iterator i = s.map.find(key);
+      if (i != s.map.end()) {
+         existing = i->second ? i->second->refSelf() : 0;
+         return false;
+      }
+      s.map.insert(ch_map_t::value_type(key, val));
+      return true;
+   }
+
+   // removes the given key and returns its value (must be dereferenced by the caller)
+   DLLLOCAL AbstractQoreNode* remove(const std::string& key) {
+      ch_stripe& s = getStripe(key);
+      QoreAutoRWWriteLocker al(s.l);
+      ch_map_t::iterator i = s.map.find(key);
+      if (i == s.map.end())
+         return 0;
+      AbstractQoreNode* rv = i->second;
+      s.map.erase(i);
+      return rv;
+   }
+
+   // atomically adds "v" to the integer value of the given key and returns the new value; missing keys are treated as 0
+   DLLLOCAL int64 add(const std::string& key, int64 v, ExceptionSink* xsink) {
+      AbstractQoreNode* old;
+      int64 rv;
+      {
+         ch_stripe& s = getStripe(key);
+         QoreAutoRWWriteLocker al(s.l);
+         AbstractQoreNode*& n = s.map[key];
+         // a new node is always created; values returned by get() may be shared with other threads without holding
+         // the stripe lock, so stored nodes are never modified in place
+         old = n;
+         rv = (n ? n->getAsBigInt() : 0) + v;
+         n = new QoreBigIntNode(rv);
+      }
+      // the old value is released outside the lock in case it is an object with a destructor
+      if (old)
+         old->deref(xsink);
+      return rv;
+   }
+
+   DLLLOCAL int64 size() const {
+      int64 rv = 0;
+      for (unsigned i = 0; i < QORE_CH_STRIPES; ++i) {
+         QoreAutoRWReadLocker al(stripes[i].l);
+         rv += stripes[i].map.size();
+      }
+      return rv;
+   }
+
+   // the following methods lock one stripe at a time, so the result reflects each stripe at the time it was visited
+   DLLLOCAL QoreListNode* keys() const {
+      QoreListNode* l = new QoreListNode;
+      for (unsigned i = 0; i < QORE_CH_STRIPES; ++i) {
+         QoreAutoRWReadLocker al(stripes[i].l);
+         for (ch_map_t::const_iterator mi = stripes[i].map.begin(), e = stripes[i].map.end(); mi != e; ++mi)
+            l->push(new QoreStringNode(mi->first));
+      }
+      return l;
+   }
+
+   DLLLOCAL QoreHashNode* getHash(ExceptionSink* xsink) const {
+      ReferenceHolder<QoreHashNode> h(new QoreHashNode, xsink);
+      for (unsigned i = 0; i < QORE_CH_STRIPES; ++i) {
+         QoreAutoRWReadLocker al(stripes[i].l);
+         for (ch_map_t::const_iterator mi = stripes[i].map.begin(), e = stripes[i].map.end(); mi != e; ++mi)
+            h->setKeyValue(mi->first.c_str(), mi->second ? mi->second->refSelf() : 0, xsink);
+      }
+      return h.release();
+   }
+
+   DLLLOCAL void clear(ExceptionSink* xsink) {
+      ch_node_list_t l;
+      for (unsigned i = 0; i < QORE_CH_STRIPES; ++i) {
+         QoreAutoRWWriteLocker al(stripes[i].l);
+         for (ch_map_t::iterator mi = stripes[i].map.begin(), e = stripes[i].map.end(); mi != e; ++mi)
+            l.push_back(mi->second);
+         stripes[i].map.clear();
+      }
+      // values are released outside the locks in case they are objects with destructors
+      derefList(l, xsink);
+   }
+};
+
+#endif
@@ -151,6 +151,9 @@ public:
       val.set(typeInfo);
 
       // no exception is possible here as there was no previous value
+      // closure-bound variables can be accessed by other threads
+      if (nval.type == QV_Node)
+         q_share_value(nval.v.n);
       // also since only basic value types could be returned, no exceptions can occur with the value passed either
       discard(val.assignInitial(nval), 0);
    }
@@ -0,0 +1,76 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/* 
+  QC_AtomicInteger.h
+
+  atomic integer class
+
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_CLASS_ATOMICINTEGER_H
+
+#define _QORE_CLASS_ATOMICINTEGER_H
+
+#include <qore/intern/qore_atomic.h>
+
+DLLEXPORT extern qore_classid_t CID_ATOMICINTEGER;
+DLLLOCAL extern QoreClass* QC_ATOMICINTEGER;
+DLLLOCAL QoreClass *initAtomicIntegerClass(QoreNamespace& ns);
+
+class AtomicInteger : public AbstractPrivateData {
+   protected:
+      volatile int64 val;
+
+      DLLLOCAL virtual ~AtomicInteger() {}
+
+   public:
+      DLLLOCAL AtomicInteger(int64 v = 0) : val(v) {}
+
+      DLLLOCAL int64 get() const {
+         return qore_atomic_get(&val);
+      }
+
+      // sets the new value and returns the previous value
+      DLLLOCAL int64 set(int64 v) {
+         while (true) {
+            int64 ov = val;
+            if (qore_atomic_cas(&val, ov, v))
+               return ov;
+         }
+      }
+
+      // adds the given value and returns the new value
+      DLLLOCAL int64 add(int64 v) {
+         return qore_atomic_add(&val, v);
+      }
+
+      DLLLOCAL bool compareAndSet(int64 ov, int64 nv) {
+         return qore_atomic_cas(&val, ov, nv);
+      }
+};
+
+#endif // _QORE_CLASS_ATOMICINTEGER_H
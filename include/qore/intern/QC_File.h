@@ -35,6 +35,8 @@
 
 DLLEXPORT extern qore_classid_t CID_FILE;
 DLLEXPORT extern QoreClass *QC_FILE;
+DLLLOCAL extern qore_classid_t CID_READONLYFILE;
+DLLLOCAL extern QoreClass* QC_READONLYFILE;
 
 DLLLOCAL QoreClass *initFileClass(QoreNamespace &qorens);
 
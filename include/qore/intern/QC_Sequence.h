@@ -46,7 +46,7 @@ class QoreSequence : public AbstractPrivateData, public Sequence {
       DLLLOCAL virtual ~QoreSequence() {}
 
    public:
-      DLLLOCAL QoreSequence(int start = 0) : Sequence(start) {}
+      DLLLOCAL QoreSequence(int64 start = 0) : Sequence(start) {}
 };
 
 #endif // _QORE_CLASS_SEQUENCE_H
@@ -46,17 +46,24 @@ DLLLOCAL extern QoreClass* QC_SOCKET;
 #include <qore/intern/QC_SSLCertificate.h>
 #include <qore/intern/QC_SSLPrivateKey.h>
 
+class QoreSocketMultiplexer;
+class QoreSocketAsyncOp;
+
 class my_socket_priv {
 public:
    QoreSocket* socket;
    QoreSSLCertificate* cert;
    QoreSSLPrivateKey* pk;
+   // the multiplexer the socket is parked in, if any
+   QoreSocketMultiplexer* mux;
+   // the pending asynchronous operation on the socket, if any
+   QoreSocketAsyncOp* async_op;
    mutable QoreThreadLock m;
 
-   DLLLOCAL my_socket_priv(QoreSocket* s, QoreSSLCertificate* c = 0, QoreSSLPrivateKey* p = 0) : socket(s), cert(c), pk(p) {
+   DLLLOCAL my_socket_priv(QoreSocket* s, QoreSSLCertificate* c = 0, QoreSSLPrivateKey* p = 0) : socket(s), cert(c), pk(p), mux(0), async_op(0) {
    }
 
-   DLLLOCAL my_socket_priv() : socket(new QoreSocket), cert(0), pk(0) {
+   DLLLOCAL my_socket_priv() : socket(new QoreSocket), cert(0), pk(0), mux(0), async_op(0) {
    }
 
    DLLLOCAL ~my_socket_priv() {
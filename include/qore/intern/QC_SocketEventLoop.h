@@ -1,8 +1,9 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
 /*
-  Sequence.cpp
- 
+  QC_SocketEventLoop.h
+  
   Qore Programming Language
- 
+
   Copyright (C) 2003 - 2015 David Nichols
 
   Permission is hereby granted, free of charge, to any person obtaining a
@@ -28,20 +29,14 @@
   information.
 */
 
-#include <qore/Qore.h>
-#include <qore/intern/Sequence.h>
+#ifndef _QORE_CLASS_SOCKETEVENTLOOP_H
+
+#define _QORE_CLASS_SOCKETEVENTLOOP_H
 
-Sequence::Sequence(int start) {
-   val = start;
-}
+DLLLOCAL extern qore_classid_t CID_SOCKETEVENTLOOP;
+DLLLOCAL extern QoreClass* QC_SOCKETEVENTLOOP;
+DLLLOCAL QoreClass* initSocketEventLoopClass(QoreNamespace& ns);
 
-int Sequence::next() {
-   lock();
-   int rc = val++;
-   unlock();
-   return rc;
-}
+#include <qore/intern/QoreSocketEventLoop.h>
 
-int Sequence::getCurrent() const { 
-   return val; 
-}
+#endif // _QORE_CLASS_SOCKETEVENTLOOP_H
@@ -0,0 +1,196 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_QORECACHE_H
+#define _QORE_QORECACHE_H
+
+// the maximum number of independently-locked shards; must be a power of 2
+#define QORE_CACHE_SHARDS 16
+// the minimum number of entries per shard when the number of entries is limited
+#define QORE_CACHE_MIN_SHARD_ENTRIES 64
+// the minimum size per shard in bytes when the size in bytes is limited
+#define QORE_CACHE_MIN_SHARD_BYTES (64 * 1024)
+
+#include <qore/intern/xxhash.h>
+
+#include <string>
+#include <list>
+#include <map>
+#include <vector>
+
+#ifdef HAVE_QORE_HASH_MAP
+#include <qore/hash_map_include.h>
+#endif
+
+class QoreCacheEntry {
+public:
+   std::string key;
+   AbstractQoreNode* val;
+   int64 expires;     // monotonic time in microseconds when the entry expires, 0 = never
+   size_t size;       // approximate size in bytes, only calculated when the cache size is limited in bytes
+
+   DLLLOCAL QoreCacheEntry(const std::string& k, AbstractQoreNode* v, int64 e, size_t s) : key(k), val(v), expires(e), size(s) {
+   }
+};
+
+// most recently used entries are at the front
+typedef std::list<QoreCacheEntry> cache_lru_t;
+
+#ifdef HAVE_QORE_HASH_MAP
+typedef HASH_MAP<std::string, cache_lru_t::iterator, qore_hash_std_str> cache_map_t;
+#else
+typedef std::map<std::string, cache_lru_t::iterator> cache_map_t;
+#endif
+
+// a value being loaded by one thread that other threads requesting the same key wait for
+class QoreCacheLoad {
+public:
+   QoreCondition cond;
+   AbstractQoreNode* val;
+   int tid,             // the TID of the thread running the loader
+      refs;             // the loading thread and all waiting threads
+   bool done,
+      failed,
+      invalidated;      // the key was set or removed while the loader was running; the result is not stored
+
+   DLLLOCAL QoreCacheLoad(int n_tid) : val(0), tid(n_tid), refs(1), done(false), failed(false), invalidated(false) {
+   }
+};
+
+typedef std::map<std::string, QoreCacheLoad*> cache_load_map_t;
+// maps the TID of each thread waiting for a load to the TID of the thread running the loader
+typedef std::map<int, int> cache_wait_map_t;
+
+// values released by cache operations; they are dereferenced after the shard lock has been released
+// in case they are objects with destructors
+typedef std::vector<AbstractQoreNode*> cache_node_list_t;
+
+class QoreCacheShard {
+public:
+   QoreThreadLock l;
+   cache_lru_t lru;
+   cache_map_t map;
+   cache_load_map_t loads;
+   size_t count, bytes;
+   int64 hits, misses, evictions, expirations, loaded;
+
+   DLLLOCAL QoreCacheShard() : count(0), bytes(0), hits(0), misses(0), evictions(0), expirations(0), loaded(0) {
+   }
+};
+
+// a thread-safe cache with LRU eviction, optional time-to-live and an optional loader; keys are spread over
+// independently-locked shards, and size limits are applied per shard, so eviction is approximately LRU
+class QoreCache : public AbstractPrivateData {
+protected:
+   QoreCacheShard* shards;
+   unsigned nshards;
+   size_t max_entries,     // maximum entries per shard, 0 = unlimited
+      max_bytes;           // maximum approximate bytes per shard, 0 = unlimited
+   int64 ttl_us;           // default time to live in microseconds, 0 = none
+   ResolvedCallReferenceNode* loader;
+   // the threads waiting for loads in all shards; used to detect loaders that wait for each other
+   QoreThreadLock wait_lock;
+   cache_wait_map_t waits;
+
+   DLLLOCAL QoreCacheShard& getShard(const std::string& key) {
+      return shards[(XXH32(key.data(), key.size(), 0) >> 16) & (nshards - 1)];
+   }
+
+   // looks up a value; returns true on a hit with a new reference to the value in "rv"; must be called with the shard lock held
+   DLLLOCAL bool find(QoreCacheShard& s, const std::string& key, AbstractQoreNode*& rv, cache_node_list_t& rel);
+
+   // adds or replaces a value and evicts entries if the shard is full; takes over the reference to "val"; must be called with the shard lock held
+   DLLLOCAL void set(QoreCacheShard& s, const std::string& key, AbstractQoreNode* val, int64 ttl_us, cache_node_list_t& rel);
+
+   DLLLOCAL void erase(QoreCacheShard& s, cache_map_t::iterator i, cache_node_list_t& rel);
+
+   // marks a load of the given key in progress as invalidated; must be called with the shard lock held
+   DLLLOCAL static void invalidateLoad(QoreCacheShard& s, const std::string& key) {
+      cache_load_map_t::iterator i = s.loads.find(key);
+      if (i != s.loads.end())
+         i->second->invalidated = true;
+   }
+
+   // registers the current thread as waiting for a load run by "ltid"; returns -1 if "ltid" is waiting, directly
+   // or through other threads, for a load run by the current thread
+   DLLLOCAL int startWait(int tid, int ltid);
+
+   DLLLOCAL void endWait(int tid) {
+      AutoLocker al(wait_lock);
+      waits.erase(tid);
+   }
+
+   DLLLOCAL static void derefList(cache_node_list_t& rel, ExceptionSink* xsink) {
+      for (cache_node_list_t::iterator i = rel.begin(), e = rel.end(); i != e; ++i)
+         if (*i)
+            (*i)->deref(xsink);
+   }
+
+   DLLLOCAL virtual ~QoreCache() {
+      assert(!loader);
+      delete [] shards;
+   }
+
+public:
+   // "ttl_ms" is the default time to live in milliseconds (0 = none); the loader is optional and its reference is taken over
+   DLLLOCAL QoreCache(int64 n_max_entries, int64 n_max_bytes, int64 ttl_ms, ResolvedCallReferenceNode* n_loader);
+
+   DLLLOCAL virtual void deref(ExceptionSink* xsink) {
+      if (ROdereference()) {
+         clear(xsink);
+         if (loader) {
+            loader->deref(xsink);
+            loader = 0;
+         }
+         delete this;
+      }
+   }
+
+   // returns the value of the key with a new reference; calls the loader for missing keys if a loader is set
+   DLLLOCAL AbstractQoreNode* get(const QoreStringNode* key, ExceptionSink* xsink);
+
+   // sets the value of the key; "ttl_ms" < 0 means the default time to live; takes over the reference to "val"
+   DLLLOCAL void put(const std::string& key, AbstractQoreNode* val, int64 ttl_ms, ExceptionSink* xsink);
+
+   // removes the key and returns its value, which must be dereferenced by the caller
+   DLLLOCAL AbstractQoreNode* remove(const std::string& key, ExceptionSink* xsink);
+
+   DLLLOCAL bool exists(const std::string& key, ExceptionSink* xsink);
+
+   DLLLOCAL int64 size();
+
+   DLLLOCAL void clear(ExceptionSink* xsink);
+
+   DLLLOCAL QoreHashNode* getStats();
+
+   // returns the approximate memory used by a value in bytes
+   DLLLOCAL static size_t getNodeSize(const AbstractQoreNode* n);
+};
+
+#endif
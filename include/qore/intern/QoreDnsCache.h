@@ -0,0 +1,116 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+
+#ifndef _QORE_QOREDNSCACHE_H
+#define _QORE_QOREDNSCACHE_H
+
+// the default maximum number of cached lookups
+#define QORE_DNS_CACHE_DEFAULT_MAX_ENTRIES 4096
+// the default time in milliseconds that failed lookups are cached
+#define QORE_DNS_CACHE_DEFAULT_NEGATIVE_TTL 5000
+
+#include <string>
+#include <map>
+#include <vector>
+
+// one resolved address with the parameters needed to create a socket for it
+struct QoreDnsAddr {
+   struct sockaddr_storage addr;
+   size_t addrlen;
+   int family;
+   int socktype;
+   int protocol;
+};
+
+typedef std::vector<QoreDnsAddr> dns_addr_list_t;
+
+class QoreDnsEntry {
+public:
+   std::string host,
+      service;
+   dns_addr_list_t addrs;
+   int64 expires;     // monotonic time in milliseconds when the entry expires
+   int status;        // the getaddrinfo() error code for negative entries, 0 for successful lookups
+   int64 hits;
+
+   DLLLOCAL QoreDnsEntry() : expires(0), status(0), hits(0) {
+   }
+};
+
+typedef std::map<std::string, QoreDnsEntry> dns_entry_map_t;
+
+// a process-wide cache of host name lookups for outgoing connections; successful lookups are cached for "ttl" ms and
+// definitive lookup failures (ex: EAI_NONAME) for "negative_ttl" ms; getaddrinfo() does not return record TTLs, so the same TTL applies to all entries;
+// the cache is disabled when "ttl" is 0
+class QoreDnsCache {
+protected:
+   mutable QoreThreadLock l;
+   dns_entry_map_t emap;
+   int64 ttl,
+      negative_ttl;
+   size_t max_entries;
+   // statistics
+   int64 hits,
+      misses,
+      negative_hits;
+
+   // orders the addresses happy eyeballs-style, alternating between address families starting with the first family returned
+   DLLLOCAL static void interleave(dns_addr_list_t& addrs);
+
+   // removes expired entries; if the cache is still full then the entry with the fewest hits is removed; must be called with the lock held
+   DLLLOCAL void prune(int64 now);
+
+   DLLLOCAL static void raiseError(ExceptionSink* xsink, const char* host, const char* service, int family, int status);
+
+   DLLLOCAL static bool isDefinitiveError(int status);
+
+   DLLLOCAL static std::string getKey(const char* host, const char* service, int family, int type, int protocol);
+
+public:
+   DLLLOCAL QoreDnsCache() : ttl(0), negative_ttl(0), max_entries(QORE_DNS_CACHE_DEFAULT_MAX_ENTRIES), hits(0), misses(0), negative_hits(0) {
+   }
+
+   // resolves the given host and service, using and populating the cache if it is enabled; raises the same exceptions as
+   // QoreAddrInfo::getInfo() on errors
+   DLLLOCAL int lookup(ExceptionSink* xsink, const char* host, const char* service, int family, int type, int protocol, dns_addr_list_t& rv);
+
+   // moves an address that could not be connected to the end of the cached address list so that other addresses are tried first
+   DLLLOCAL void reportFailure(const char* host, const char* service, int family, int type, int protocol, const struct sockaddr* addr, size_t addrlen);
+
+   DLLLOCAL void set(int64 n_ttl, int64 n_negative_ttl, size_t n_max_entries);
+
+   DLLLOCAL void clear();
+
+   DLLLOCAL QoreHashNode* getInfo() const;
+};
+
+DLLLOCAL extern QoreDnsCache qore_dns_cache;
+
+#endif
@@ -294,6 +294,13 @@ public:
       derefImpl(xsink);
    }
 
+   // exchanges the members with another hash; iterators in the member maps remain valid
+   DLLLOCAL void swap(qore_hash_private& h) {
+      member_list.swap(h.member_list);
+      hm.swap(h.hm);
+      std::swap(obj_count, h.obj_count);
+   }
+
    DLLLOCAL size_t size() const {
       return member_list.size();
    }
@@ -0,0 +1,133 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_QOREHTTPCONNECTIONPOOL_H
+#define _QORE_QOREHTTPCONNECTIONPOOL_H
+
+#include <qore/QoreHttpClientObject.h>
+
+#include <string>
+#include <deque>
+#include <map>
+#include <vector>
+
+// default maximum number of connections per host
+#define QORE_HTTP_POOL_DEFAULT_MAX 10
+// default time in milliseconds after which idle connections are closed
+#define QORE_HTTP_POOL_DEFAULT_IDLE_TIMEOUT 60000
+
+class QoreHttpPoolConn {
+public:
+   QoreHttpClientObject* client;
+   int64 last_used;   // monotonic time in milliseconds when the connection was returned to the pool
+
+   DLLLOCAL QoreHttpPoolConn(QoreHttpClientObject* c, int64 lu) : client(c), last_used(lu) {
+   }
+};
+
+// the most recently used idle connections are at the back
+typedef std::deque<QoreHttpPoolConn> http_pool_conn_list_t;
+typedef std::vector<QoreHttpClientObject*> http_pool_client_vec_t;
+
+// the connections of one scheme, host and port
+class QoreHttpPoolHost {
+public:
+   http_pool_conn_list_t idle;
+   std::string url;       // the URL of new connections as returned by HTTPClient::getURL()
+   QoreCondition cond;    // signaled when a connection is returned to the pool
+   unsigned busy,         // connections currently in use, including connections being created
+      waiting,            // threads waiting for a connection
+      filling;            // idle connections being created for min_idle; also counted in busy
+   // statistics
+   int64 requests, created, reused, closed, waits, timeouts;
+
+   DLLLOCAL QoreHttpPoolHost() : busy(0), waiting(0), filling(0), requests(0), created(0), reused(0), closed(0), waits(0), timeouts(0) {
+   }
+};
+
+// a thread-safe pool of HTTP client connections keyed by the scheme, host and port of the request URL
+class QoreHttpConnectionPool : public AbstractPrivateData {
+   friend class QoreHttpPoolConnHelper;
+
+protected:
+   typedef std::map<std::string, QoreHttpPoolHost*> http_pool_host_map_t;
+
+   QoreThreadLock l;
+   http_pool_host_map_t hmap;
+   QoreHashNode* client_opts;   // options for new HTTPClient connections
+   unsigned max_connections,    // the maximum number of connections per host
+      max_idle,                 // the maximum number of idle connections kept per host
+      min_idle;                 // the number of idle connections per host created in advance and not closed by the idle timeout
+   int64 idle_timeout,          // ms
+      wait_timeout;             // ms, -1 = wait indefinitely
+
+   DLLLOCAL virtual ~QoreHttpConnectionPool();
+
+   // moves expired idle connections to "del"; must be called with the lock held
+   DLLLOCAL void pruneIdle(QoreHttpPoolHost& h, int64 now, http_pool_client_vec_t& del);
+
+   // moves expired idle connections of all hosts to "del"; must be called with the lock held
+   DLLLOCAL void pruneAllIdle(int64 now, http_pool_client_vec_t& del);
+
+   // creates a new connection for the given base URL; the caller must have reserved a slot for it
+   DLLLOCAL QoreHttpClientObject* newClient(const std::string& base, QoreHttpPoolHost* host, ExceptionSink* xsink);
+
+   // creates and connects new idle connections until the host has at least min_idle idle connections
+   DLLLOCAL void fillIdle(const std::string& base, QoreHttpPoolHost* host);
+
+   DLLLOCAL static void derefClients(http_pool_client_vec_t& del, ExceptionSink* xsink);
+
+   // returns a connection for the given base URL (scheme://host:port)
+   DLLLOCAL QoreHttpClientObject* acquire(const std::string& base, QoreHttpPoolHost*& host, ExceptionSink* xsink);
+
+   // returns a connection to the pool or closes it if it cannot be reused
+   DLLLOCAL void release(const std::string& base, QoreHttpPoolHost* host, QoreHttpClientObject* client, ExceptionSink* xsink);
+
+public:
+   // takes over the reference to "opts"
+   DLLLOCAL QoreHttpConnectionPool(unsigned n_max_connections, unsigned n_max_idle, unsigned n_min_idle, int64 n_idle_timeout, int64 n_wait_timeout, QoreHashNode* opts);
+
+   DLLLOCAL virtual void deref(ExceptionSink* xsink);
+
+   DLLLOCAL QoreHashNode* send(const char* meth, const char* url, const QoreHashNode* headers, const void* data, unsigned size, bool getbody, QoreHashNode* info, ExceptionSink* xsink);
+
+   DLLLOCAL AbstractQoreNode* get(const char* url, const QoreHashNode* headers, QoreHashNode* info, ExceptionSink* xsink);
+
+   DLLLOCAL QoreHashNode* head(const char* url, const QoreHashNode* headers, QoreHashNode* info, ExceptionSink* xsink);
+
+   DLLLOCAL AbstractQoreNode* post(const char* url, const QoreHashNode* headers, const void* data, unsigned size, QoreHashNode* info, ExceptionSink* xsink);
+
+   // closes all idle connections
+   DLLLOCAL void clear(ExceptionSink* xsink);
+
+   // closes expired idle connections and returns the statistics of all hosts
+   DLLLOCAL QoreHashNode* getStats(ExceptionSink* xsink);
+};
+
+#endif
@@ -139,7 +139,7 @@ DLLLOCAL inline bool qore_check_this(const void* p) {
 }
 
 DLLLOCAL bool is_container(const AbstractQoreNode* n);
-// returns true if the container has objects or false if not
+// returns true if the value is or contains an object, closure or call reference, or false if not
 DLLLOCAL bool get_container_obj(const AbstractQoreNode* n);
 // increments or decrements the object count depending on the sign of the argument (cannot be 0)
 DLLLOCAL void inc_container_obj(const AbstractQoreNode* n, int dt);
@@ -321,9 +321,19 @@ DLLLOCAL extern QoreClass* QC_PSEUDONOTHING;
 
 DLLLOCAL bool node_has_effect(const AbstractQoreNode* n);
 
+// hands off the current thread's biased references to the value and any values it contains when
+// the value is published to other threads
+#ifdef QORE_BIASED_REFCOUNT
+DLLLOCAL void q_share_value(const AbstractQoreNode* n);
+#else
+DLLLOCAL inline void q_share_value(const AbstractQoreNode* n) {
+}
+#endif
+
 #include <qore/intern/NamedScope.h>
 #include <qore/intern/QoreTypeInfo.h>
 #include <qore/intern/ParseNode.h>
+#include <qore/intern/qore_atomic.h>
 #include <qore/intern/QoreThreadList.h>
 #include <qore/intern/qore_thread_intern.h>
 #include <qore/intern/Function.h>
@@ -697,6 +707,9 @@ public:
 #endif
 };
 
+// the current thread's data and its inline accessors
+#include <qore/intern/ThreadData.h>
+
 DLLLOCAL int q_get_af(int type);
 DLLLOCAL int q_get_sock_type(int t);
 
@@ -0,0 +1,113 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/* 
+  QoreLockStats.h
+
+  lock contention statistics
+
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_QORELOCKSTATS_H
+
+#define _QORE_QORELOCKSTATS_H
+
+// declared here as this header can be included before QoreLibIntern.h
+DLLLOCAL int64 q_clock_getmicros();
+
+// optional contention statistics for a single lock or queue; all members are updated while the
+// lock's internal mutex is held; times are in microseconds
+class QoreLockStats {
+protected:
+   // the type name of the lock (ex: "Mutex")
+   const char* type;
+   // current exclusive hold start time or 0
+   int64 hold_start;
+
+public:
+   int64 acquisitions,  // number of successful acquisitions
+      contended,        // number of acquisitions that had to wait
+      wait_total,       // total time spent waiting
+      wait_max,         // maximum time spent waiting for a single acquisition
+      hold_total,       // total time the lock was held exclusively
+      hold_max;         // maximum time the lock was held exclusively at once
+
+   // registers the object for process-wide aggregation
+   DLLLOCAL QoreLockStats(const char* n_type);
+
+   // deregisters the object and retains its totals for process-wide aggregation
+   DLLLOCAL ~QoreLockStats();
+
+   // records an exclusive acquisition; wait_start is the time the thread started to wait or 0 if it did not wait
+   DLLLOCAL void acquired(int64 wait_start) {
+      int64 now = q_clock_getmicros();
+      acquiredIntern(wait_start, now);
+      hold_start = now;
+   }
+
+   // records a shared acquisition (read lock or queue operation) where the hold time is not tracked
+   DLLLOCAL void acquiredShared(int64 wait_start) {
+      acquiredIntern(wait_start, wait_start ? q_clock_getmicros() : 0);
+   }
+
+   // records the release of an exclusive acquisition
+   DLLLOCAL void released() {
+      if (!hold_start)
+         return;
+      int64 h = q_clock_getmicros() - hold_start;
+      hold_total += h;
+      if (h > hold_max)
+         hold_max = h;
+      hold_start = 0;
+   }
+
+   DLLLOCAL const char* getType() const {
+      return type;
+   }
+
+   // returns a hash of the statistics
+   DLLLOCAL QoreHashNode* getHash() const;
+
+   // returns a hash of statistics aggregated by lock type for all locks in the process
+   DLLLOCAL static QoreHashNode* getAll();
+
+private:
+   DLLLOCAL void acquiredIntern(int64 wait_start, int64 now) {
+      ++acquisitions;
+      if (wait_start) {
+         ++contended;
+         int64 w = now - wait_start;
+         wait_total += w;
+         if (w > wait_max)
+            wait_max = w;
+      }
+   }
+};
+
+// returns true if lock statistics are enabled by default for locks created in the current Program
+DLLLOCAL bool q_lock_stats_default();
+
+#endif
@@ -185,8 +185,9 @@ typedef std::list<RNotifier*> n_list_t;
 
 // rwlock with standard read and write lock handling and special "rsection" handling
 // the rsection is grabbed with the read lock but only one thread can have the rsection lock at once
-// leaving other threads to read the object normally
-class qore_rsection_priv : public qore_var_rwlock_priv {
+// leaving other threads to read the object normally; read locks are counted atomically, so reading
+// object members does not acquire the mutex unless a writer holds or is waiting for the lock
+class qore_rsection_priv : public qore_var_counted_rwlock_priv<1> {
 private:
    // not implemented, listed here to prevent implicit usage
    DLLLOCAL qore_rsection_priv(const qore_rsection_priv&);
@@ -226,7 +227,7 @@ public:
    DLLLOCAL int tryRSectionLockNotifyWaitRead(RNotifier* rn) {
       assert(has_notify);
 
-      int tid = gettid();
+      int tid = q_gettid();
 
       AutoLocker al(l);
       assert(write_tid != tid);
@@ -238,7 +239,7 @@ public:
 
          if (rs_tid == -1) {
             // grab the read lock
-            ++readers;
+            rdlockIntern(tid);
 
             // grab the rsection
             rs_tid = tid;
@@ -252,25 +253,27 @@ public:
    }
 
    DLLLOCAL void rSectionUnlock() {
-      AutoLocker al(l);
-      assert(write_tid == -1);
-      assert(rs_tid == gettid());
-      assert(readers);
+      int tid = q_gettid();
+      {
+         AutoLocker al(l);
+         assert(write_tid == -1);
+         assert(rs_tid == tid);
 
-      // unlock rsection
-      rs_tid = -1;
+         // unlock rsection
+         rs_tid = -1;
 
-      qore_rsection_priv::notifyIntern();
+         qore_rsection_priv::notifyIntern();
+      }
 
-      if (!--readers)
-         unlock_read_signal();
+      // release the read lock
+      rdunlockIntern(readCount(tid));
    }
 
-   DLLLOCAL bool hasRSectionLock(int tid = gettid()) {
+   DLLLOCAL bool hasRSectionLock(int tid = q_gettid()) {
       return rs_tid == tid;
    }
 
-   DLLLOCAL bool checkRSectionExclusive(int tid = gettid()) {
+   DLLLOCAL bool checkRSectionExclusive(int tid = q_gettid()) {
       return (rs_tid == tid || write_tid == tid);
    }
 
@@ -296,11 +299,11 @@ public:
       static_cast<qore_rsection_priv*>(priv)->rSectionUnlock();
    }
 
-   DLLLOCAL bool hasRSectionLock(int tid = gettid()) {
+   DLLLOCAL bool hasRSectionLock(int tid = q_gettid()) {
       return static_cast<qore_rsection_priv*>(priv)->hasRSectionLock(tid);
    }
 
-   DLLLOCAL bool checkRSectionExclusive(int tid = gettid()) {
+   DLLLOCAL bool checkRSectionExclusive(int tid = q_gettid()) {
       return static_cast<qore_rsection_priv*>(priv)->checkRSectionExclusive(tid);
    }
 
@@ -508,7 +511,7 @@ protected:
    DLLLOCAL bool checkIntern(AbstractQoreNode* n);
 
    // queues nodes not scanned to tr_invalidate and tr_out
-   DLLLOCAL bool removeInvalidate(ObjectRSet* ors, int tid = gettid());
+   DLLLOCAL bool removeInvalidate(ObjectRSet* ors, int tid = q_gettid());
 
    DLLLOCAL bool inCurrentSet(omap_t::iterator fi) {
       for (size_t i = 0; i < ovec.size(); ++i)
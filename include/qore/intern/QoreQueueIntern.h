@@ -35,6 +35,7 @@
 
 #include <qore/QoreThreadLock.h>
 #include <qore/QoreCondition.h>
+#include <qore/intern/QoreLockStats.h>
 
 class QoreQueueNode {
 public:
@@ -86,6 +87,7 @@ private:
        max;   // the maximum size of the queue (or -1 for unlimited)
    unsigned read_waiting,   // number of threads waiting on reads
             write_waiting;  // number of threads waiting on writes
+   QoreLockStats* stats;    // optional contention statistics, 0 if not enabled
 
    DLLLOCAL int waitReadIntern(ExceptionSink *xsink, int timeout_ms);
    DLLLOCAL int waitWriteIntern(ExceptionSink *xsink, int timeout_ms);
@@ -97,12 +99,12 @@ private:
    DLLLOCAL void clearIntern(ExceptionSink* xsink);
 
 public:
-   DLLLOCAL qore_queue_private(int n_max = -1) : head(0), tail(0), len(0), max(n_max), read_waiting(0), write_waiting(0) {
+   DLLLOCAL qore_queue_private(int n_max = -1) : head(0), tail(0), len(0), max(n_max), read_waiting(0), write_waiting(0), stats(0) {
       assert(max);
       //printd(5, "qore_queue_private::qore_queue_private() this: %p max: %d\n", this, max);
    }
 
-   DLLLOCAL qore_queue_private(const qore_queue_private &orig) : head(0), tail(0), len(0), max(orig.max), read_waiting(0), write_waiting(0) {
+   DLLLOCAL qore_queue_private(const qore_queue_private &orig) : head(0), tail(0), len(0), max(orig.max), read_waiting(0), write_waiting(0), stats(0) {
       AutoLocker al(orig.l);
       if (orig.len == Queue_Deleted)
          return;
@@ -124,6 +126,7 @@ public:
       assert(!head);
       assert(!tail);
       assert(len == Queue_Deleted);
+      delete stats;
    }
 
    // push at the end of the queue and take the reference - can only be used when len == -1
@@ -161,6 +164,19 @@ public:
    DLLLOCAL void clear(ExceptionSink* xsink);
    DLLLOCAL void destructor(ExceptionSink* xsink);
 
+   // enables or disables contention statistics; disabling discards the statistics collected so far
+   DLLLOCAL void setLockStats(bool enable);
+   // returns the contention statistics or 0 if not enabled
+   DLLLOCAL QoreHashNode* getLockStats() const;
+
+   DLLLOCAL static void setLockStats(QoreQueue& q, bool enable) {
+      q.priv->setLockStats(enable);
+   }
+
+   DLLLOCAL static QoreHashNode* getLockStats(const QoreQueue& q) {
+      return q.priv->getLockStats();
+   }
+
    DLLLOCAL static void destructor(QoreQueue& q, ExceptionSink* xsink) {
       q.priv->destructor(xsink);
    }
@@ -0,0 +1,206 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+
+#ifndef _QORE_QORESOCKETEVENTLOOP_H
+#define _QORE_QORESOCKETEVENTLOOP_H
+
+#include <qore/intern/QoreDnsCache.h>
+
+#include <map>
+#include <deque>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#define QORE_EVLOOP_EPOLL 1
+#endif
+
+// the maximum number of events processed with one epoll_wait() call
+#define QORE_EVLOOP_MAX_EVENTS 256
+
+class QoreSocketAsyncOp;
+class QoreSocketEventLoop;
+struct qore_socket_private;
+
+// pending operations by timeout deadline (monotonic milliseconds)
+typedef std::multimap<int64, QoreSocketAsyncOp*> evloop_deadline_map_t;
+
+// an asynchronous connect, receive, or send operation on a Socket object
+class QoreSocketAsyncOp {
+public:
+   enum op_type { AO_CONNECT, AO_RECV, AO_SEND };
+
+   QoreSocketEventLoop* loop;         // the event loop running the operation
+   QoreObject* obj;                   // the Socket object
+   QoreSocketObject* s;               // the Socket object's private data
+   ResolvedCallReferenceNode* cb;     // the completion callback
+   QoreHashNode* error;               // the exception hash if the operation failed
+   op_type type;
+   int64 id;                          // unique ID used to identify events after the operation has completed
+   int fd;                            // the socket descriptor the operation is waiting on
+   int timeout_ms;
+   bool write,                        // true if waiting for the socket to become writable, false for readable
+      has_deadline,
+      restored,                       // true if the socket has been returned to blocking mode and released
+      timed_out;                      // true if the operation's timeout has expired
+   evloop_deadline_map_t::iterator di;
+
+   // connect: the target and the addresses to try in order
+   std::string host, service;
+   dns_addr_list_t addrs;
+   size_t ai;                         // the index of the address being connected
+   int last_err;                      // the error from the last address that could not be connected
+   bool ssl,                          // true if an SSL connection should be negotiated after connecting
+      connecting,                     // true if a non-blocking connect() is in progress
+      handshake;                      // true if the SSL handshake is in progress
+
+   // recv: the data received and the number of bytes requested (<= 0 = the first data available)
+   BinaryNode* data;
+   int64 size;
+
+   // send: the data to send (holds the string converted to the socket's encoding) and the send position
+   AbstractQoreNode* sdata;
+   const char* sbuf;
+   size_t slen, soff;
+
+   DLLLOCAL QoreSocketAsyncOp(op_type t, QoreObject* o, QoreSocketObject* n_s, const ResolvedCallReferenceNode* n_cb, int to);
+
+   DLLLOCAL const char* getMethodName() const;
+
+   // returns the callback argument, transferring the references to the caller
+   DLLLOCAL QoreHashNode* getHash(ExceptionSink* xsink);
+
+   DLLLOCAL void deref(ExceptionSink* xsink);
+};
+
+// drives non-blocking connect, receive, and send operations on Socket objects and runs their completion callbacks;
+// sockets are monitored with epoll where available, otherwise with poll(); operations can be started from any
+// thread, but the loop is run by one thread at a time, which also executes all callbacks
+class QoreSocketEventLoop : public AbstractPrivateData {
+protected:
+   typedef std::map<int64, QoreSocketAsyncOp*> evloop_id_map_t;
+   typedef std::deque<QoreSocketAsyncOp*> evloop_op_list_t;
+
+   QoreThreadLock l;
+   evloop_id_map_t imap;      // operations waiting for socket events by ID
+   evloop_deadline_map_t dmap;// waiting operations with a timeout
+   evloop_op_list_t done;     // completed operations whose callbacks have not yet been run
+   int64 seq;                 // the last operation ID assigned
+   int64 poll_until;          // the time the polling thread will wake up at the latest (-1 = no limit)
+   int wake_fd[2];            // pipe used to wake up the polling thread
+#ifdef QORE_EVLOOP_EPOLL
+   int epfd;
+#endif
+   int run_tid;               // the TID of the thread running the loop (0 = not running)
+   bool polling,              // true if the running thread is waiting for socket events
+      stop_req;               // true if the running thread should return
+
+   DLLLOCAL virtual ~QoreSocketEventLoop();
+
+   // wakes up the polling thread; must be called with the lock held
+   DLLLOCAL void wakeup();
+
+   // registers interest in the socket event the operation is waiting for; must be called with the lock held
+   DLLLOCAL int arm(QoreSocketAsyncOp* op, ExceptionSink* xsink);
+
+   // removes a waiting operation from the kernel and the maps; must be called with the lock held
+   DLLLOCAL void detach(QoreSocketAsyncOp* op);
+
+   // waits for socket events; returns the IDs of the operations whose sockets are ready and the operations that
+   // timed out (which have already been detached); called with the lock held and releases it while polling
+   DLLLOCAL int pollIntern(int64 until, std::vector<int64>& ready, evloop_op_list_t& expired, ExceptionSink* xsink);
+
+   // starts a new operation and registers it or queues it for its callback if it completes immediately
+   DLLLOCAL int start(QoreSocketAsyncOp* op, ExceptionSink* xsink);
+
+   // processes events and runs callbacks; returns the number of callbacks run
+   DLLLOCAL int runIntern(int64 timeout_ms, ExceptionSink* xsink);
+
+   // runs the callbacks for completed operations; returns the number of callbacks run
+   DLLLOCAL int runCallbacks(ExceptionSink* xsink);
+
+   // marks the start and end of a run() or runOnce() call
+   DLLLOCAL int enter(ExceptionSink* xsink);
+   DLLLOCAL void exit();
+
+   // cancels all pending operations without running their callbacks
+   DLLLOCAL void cancelAll(ExceptionSink* xsink);
+
+   // the following are called with the Socket object's lock held
+   // advances the operation as far as possible without blocking; returns 0 if the operation must wait for a socket
+   // event, 1 if it has completed (with an exception in xsink if it failed)
+   DLLLOCAL static int advance(QoreSocketAsyncOp* op, ExceptionSink* xsink);
+   DLLLOCAL static int advanceConnect(QoreSocketAsyncOp* op, qore_socket_private* sp, ExceptionSink* xsink);
+   DLLLOCAL static int advanceRecv(QoreSocketAsyncOp* op, qore_socket_private* sp, ExceptionSink* xsink);
+   DLLLOCAL static int advanceSend(QoreSocketAsyncOp* op, qore_socket_private* sp, ExceptionSink* xsink);
+   // returns the socket to blocking mode, releases it for other calls, and saves any exception in the operation
+   DLLLOCAL static void complete(QoreSocketAsyncOp* op, ExceptionSink& xs);
+
+   // cancels an operation without running its callback and deletes it
+   DLLLOCAL static void cancel(QoreSocketAsyncOp* op, ExceptionSink* xsink);
+
+   // advances and completes the operation with the Socket object's lock held; returns the same as advance() or -1 if
+   // the operation has already been completed by closed()
+   DLLLOCAL static int process(QoreSocketAsyncOp* op);
+
+   // claims the Socket object for an asynchronous operation and registers the operation with it
+   DLLLOCAL int claim(QoreSocketAsyncOp* op, bool open, ExceptionSink* xsink);
+
+public:
+   DLLLOCAL QoreSocketEventLoop(ExceptionSink* xsink);
+
+   DLLLOCAL virtual void deref(ExceptionSink* xsink);
+
+   // starts asynchronous operations on the given Socket object; the callback is called with the result by the
+   // thread running the loop
+   DLLLOCAL int connect(QoreObject* obj, QoreSocketObject* s, const char* target, const ResolvedCallReferenceNode* cb, int timeout_ms, bool ssl, ExceptionSink* xsink);
+   DLLLOCAL int recv(QoreObject* obj, QoreSocketObject* s, int64 size, const ResolvedCallReferenceNode* cb, int timeout_ms, ExceptionSink* xsink);
+   DLLLOCAL int send(QoreObject* obj, QoreSocketObject* s, const AbstractQoreNode* data, const ResolvedCallReferenceNode* cb, int timeout_ms, ExceptionSink* xsink);
+
+   // waits up to timeout_ms for events, processes them, and runs completion callbacks; returns the number of callbacks run
+   DLLLOCAL int runOnce(int64 timeout_ms, ExceptionSink* xsink);
+
+   // processes events and runs callbacks until stop() is called or a callback throws an exception
+   DLLLOCAL void run(ExceptionSink* xsink);
+
+   // makes a running run() call return
+   DLLLOCAL void stop();
+
+   // called with the Socket object's lock held when the socket of a pending operation is closed; the operation
+   // fails with a SOCKET-CLOSED error if it is waiting for a socket event, otherwise it detects the closed socket
+   // when it is processed
+   DLLLOCAL static void closed(QoreSocketAsyncOp* op);
+
+   // returns the number of pending operations, including completed operations whose callbacks have not been run
+   DLLLOCAL int64 size();
+};
+
+#endif
@@ -0,0 +1,135 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_QORESOCKETMULTIPLEXER_H
+#define _QORE_QORESOCKETMULTIPLEXER_H
+
+#include <map>
+#include <deque>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#define QORE_MUX_EPOLL 1
+#endif
+
+// the maximum number of events processed with one epoll_wait() call
+#define QORE_MUX_MAX_EVENTS 256
+
+class QoreSocketMuxEntry;
+
+// parked sockets by idle timeout deadline (monotonic milliseconds)
+typedef std::multimap<int64, QoreSocketMuxEntry*> mux_deadline_map_t;
+
+// a socket parked in a QoreSocketMultiplexer
+class QoreSocketMuxEntry {
+public:
+   QoreObject* obj;           // the Socket object
+   QoreSocketObject* s;       // the Socket object's private data
+   AbstractQoreNode* arg;     // the caller's argument
+   int64 id;                  // unique ID used to identify events after the entry has been removed
+   int fd;
+   bool timeout;              // true if returned because the idle timeout expired
+   bool has_deadline;
+   mux_deadline_map_t::iterator di;
+
+   DLLLOCAL QoreSocketMuxEntry(QoreObject* o, QoreSocketObject* n_s, AbstractQoreNode* a, int64 n_id, int n_fd) : obj(o), s(n_s), arg(a), id(n_id), fd(n_fd), timeout(false), has_deadline(false) {
+   }
+
+   // returns the entry as a hash, transferring the references to the caller
+   DLLLOCAL QoreHashNode* getHash(ExceptionSink* xsink);
+
+   DLLLOCAL void deref(ExceptionSink* xsink);
+};
+
+// parks idle sockets in the kernel (with epoll where available, otherwise with poll()) and returns them to waiting
+// threads one at a time when they become readable or their idle timeout expires; one waiting thread polls the kernel
+// while the others wait on a condition variable, so any number of threads can wait for sockets
+class QoreSocketMultiplexer : public AbstractPrivateData {
+protected:
+   typedef std::map<int64, QoreSocketMuxEntry*> mux_id_map_t;
+   typedef std::map<QoreSocketObject*, QoreSocketMuxEntry*> mux_socket_map_t;
+   typedef std::deque<QoreSocketMuxEntry*> mux_ready_list_t;
+
+   QoreThreadLock l;
+   QoreCondition cond;        // signaled when sockets are ready or the polling thread returns
+   mux_id_map_t imap;         // parked sockets by ID
+   mux_socket_map_t smap;     // parked sockets by private data
+   mux_deadline_map_t dmap;   // parked sockets with an idle timeout
+   mux_ready_list_t ready;    // sockets ready to be returned
+   int64 seq;                 // the last entry ID assigned
+   int64 poll_until;          // the time the polling thread will wake up at the latest (-1 = no limit)
+   int wake_fd[2];            // pipe used to wake up the polling thread
+#ifdef QORE_MUX_EPOLL
+   int epfd;
+#endif
+   bool polling,              // true if a thread is polling the kernel
+      stopped;
+
+   DLLLOCAL virtual ~QoreSocketMultiplexer();
+
+   // wakes up the polling thread; must be called with the lock held
+   DLLLOCAL void wakeup();
+
+   // removes the entry from the maps but not from the ready list; must be called with the lock held
+   DLLLOCAL void detach(QoreSocketMuxEntry* e);
+
+   // waits for events and moves ready sockets to the ready list; called with the lock held and releases it while polling
+   DLLLOCAL int pollIntern(int64 until, ExceptionSink* xsink);
+
+   // moves sockets whose idle timeout has expired to the ready list; must be called with the lock held
+   DLLLOCAL void expire(int64 now);
+
+   // clears the socket's reference to the multiplexer after it has been returned or removed; must be called without
+   // the lock held, as the socket's lock is acquired first when the socket is closed
+   DLLLOCAL void unpark(QoreSocketObject* s);
+
+public:
+   DLLLOCAL QoreSocketMultiplexer(ExceptionSink* xsink);
+
+   DLLLOCAL virtual void deref(ExceptionSink* xsink);
+
+   // parks the given Socket object until it is readable; takes over the references to "s" (the object's private data) and "arg"
+   DLLLOCAL int add(QoreObject* obj, QoreSocketObject* s, AbstractQoreNode* arg, int64 idle_timeout_ms, ExceptionSink* xsink);
+
+   // called with the socket's lock held when a parked socket is closed; the socket is returned as if it were readable
+   DLLLOCAL void closed(QoreSocketObject* s);
+
+   // removes the given socket if it is parked and returns true, otherwise returns false
+   DLLLOCAL bool remove(QoreSocketObject* s, ExceptionSink* xsink);
+
+   // waits for a socket to become readable or for its idle timeout to expire; returns 0 on timeout or if stopped
+   DLLLOCAL QoreHashNode* wait(int64 timeout_ms, ExceptionSink* xsink);
+
+   // wakes up all waiting threads and returns all parked sockets; no more sockets can be added afterwards
+   DLLLOCAL QoreListNode* stop(ExceptionSink* xsink);
+
+   DLLLOCAL int64 size();
+};
+
+#endif
@@ -36,9 +36,16 @@
 // FIXME: move to config.h or something like that
 // not more than this number of threads can be running at the same time
 #ifndef MAX_QORE_THREADS
-#define MAX_QORE_THREADS 0x1000
+#define MAX_QORE_THREADS 0x100000
 #endif
 
+// the thread entry table is allocated on demand in segments of this many entries
+#ifndef QORE_THREAD_SEGMENT_BITS
+#define QORE_THREAD_SEGMENT_BITS 10
+#endif
+#define QORE_THREAD_SEGMENT_SIZE (1 << QORE_THREAD_SEGMENT_BITS)
+#define QORE_THREAD_SEGMENT_MASK (QORE_THREAD_SEGMENT_SIZE - 1)
+
 class ThreadData;
 class CallStack;
 class CallNode;
@@ -59,30 +66,31 @@ class CallNode;
 #define MAX_QORE_THREADS 2560
 #endif
 
-class tid_node {
-public:
-   int tid;
-   tid_node* next, *prev;
-
-   DLLLOCAL tid_node(int ntid);
-   DLLLOCAL ~tid_node();
-};
+// the number of segment pointers in the thread entry directory
+#define QORE_THREAD_SEGMENTS ((MAX_QORE_THREADS + QORE_THREAD_SEGMENT_SIZE - 1) / QORE_THREAD_SEGMENT_SIZE)
 
 // this structure holds all thread data that can be addressed with the qore tid
 class ThreadEntry {
 public:
    pthread_t ptid;
-   tid_node* tidnode;
 #ifdef QORE_RUNTIME_THREAD_STACK_TRACE
    CallStack* callStack;
 #endif
    ThreadData* thread_data;
+   // the next TID in the free list + 1 (0 = end of list)
+   int next_free;
+   // incremented each time the entry is allocated
+   unsigned generation;
+#ifdef QORE_BIASED_REFCOUNT
+   // the thread's reference count owner ID while it updates biased reference counts; read without locking
+   volatile int64 owner_id;
+#endif
    unsigned char status;
    bool joined; // if set to true then pthread_detach should not be called on exit
 
    DLLLOCAL void cleanup();
 
-   DLLLOCAL void allocate(tid_node* tn, int stat = QTS_NA);
+   DLLLOCAL void allocate(int stat = QTS_NA);
 
    DLLLOCAL void activate(int tid, pthread_t n_ptid, QoreProgram* p, bool foreign = false);
 
@@ -95,55 +103,120 @@ public:
    }
 };
 
+// the thread entry table grows in fixed-size segments that are never freed or moved, so entries can be
+// looked up by TID in constant time without locking; TIDs are allocated and recycled without locking;
+// the lock is only held when activating and releasing threads and when iterating active threads
 class QoreThreadList {
 friend class QoreThreadListIterator;
-friend class tid_node;
 protected:
    mutable QoreThreadLock l;
-   unsigned num_threads;
-   ThreadEntry entry[MAX_QORE_THREADS];
+   volatile unsigned num_threads;
 
-   tid_node* tid_head, * tid_tail;
+   // thread entry segment directory; segments are allocated on demand
+   ThreadEntry* volatile seg[QORE_THREAD_SEGMENTS];
+
+   // number of entries covered by allocated segments
+   volatile int capacity;
 
    // current TID to be issued next
-   int current_tid;
+   volatile int current_tid;
+
+   // free TID stack: the high 32 bits are an ABA tag, the low 32 bits are the TID at the head + 1
+   volatile int64 free_head;
 
    bool exiting;
 
+   DLLLOCAL ThreadEntry& entry(int tid) const {
+      assert(tid >= 0 && tid < capacity);
+      return seg[tid >> QORE_THREAD_SEGMENT_BITS][tid & QORE_THREAD_SEGMENT_MASK];
+   }
+
+   // adds a new segment to the table if the capacity has not changed; returns -1 if the table is full
+   DLLLOCAL int grow(int cap) {
+      if (cap >= MAX_QORE_THREADS)
+         return -1;
+
+      int si = cap >> QORE_THREAD_SEGMENT_BITS;
+      if (!seg[si]) {
+         ThreadEntry* ns = new ThreadEntry[QORE_THREAD_SEGMENT_SIZE]();
+         if (!qore_atomic_cas(&seg[si], (ThreadEntry*)0, ns))
+            delete [] ns;
+      }
+      int ncap = cap + QORE_THREAD_SEGMENT_SIZE;
+      if (ncap > MAX_QORE_THREADS)
+         ncap = MAX_QORE_THREADS;
+      qore_atomic_cas(&capacity, cap, ncap);
+      return 0;
+   }
+
+   // returns a new free list head with an incremented ABA tag
+   DLLLOCAL static int64 nextFreeHead(int64 h, int v) {
+      unsigned long long tag = ((unsigned long long)h >> 32) + 1;
+      return (int64)((tag << 32) | (unsigned)v);
+   }
+
+   DLLLOCAL void pushFree(int tid) {
+      ThreadEntry& te = entry(tid);
+      while (true) {
+         int64 h = free_head;
+         te.next_free = (int)(h & 0xffffffff);
+         if (qore_atomic_cas(&free_head, h, nextFreeHead(h, tid + 1)))
+            break;
+      }
+   }
+
+   // returns -1 if no TID is available in the free list
+   DLLLOCAL int popFree() {
+      while (true) {
+         int64 h = free_head;
+         int tid = (int)(h & 0xffffffff) - 1;
+         if (tid < 0)
+            return -1;
+         if (qore_atomic_cas(&free_head, h, nextFreeHead(h, entry(tid).next_free)))
+            return tid;
+      }
+   }
+
    DLLLOCAL void releaseIntern(int tid) {
       // NOTE: cannot safely call printd here, because normally the thread_data has been deleted
       //printf("DEBUG: ThreadList.releaseIntern() TID %d terminated\n", tid);
-      entry[tid].cleanup();
-      if (tid)
-         --num_threads;
+      entry(tid).cleanup();
+      if (tid) {
+         pushFree(tid);
+         qore_atomic_sub(&num_threads, 1u);
+      }
    }
 
 public:
-   DLLLOCAL QoreThreadList() : num_threads(0), tid_head(0), tid_tail(0), current_tid(1), exiting(false) {
+   DLLLOCAL QoreThreadList() : num_threads(0), capacity(0), current_tid(1), free_head(0), exiting(false) {
+      memset((void*)seg, 0, sizeof(seg));
+      grow(0);
    }
 
    DLLLOCAL int get(int status = QTS_NA) {
-      int tid = -1;
-      AutoLocker al(l);
-
-      if (current_tid == MAX_QORE_THREADS) {
-         int i;
-         // scan thread_list for free entry
-         for (i = 1; i < MAX_QORE_THREADS; i++) {
-            if (entry[i].available()) {
-               tid = i;
-               goto finish;
+      int tid;
+      while (true) {
+         int cap = capacity;
+         int c = current_tid;
+         // issue TIDs in order until the allocated segments are exhausted
+         if (c < cap) {
+            if (qore_atomic_cas(&current_tid, c, c + 1)) {
+               tid = c;
+               break;
             }
+            continue;
          }
-         if (i == MAX_QORE_THREADS)
+         // then recycle released TIDs
+         tid = popFree();
+         if (tid != -1)
+            break;
+         // and only allocate a new segment if there are no free TIDs
+         if (grow(cap))
             return -1;
       }
-      else
-         tid = current_tid++;
 
-   finish:
-      entry[tid].allocate(new tid_node(tid), status);
-      ++num_threads;
+      entry(tid).allocate(status);
+      qore_atomic_add(&num_threads, 1u);
       //printf("t%d cs=0\n", tid);
 
       return tid;
@@ -151,7 +224,7 @@ public:
 
    DLLLOCAL int getSignalThreadEntry() {
       AutoLocker al(l);
-      entry[0].allocate(0);
+      entry(0).allocate();
       return 0;
    }
 
@@ -161,8 +234,11 @@ public:
    }
 
    DLLLOCAL int releaseReserved(int tid) {
+      if (!valid(tid))
+         return -1;
+
       AutoLocker al(l);
-      if (entry[tid].status != QTS_RESERVED)
+      if (entry(tid).status != QTS_RESERVED)
          return -1;
 
       releaseIntern(tid);
@@ -171,13 +247,19 @@ public:
 
    DLLLOCAL void activate(int tid, pthread_t ptid = pthread_self(), QoreProgram* p = 0, bool foreign = false) {
       AutoLocker al(l);
-      entry[tid].activate(tid, ptid, p, foreign);
+      entry(tid).activate(tid, ptid, p, foreign);
+   }
+
+   // marks the thread's pthread as one that outlives the qore thread so it is not detached on release
+   DLLLOCAL void setJoined(int tid) {
+      AutoLocker al(l);
+      entry(tid).joined = true;
    }
 
    DLLLOCAL void setStatus(int tid, int status) {
       AutoLocker al(l);
-      assert(entry[tid].status != status);
-      entry[tid].status = status;
+      assert(entry(tid).status != status);
+      entry(tid).status = status;
    }
 
    DLLLOCAL void deleteData(int tid);
@@ -187,15 +269,32 @@ public:
    DLLLOCAL void deleteDataReleaseSignalThread();
 
    DLLLOCAL int activateReserved(int tid) {
+      if (!valid(tid))
+         return -1;
+
       AutoLocker al(l);
 
-      if (entry[tid].status != QTS_RESERVED)
+      if (entry(tid).status != QTS_RESERVED)
          return -1;
 
-      entry[tid].activate(tid, pthread_self(), 0, true);
+      entry(tid).activate(tid, pthread_self(), 0, true);
       return 0;
    }
 
+   // returns true if the TID is covered by the thread entry table
+   DLLLOCAL bool valid(int tid) const {
+      return tid >= 0 && tid < capacity;
+   }
+
+#ifdef QORE_BIASED_REFCOUNT
+   // returns true if the thread with the given owner ID still updates biased reference counts; segments are never
+   // freed, so the entry can be read without locking
+   DLLLOCAL bool activeOwner(int64 owner_id) const {
+      int tid = (int)(owner_id & 0xffffffff);
+      return valid(tid) && qore_atomic_get(&entry(tid).owner_id) == owner_id;
+   }
+#endif
+
    DLLLOCAL unsigned getNumThreads() const {
       return num_threads;
    }
@@ -212,7 +311,7 @@ public:
    DLLLOCAL QoreListNode* getCallStackList();
 
    DLLLOCAL CallStack* getCallStack() {
-      return entry[gettid()].callStack;
+      return entry(gettid()).callStack;
    }
 #endif
 
@@ -222,23 +321,27 @@ DLLLOCAL extern QoreThreadList thread_list;
 
 class QoreThreadListIterator : public AutoLocker {
 protected:
-   tid_node* w;
+   int w;
 
 public:
    DLLLOCAL QoreThreadListIterator() : AutoLocker(thread_list.l), w(0) {
    }
 
+   // skips the signal thread entry (TID 0) and all entries that are not active
    DLLLOCAL bool next() {
-      do {
-         w = w ? w->next : thread_list.tid_head;
-      } while (w && (!w->tid || (thread_list.entry[w->tid].status != QTS_ACTIVE)));
-
-      return (bool)w;
+      int max = thread_list.current_tid;
+      if (max > thread_list.capacity)
+         max = thread_list.capacity;
+      while (++w < max) {
+         if (thread_list.entry(w).status == QTS_ACTIVE)
+            return true;
+      }
+      return false;
    }
 
    DLLLOCAL unsigned operator*() const {
-      assert(w);
-      return w->tid;
+      assert(w > 0);
+      return w;
    }
 };
 
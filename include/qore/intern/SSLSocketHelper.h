@@ -57,6 +57,9 @@ private:
 
    // non-blocking I/O helper
    DLLLOCAL int doSSLUpgradeNonBlockingIO(int rc, const char* mname, int timeout_ms, const char* ssl_func, bool& closed, ExceptionSink* xsink);
+
+   // processes the result of one non-blocking SSL call for the step functions below
+   DLLLOCAL int doSSLStep(int rc, const char* mname, const char* ssl_func, bool read, int& want, bool& closed, ExceptionSink* xsink);
    
 public:
    DLLLOCAL SSLSocketHelper(qore_socket_private& n_qs) : qs(n_qs), meth(0), ctx(0), ssl(0) {
@@ -85,10 +88,24 @@ public:
    DLLLOCAL int read(const char* mname, char* buf, int size, int timeout_ms, ExceptionSink* xsink);
    // returns 0 for success
    DLLLOCAL int write(const char* mname, const void* buf, int size, int timeout_ms, ExceptionSink* xsink);
+   // non-blocking steps for sockets driven by an event loop; the socket must already be in non-blocking mode
+   // each returns a positive value on success (the number of bytes transferred for reads and writes); if the call
+   // must be repeated when the socket is ready, -1 is returned with "want" set to SSL_ERROR_WANT_READ or
+   // SSL_ERROR_WANT_WRITE and no exception is raised; readStep() returns 0 if the remote end closed the connection;
+   // otherwise an exception is raised and -1 is returned; if closed is returned as true, then the SSLSocketHelper
+   // object has been deleted
+   DLLLOCAL int connectStep(const char* mname, int& want, bool& closed, ExceptionSink* xsink);
+   DLLLOCAL int readStep(const char* mname, char* buf, int size, int& want, bool& closed, ExceptionSink* xsink);
+   DLLLOCAL int writeStep(const char* mname, const void* buf, int size, int& want, bool& closed, ExceptionSink* xsink);
    DLLLOCAL const char* getCipherName() const;
    DLLLOCAL const char* getCipherVersion() const;
    DLLLOCAL X509* getPeerCertificate() const;
    DLLLOCAL long verifyPeerCertificate() const;
+
+   // returns true if decrypted data is buffered in the SSL object that can be read without reading from the socket
+   DLLLOCAL bool pending() const {
+      return ssl && SSL_pending(ssl) > 0;
+   }
 };
 
 #endif
@@ -33,16 +33,25 @@
 
 #define _QORE_SEQUENCE_H
 
-#include <qore/QoreThreadLock.h>
+#include <qore/intern/qore_atomic.h>
 
-class Sequence : public QoreThreadLock {
+// a thread-safe increment-only sequence; values are updated with 64-bit atomic operations
+class Sequence {
 private:
-   int val;
+   volatile int64 val;
 
 public:
-   DLLLOCAL Sequence(int start = 0);
-   DLLLOCAL int next();
-   DLLLOCAL int getCurrent() const;
+   DLLLOCAL Sequence(int64 start = 0) : val(start) {
+   }
+
+   // atomically increments the sequence and returns the previous value
+   DLLLOCAL int64 next() {
+      return qore_atomic_add(&val, (int64)1) - 1;
+   }
+
+   DLLLOCAL int64 getCurrent() const {
+      return qore_atomic_get(&val);
+   }
 };
 
 #endif
@@ -0,0 +1,643 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  ThreadData.h
+
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_THREADDATA_H
+#define _QORE_THREADDATA_H
+
+#if defined(__ia64) && defined(__LP64__)
+#define IA64_64
+#endif
+
+class ThreadResourceList;
+
+class ThreadLocalVariableData : public ThreadLocalData<LocalVarValue> {
+public:
+   // marks all variables as finalized on the stack
+   DLLLOCAL void finalize(arg_vec_t*& cl) {
+      ThreadLocalVariableData::iterator i(curr);
+      while (i.next()) {
+         AbstractQoreNode* n = i.get().finalize();
+         if (n && n->isReferenceCounted()) {
+            if (!cl)
+               cl = new arg_vec_t;
+            cl->push_back(n);
+         }
+      }
+   }
+
+   // deletes everything on the stack
+   DLLLOCAL void del(ExceptionSink* xsink) {
+      // then we uninstantiate
+      while (curr->prev || curr->pos)
+         uninstantiate(xsink);
+   }
+
+   DLLLOCAL LocalVarValue* instantiate() {
+      if (curr->pos == QORE_THREAD_STACK_BLOCK) {
+	 if (curr->next)
+	    curr = curr->next;
+	 else {
+	    curr->next = new Block(curr);
+	    //printf("this: %p: add curr: %p, curr->next: %p\n", this, curr, curr->next);
+	    curr = curr->next;
+	 }
+      }
+      return &curr->var[curr->pos++];
+   }
+
+   DLLLOCAL void uninstantiate(ExceptionSink* xsink) {
+      if (!curr->pos) {
+	 if (curr->next) {
+	    //printf("this %p: del curr: %p, curr->next: %p\n", this, curr, curr->next);
+	    delete curr->next;
+	    curr->next = 0;
+	 }
+	 curr = curr->prev;
+      }
+      curr->var[--curr->pos].uninstantiate(xsink);
+   }
+
+   DLLLOCAL LocalVarValue* find(const char* id) {
+      Block* w = curr;
+      while (true) {
+	 int p = w->pos;
+	 while (p) {
+	    if (w->var[--p].id == id && !w->var[p].skip)
+	       return &w->var[p];
+	 }
+	 w = w->prev;
+#ifdef DEBUG
+	 if (!w) {
+            printd(0, "ThreadLocalVariableData::find() this: %p no local variable '%s' (%p) on stack (pgm: %p) p: %d\n", this, id, id, getProgram(), p);
+            p = curr->pos - 1;
+            while (p >= 0) {
+               printd(0, "var p: %d: %s (%p) (skip: %d)\n", p, curr->var[p].id, curr->var[p].id, curr->var[p].skip);
+               --p;
+            }
+         }
+#endif
+	 assert(w);
+      }
+      // to avoid a warning on most compilers - note that this generates a warning on recent versions of aCC!
+      return 0;
+   }
+};
+
+class ThreadClosureVariableStack : public ThreadLocalData<ClosureVarValue*> {
+private:
+   DLLLOCAL void instantiate(ClosureVarValue* cvar) {
+      //printd(5, "ThreadClosureVariableStack::instantiate(%p = '%s') this: %p pgm: %p\n", cvar->id, cvar->id, this, getProgram());
+
+      if (curr->pos == QORE_THREAD_STACK_BLOCK) {
+	 if (curr->next)
+	    curr = curr->next;
+	 else {
+	    curr->next = new Block(curr);
+	    //printf("this: %p: add curr: %p, curr->next: %p\n", this, curr, curr->next);
+	    curr = curr->next;
+	 }
+      }
+      curr->var[curr->pos++] = cvar;
+   }
+
+public:
+   // marks all variables as finalized on the stack
+   DLLLOCAL void finalize(arg_vec_t*& cl) {
+      ThreadClosureVariableStack::iterator i(curr);
+      while (i.next()) {
+         AbstractQoreNode* n = i.get()->finalize();
+         if (n && n->isReferenceCounted()) {
+            if (!cl)
+               cl = new arg_vec_t;
+            cl->push_back(n);
+         }
+      }
+   }
+
+   // deletes everything on the stack
+   DLLLOCAL void del(ExceptionSink* xsink) {
+      while (curr->prev || curr->pos)
+         uninstantiate(xsink);
+   }
+
+   DLLLOCAL ClosureVarValue* instantiate(const char* id, const QoreTypeInfo* typeInfo, QoreValue& nval) {
+      ClosureVarValue* cvar = new ClosureVarValue(id, typeInfo, nval);
+      instantiate(cvar);
+      return cvar;
+   }
+
+   DLLLOCAL void uninstantiate(ExceptionSink* xsink) {
+#if 0
+      if (!curr->pos)
+         printd(5, "ThreadClosureVariableStack::uninstantiate() this: %p pos: %d %p %s\n", this, curr->prev->pos - 1, curr->prev->var[curr->prev->pos - 1]->id, curr->prev->var[curr->prev->pos - 1]->id);
+      else
+         printd(5, "ThreadClosureVariableStack::uninstantiate() this: %p pos: %d %p %s\n", this, curr->pos - 1, curr->var[curr->pos - 1]->id, curr->var[curr->pos - 1]->id);
+#endif
+      if (!curr->pos) {
+	 if (curr->next) {
+	    //printf("this %p: del curr: %p, curr->next: %p\n", this, curr, curr->next);
+	    delete curr->next;
+	    curr->next = 0;
+	 }
+	 curr = curr->prev;
+      }
+      curr->var[--curr->pos]->deref(xsink);
+   }
+
+   DLLLOCAL ClosureVarValue* find(const char* id) {
+      //printd(5, "ThreadClosureVariableStack::find() this: %p id: %p\n", this, id);
+      Block* w = curr;
+      while (true) {
+	 int p = w->pos;
+	 while (p) {
+	    //printd(5, "ThreadClosureVariableStack::find(%p '%s') this: %p checking %p '%s' skip: %d\n", id, id, this, w->var[p - 1]->id, w->var[p - 1]->id, w->var[p - 1]->skip);
+	    if (w->var[--p]->id == id && !w->var[p]->skip) {
+	       //printd(5, "ThreadClosureVariableStack::find(%p '%s') this: %p returning: %p\n", id, id, this, w->var[p]);
+	       return w->var[p];
+	    }
+	 }
+	 w = w->prev;
+#ifdef DEBUG
+	 if (!w) {
+	    //printd(5, "ThreadClosureVariableStack::find() this: %p no closure-bound local variable '%s' (%p) on stack (pgm: %p) p: %d curr->prev: %p\n", this, id, id, getProgram(), p, curr->prev);
+            p = curr->pos - 1;
+            while (p >= 0) {
+               //printd(5, "var p: %d: %s (%p) (skip: %d)\n", p, curr->var[p]->id, curr->var[p]->id, curr->var[p]->skip);
+               --p;
+            }
+         }
+#endif
+	 assert(w);
+      }
+      // to avoid a warning on most compilers - note that this generates a warning on recent versions of aCC!
+      return 0;
+   }
+};
+
+struct ThreadLocalProgramData {
+private:
+   // not implemented
+   DLLLOCAL ThreadLocalProgramData(const ThreadLocalProgramData& old);
+
+public:
+   // local variable data slots
+   ThreadLocalVariableData lvstack;
+   // closure variable stack
+   ThreadClosureVariableStack cvstack;
+   // current thread's time zone locale (if any)
+   const AbstractQoreZoneInfo* tz;
+   // the "time zone set" flag
+   bool tz_set : 1;
+
+   // top-level vars instantiated
+   bool inst : 1;
+
+   DLLLOCAL ThreadLocalProgramData() : tz(0), tz_set(false), inst(false) {
+      //printd(5, "ThreadLocalProgramData::ThreadLocalProgramData() this: %p\n", this);
+   }
+
+   DLLLOCAL ~ThreadLocalProgramData() {
+      assert(lvstack.empty());
+      assert(cvstack.empty());
+   }
+
+   DLLLOCAL void finalize(arg_vec_t*& cl) {
+      lvstack.finalize(cl);
+      cvstack.finalize(cl);
+   }
+
+   DLLLOCAL void del(ExceptionSink* xsink) {
+      lvstack.del(xsink);
+      cvstack.del(xsink);
+      delete this;
+   }
+
+   DLLLOCAL void setTZ(const AbstractQoreZoneInfo* n_tz) {
+      tz_set = true;
+      tz = n_tz;
+   }
+
+   DLLLOCAL void clearTZ() {
+      tz_set = false;
+      tz = 0;
+   }
+};
+
+class ArgvRefStack {
+protected:
+   typedef std::vector<int> rvec_t;
+   rvec_t stack;
+   // ignore numeric count
+   int in;
+
+public:
+   DLLLOCAL ArgvRefStack() : in(0) {
+      stack.push_back(0);
+   }
+   DLLLOCAL ~ArgvRefStack() {
+   }
+   DLLLOCAL void push() {
+      stack.push_back(0);
+   }
+   DLLLOCAL int pop() {
+      int rc = stack[stack.size() - 1];
+      if (stack.size() > 1)
+	 stack.pop_back();
+      else
+	 stack[0] = 0;
+      return rc;
+   }
+   DLLLOCAL int get() {
+      assert(stack.size() == 1);
+      int rc = stack[0];
+      stack[0] = 0;
+      return rc;
+   }
+   DLLLOCAL void push_numeric() {
+      ++in;
+   }
+   DLLLOCAL void pop_numeric() {
+      --in;
+      assert(in >= 0);
+   }
+   DLLLOCAL void inc_numeric() {
+      if (in)
+	 return;
+      inc();
+   }
+   DLLLOCAL void inc() {
+      ++stack[stack.size() - 1];
+   }
+   DLLLOCAL void clear() {
+      stack.clear();
+      stack.push_back(0);
+   }
+};
+
+struct ParseCountHelper {
+   unsigned count;
+
+   DLLLOCAL ParseCountHelper() : count(0) {
+   }
+
+   DLLLOCAL void inc() {
+      ++count;
+   }
+
+   DLLLOCAL bool dec() {
+      if (!count) {
+         parse_error("unmatched %%endtry");
+         return false;
+      }
+      return !--count;
+   }
+
+   DLLLOCAL void purge() {
+      if (count) {
+         parse_error("%d %%try-module block%s left open at end of file", count, count == 1 ? "" : "s");
+         count = 0;
+      }
+   }
+};
+
+struct ParseConditionalStack {
+   unsigned count;
+   typedef std::vector<unsigned> ui_vec_t;
+   ui_vec_t markvec;
+
+   DLLLOCAL ParseConditionalStack() : count(0) {
+   }
+
+   DLLLOCAL void push(bool do_mark = false) {
+      if (do_mark) {
+         markvec.push_back(count);
+      }
+      ++count;
+   }
+
+   DLLLOCAL bool checkElse() {
+      return count;
+   }
+
+   DLLLOCAL bool test() const {
+      if (!count) {
+         parse_error("%%else without %%ifdef");
+         return false;
+      }
+      if (markvec.empty())
+         return false;
+      return markvec.back() == (count - 1);
+   }
+
+   DLLLOCAL bool pop() {
+      if (!count) {
+         parse_error("unmatched %%endif");
+         return false;
+      }
+      --count;
+      assert(!markvec.empty());
+      if (count == markvec.back()) {
+         markvec.pop_back();
+         return true;
+      }
+      return false;
+   }
+
+   DLLLOCAL void purge() {
+      if (count) {
+         parse_error("%d conditional block%s left open at end of file", count, count == 1 ? "" : "s");
+         count = 0;
+         markvec.clear();
+      }
+   }
+};
+
+class ProgramParseContext {
+public:
+   const char* file, * src;
+   void* parseState;
+   int offset;
+   ParseConditionalStack* pcs;
+   ProgramParseContext* next;
+
+   DLLLOCAL ProgramParseContext(const char* fname, void* ps, const char* psrc, int off, ParseConditionalStack* ppcs, ProgramParseContext* n) : file(fname), src(psrc), parseState(ps), offset(off), pcs(ppcs), next(n) {
+   }
+};
+
+// for detecting circular references at runtime
+typedef std::set<const lvalue_ref*> ref_set_t;
+
+// this structure holds all thread-specific data
+class ThreadData {
+public:
+   int64 runtime_po;
+   int tid;
+   VLock vlock;     // for deadlock detection
+   Context* context_stack;
+   ProgramParseContext* plStack;
+   QoreProgramLocation parse_loc;
+   QoreProgramLocation runtime_loc;
+   const char* parse_code; // the current function, method, or closure being parsed
+   void* parseState;
+   VNode* vstack;  // used during parsing (local variable stack)
+   CVNode* cvarstack;
+   QoreClass* parseClass; // current class being parsed
+   QoreException* catchException;
+   std::list<block_list_t::iterator> on_block_exit_list;
+   ThreadResourceList* trlist;
+
+   // for detecting circular references at runtime
+   ref_set_t ref_set;
+
+   // current function/method name
+   const char* current_code;
+
+   // current object context
+   ClassObj current_classobj;
+
+   // current program context
+   QoreProgram* current_pgm;
+
+   // current namespace context for parsing
+   qore_ns_private* current_ns;
+
+   // current implicit argument
+   QoreListNode* current_implicit_arg;
+
+   // this data structure is stored in the current Program object on a per-thread basis
+   ThreadLocalProgramData* tlpd;
+
+   // this data structure contains the set of Program objects that this thread has data in
+   ThreadProgramData* tpd;
+
+   // current parsing closure environment
+   ClosureParseEnvironment* closure_parse_env;
+
+   // current runtime closure environment
+   const QoreClosureBase* closure_rt_env;
+
+   ArgvRefStack argv_refs;
+
+#ifdef QORE_MANAGE_STACK
+   size_t stack_limit;
+#ifdef IA64_64
+   size_t rse_limit;
+#endif
+#endif
+
+   // used to detect output of recursive data structures at runtime
+   const_node_set_t node_set;
+
+   // currently-executing/parsing block's return type
+   const QoreTypeInfo* returnTypeInfo;
+
+   // parse-time block return type
+   const QoreTypeInfo* parse_return_type_info;
+
+   // current implicit element offset
+   int element;
+
+   // start of global thread-local variables for the current thread and program being parsed
+   VNode* global_vnode;
+
+   // Maintains the conditional parse block count for each file parsed
+   ParseConditionalStack* pcs;
+
+   // Maintains the %try-module block count for each file
+   ParseCountHelper tm;
+
+   // for capturing namespace and class names while parsing
+   typedef std::vector<std::string> npvec_t;
+   npvec_t npvec;
+
+   // used for error handling when merging module code into a Program object
+   QoreModuleContext* qmc;
+
+   // used to capture the module definition in user modules
+   QoreModuleDefContext* qmd;
+
+   // user to track the current user module context
+   const char* user_module_context_name;
+
+   // AbstractQoreModule* with boolean ptr in bit 0
+   uintptr_t qmi;
+
+   bool
+   foreign : 1; // true if the thread is a foreign thread
+
+   DLLLOCAL ThreadData(int ptid, QoreProgram* p, bool n_foreign = false);
+
+   DLLLOCAL ~ThreadData();
+
+   DLLLOCAL void endFileParsing() {
+      if (pcs) {
+         pcs->purge();
+         delete pcs;
+         pcs = 0;
+      }
+      tm.purge();
+   }
+
+   DLLLOCAL int getElement() {
+      return element;
+   }
+
+   DLLLOCAL int saveElement(int n_element) {
+      int rc = element;
+      element = n_element;
+      return rc;
+   }
+
+   DLLLOCAL void del(ExceptionSink* xsink) {
+      tpd->del(xsink);
+      tpd->deref();
+      tpd = 0;
+   }
+
+   DLLLOCAL void pushName(const char* name) {
+      npvec.push_back(name);
+   }
+
+   DLLLOCAL std::string popName() {
+      assert(!npvec.empty());
+      std::string rv = npvec.back();
+      npvec.pop_back();
+      return rv;
+   }
+
+   DLLLOCAL void parseRollback() {
+      npvec.clear();
+   }
+
+   DLLLOCAL qore_ns_private* set_ns(qore_ns_private* ns) {
+      if (ns == current_ns)
+         return ns;
+
+      qore_ns_private* rv = current_ns;
+      current_ns = ns;
+      return rv;
+   }
+};
+
+#ifdef QORE_HAVE_NATIVE_TLS
+// returns the current thread's data or 0 if the current thread is not registered
+DLLLOCAL inline ThreadData* q_get_thread_data() {
+   return q_thread_data;
+}
+#else
+// returns the current thread's data or 0 if the current thread is not registered; the data is stored with
+// QoreThreadLocalStorage, so this is not inlined
+DLLLOCAL ThreadData* q_get_thread_data();
+#endif
+
+// the following accessors are called for every local variable and closure access and every statement executed,
+// so they are defined here so that they can be inlined in the library
+
+// returns the current thread's Program
+DLLLOCAL inline QoreProgram* q_get_program() {
+   return q_get_thread_data()->current_pgm;
+}
+
+DLLLOCAL inline LocalVarValue* thread_instantiate_lvar() {
+   return q_get_thread_data()->tlpd->lvstack.instantiate();
+}
+
+DLLLOCAL inline void thread_uninstantiate_lvar(ExceptionSink* xsink) {
+   q_get_thread_data()->tlpd->lvstack.uninstantiate(xsink);
+}
+
+DLLLOCAL inline LocalVarValue* thread_find_lvar(const char* id) {
+   return q_get_thread_data()->tlpd->lvstack.find(id);
+}
+
+DLLLOCAL inline ClosureVarValue* thread_instantiate_closure_var(const char* n_id, const QoreTypeInfo* typeInfo, QoreValue& nval) {
+   return q_get_thread_data()->tlpd->cvstack.instantiate(n_id, typeInfo, nval);
+}
+
+DLLLOCAL inline void thread_uninstantiate_closure_var(ExceptionSink* xsink) {
+   q_get_thread_data()->tlpd->cvstack.uninstantiate(xsink);
+}
+
+DLLLOCAL inline ClosureVarValue* thread_find_closure_var(const char* id) {
+   return q_get_thread_data()->tlpd->cvstack.find(id);
+}
+
+DLLLOCAL inline ClosureVarValue* thread_get_runtime_closure_var(const LocalVar* id) {
+   return q_get_thread_data()->closure_rt_env->find(id);
+}
+
+DLLLOCAL inline VLock* getVLock() {
+   return &q_get_thread_data()->vlock;
+}
+
+DLLLOCAL inline Context* get_context_stack() {
+   return q_get_thread_data()->context_stack;
+}
+
+DLLLOCAL inline void update_context_stack(Context* cstack) {
+   q_get_thread_data()->context_stack = cstack;
+}
+
+DLLLOCAL inline QoreProgramLocation get_runtime_location() {
+   return q_get_thread_data()->runtime_loc;
+}
+
+DLLLOCAL inline QoreProgramLocation update_get_runtime_location(const QoreProgramLocation& loc) {
+   ThreadData* td = q_get_thread_data();
+   QoreProgramLocation rv = td->runtime_loc;
+   td->runtime_loc = loc;
+   return rv;
+}
+
+DLLLOCAL inline void update_runtime_location(const QoreProgramLocation& loc) {
+   q_get_thread_data()->runtime_loc = loc;
+}
+
+DLLLOCAL inline const QoreTypeInfo* getReturnTypeInfo() {
+   return q_get_thread_data()->returnTypeInfo;
+}
+
+DLLLOCAL inline const QoreTypeInfo* saveReturnTypeInfo(const QoreTypeInfo* returnTypeInfo) {
+   ThreadData* td = q_get_thread_data();
+   const QoreTypeInfo* rv = td->returnTypeInfo;
+   td->returnTypeInfo = returnTypeInfo;
+   return rv;
+}
+
+DLLLOCAL inline int get_implicit_element() {
+   return q_get_thread_data()->getElement();
+}
+
+DLLLOCAL inline int save_implicit_element(int n_element) {
+   return q_get_thread_data()->saveElement(n_element);
+}
+
+#endif
@@ -35,6 +35,7 @@
 
 #include <qore/Qore.h>
 #include <qore/intern/AbstractSmartLock.h>
+#include <qore/intern/qore_atomic.h>
 
 #include <vector>
 #include <map>
@@ -45,12 +46,34 @@ typedef std::map<int, class VLock *> vlock_map_t;
 // and must faster than a list
 typedef std::vector<AbstractSmartLock *> abstract_lock_list_t;
 
+// blocked threads only check for deadlocks after waiting this many milliseconds
+#define QORE_DEADLOCK_CHECK_MS 10
+
 // for tracking locks per thread and detecting deadlocks
 class VLock : protected abstract_lock_list_t
 {
    private:
-      AbstractSmartLock *waiting_on;   // the lock this object is waiting on
+      AbstractSmartLock * volatile waiting_on;   // the lock this object is waiting on; read by other threads without locking
+      volatile int64 wait_seq;         // orders waits with deadlock detection; the latest wait in a cycle closed it, 0 = no detection
       int tid;
+      int64 wait_start;                // time this thread started waiting on a lock with statistics enabled, 0 = not waiting
+
+      // records the start of a wait on a lock with statistics enabled
+      DLLLOCAL void startWait(AbstractSmartLock *asl) {
+         if (!wait_start && asl->lockStatsEnabled())
+            wait_start = q_clock_getmicros();
+      }
+
+      // waits on the lock; deadlocks are only checked if the wait exceeds QORE_DEADLOCK_CHECK_MS
+      DLLLOCAL int waitIntern(AbstractSmartLock *asl, QoreCondition *cond, vlock_map_t *vmap, ExceptionSink *xsink, int64 timeout_ms);
+
+      // checks if the current owner(s) of the lock are waiting on a lock held by this thread; the exception is only
+      // raised if this thread's wait closed the cycle
+      DLLLOCAL int checkDeadlock(AbstractSmartLock *asl, vlock_map_t *vmap, ExceptionSink *xsink, int64 timeout_ms);
+
+      DLLLOCAL AbstractSmartLock *getWaitingOn() const {
+         return qore_atomic_get(&waiting_on);
+      }
 
       // not implemented
       VLock(const VLock&);
@@ -65,12 +88,25 @@ class VLock : protected abstract_lock_list_t
       DLLLOCAL AbstractSmartLock *find(AbstractSmartLock *g) const; 
 
       // for blocking smart locks with deadlock detection
-      DLLLOCAL int waitOn(AbstractSmartLock *asl, class VLock *vl, class ExceptionSink *xsink, int timeout_ms = 0);
+      DLLLOCAL int waitOn(AbstractSmartLock *asl, ExceptionSink *xsink, int64 timeout_ms = 0) {
+         return waitIntern(asl, 0, 0, xsink, timeout_ms);
+      }
       // for smart locks using an alternate condition variable
-      DLLLOCAL int waitOn(AbstractSmartLock *asl, class QoreCondition *cond, class VLock *vl, class ExceptionSink *xsink, int timeout_ms = 0);
+      DLLLOCAL int waitOn(AbstractSmartLock *asl, QoreCondition *cond, ExceptionSink *xsink, int64 timeout_ms = 0) {
+         return waitIntern(asl, cond, 0, xsink, timeout_ms);
+      }
       // for smart locks that can be held by more than one thread
-      DLLLOCAL int waitOn(AbstractSmartLock *asl, vlock_map_t &vmap, class ExceptionSink *xsink, int timeout_ms = 0);
+      DLLLOCAL int waitOn(AbstractSmartLock *asl, vlock_map_t &vmap, ExceptionSink *xsink, int64 timeout_ms = 0) {
+         return waitIntern(asl, 0, &vmap, xsink, timeout_ms);
+      }
       DLLLOCAL int getTID() const { return tid; }
+
+      // returns and clears the time this thread started waiting for the lock being acquired (0 if it did not wait)
+      DLLLOCAL int64 takeWaitStart() {
+         int64 rv = wait_start;
+         wait_start = 0;
+         return rv;
+      }
          
 #ifdef DEBUG
       DLLLOCAL void show(class VLock *nvl) const; 
@@ -102,7 +102,7 @@ private:
    unsigned char type;              
    QoreLValue<qore_gvar_ref_u> val;
    std::string name;
-   mutable QoreVarRWLock rwl;
+   mutable QoreVarStripedRWLock rwl;
    QoreParseTypeInfo *parseTypeInfo;
    const QoreTypeInfo *typeInfo;
    bool pub,                          // is this global var public (valid and set for modules only)
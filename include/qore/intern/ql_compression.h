@@ -35,4 +35,44 @@
 
 DLLLOCAL void init_compression_functions(QoreNamespace& ns);
 
+// size of the output buffer used by QoreStreamDecompressor
+#define QORE_STREAM_DECOMPRESS_BUFSIZE (64 * 1024)
+
+// receives blocks of data from QoreStreamDecompressor
+class AbstractDecompressorOutput {
+public:
+   DLLLOCAL virtual ~AbstractDecompressorOutput() {
+   }
+
+   // processes a block of decompressed data; returns 0 for OK, -1 if an exception was raised
+   DLLLOCAL virtual int output(const void* ptr, size_t len, ExceptionSink* xsink) = 0;
+};
+
+// decompresses data incrementally as it arrives in blocks of any size, so memory usage is bounded by the output buffer
+class QoreStreamDecompressor {
+protected:
+   bool end;
+
+public:
+   DLLLOCAL QoreStreamDecompressor() : end(false) {
+   }
+
+   DLLLOCAL virtual ~QoreStreamDecompressor() {
+   }
+
+   // returns true if the end of the compressed stream has been reached
+   DLLLOCAL bool done() const {
+      return end;
+   }
+
+   // decompresses the given block and passes all output produced to "out"; returns 0 for OK, -1 if an exception was raised
+   DLLLOCAL virtual int decompress(const void* ptr, size_t len, AbstractDecompressorOutput& out, ExceptionSink* xsink) = 0;
+
+   // raises an exception and returns -1 if the end of the compressed stream has not been reached
+   DLLLOCAL int finish(ExceptionSink* xsink);
+
+   // returns a new decompressor for the given HTTP content-encoding or 0 if the encoding is not supported or an exception was raised
+   DLLLOCAL static QoreStreamDecompressor* getForContentEncoding(const char* ce, ExceptionSink* xsink);
+};
+
 #endif
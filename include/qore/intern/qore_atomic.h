@@ -0,0 +1,75 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  qore_atomic.h
+
+  internal atomic integer and pointer operations
+
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#ifndef _QORE_INTERN_QORE_ATOMIC_H
+#define _QORE_INTERN_QORE_ATOMIC_H
+
+// these helpers complement atomic_inc() and atomic_dec() from the architecture-specific
+// macro headers; they are implemented with the compiler's __sync builtins, which are full
+// memory barriers and are supported for 32- and 64-bit integers and pointers on all
+// platforms where qore is built with g++ or clang
+
+// atomically adds "v" to "*a" and returns the new value
+template <typename T>
+DLLLOCAL inline T qore_atomic_add(volatile T* a, T v) {
+   return __sync_add_and_fetch(a, v);
+}
+
+// atomically subtracts "v" from "*a" and returns the new value
+template <typename T>
+DLLLOCAL inline T qore_atomic_sub(volatile T* a, T v) {
+   return __sync_sub_and_fetch(a, v);
+}
+
+// atomically sets "*a" to "nv" if it is equal to "ov"; returns true if the value was swapped
+template <typename T>
+DLLLOCAL inline bool qore_atomic_cas(volatile T* a, T ov, T nv) {
+   return __sync_bool_compare_and_swap(a, ov, nv);
+}
+
+// reads "*a" with acquire semantics
+template <typename T>
+DLLLOCAL inline T qore_atomic_get(const volatile T* a) {
+   T rv = *a;
+   __sync_synchronize();
+   return rv;
+}
+
+// writes "v" to "*a" with release semantics
+template <typename T>
+DLLLOCAL inline void qore_atomic_set(volatile T* a, T v) {
+   __sync_synchronize();
+   *a = v;
+}
+
+#endif
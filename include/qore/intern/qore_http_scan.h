@@ -0,0 +1,108 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+
+#ifndef _QORE_QORE_HTTP_SCAN_H
+#define _QORE_QORE_HTTP_SCAN_H
+
+// vectorized scanning helpers for HTTP header parsing; the SIMD paths are used when the compiler targets SSE2 or AVX2
+// (SSE2 is always available on x86_64), otherwise bytes are compared one at a time
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <string.h>
+
+// returns a pointer to the first '\r' or '\n' character in [p, e), or e if there is none
+static inline const char* q_http_find_eol(const char* p, const char* e) {
+#if defined(__AVX2__)
+   const __m256i cr = _mm256_set1_epi8('\r');
+   const __m256i lf = _mm256_set1_epi8('\n');
+   while (e - p >= 32) {
+      __m256i v = _mm256_loadu_si256((const __m256i*)p);
+      unsigned m = (unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf)));
+      if (m)
+         return p + __builtin_ctz(m);
+      p += 32;
+   }
+#elif defined(__SSE2__)
+   const __m128i cr = _mm_set1_epi8('\r');
+   const __m128i lf = _mm_set1_epi8('\n');
+   while (e - p >= 16) {
+      __m128i v = _mm_loadu_si128((const __m128i*)p);
+      unsigned m = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+      if (m)
+         return p + __builtin_ctz(m);
+      p += 16;
+   }
+#endif
+   while (p < e && *p != '\r' && *p != '\n')
+      ++p;
+   return p;
+}
+
+// returns a pointer to the first occurrence of c in [p, e), or e if there is none
+static inline const char* q_http_find_char(const char* p, const char* e, char c) {
+   const char* rv = (const char*)memchr(p, c, e - p);
+   return rv ? rv : e;
+}
+
+// converts an ASCII header name to lower case in place
+static inline void q_http_lower(char* p, const char* e) {
+   for (; p < e; ++p)
+      if (*p >= 'A' && *p <= 'Z')
+         *p += 'a' - 'A';
+}
+
+// header names that are processed when a header is converted to a hash
+enum q_http_header_id_e {
+   QHH_OTHER = 0,
+   QHH_CONNECTION,
+   QHH_CONTENT_TYPE,
+   QHH_TRANSFER_ENCODING,
+   QHH_ACCEPT_CHARSET,
+   QHH_ACCEPT_ENCODING,
+};
+
+// identifies a lower-case header name by its length first, so that most headers are classified without any string comparison
+static inline q_http_header_id_e q_http_header_id(const char* name, size_t len) {
+   switch (len) {
+      case 10: return !memcmp(name, "connection", 10) ? QHH_CONNECTION : QHH_OTHER;
+      case 12: return !memcmp(name, "content-type", 12) ? QHH_CONTENT_TYPE : QHH_OTHER;
+      case 14: return !memcmp(name, "accept-charset", 14) ? QHH_ACCEPT_CHARSET : QHH_OTHER;
+      case 15: return !memcmp(name, "accept-encoding", 15) ? QHH_ACCEPT_ENCODING : QHH_OTHER;
+      case 17: return !memcmp(name, "transfer-encoding", 17) ? QHH_TRANSFER_ENCODING : QHH_OTHER;
+   }
+   return QHH_OTHER;
+}
+
+#endif
@@ -57,6 +57,14 @@ struct qore_list_private {
       obj_count += dt;
    }
 
+   // exchanges the elements with another list
+   DLLLOCAL void swap(qore_list_private& l) {
+      std::swap(entry, l.entry);
+      std::swap(length, l.length);
+      std::swap(allocated, l.allocated);
+      std::swap(obj_count, l.obj_count);
+   }
+
    DLLLOCAL static unsigned getObjectCount(const QoreListNode& l) {
       return l.priv->obj_count;
    }
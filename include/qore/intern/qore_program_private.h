@@ -88,219 +88,6 @@ public:
 
 typedef QoreThreadLocalStorage<QoreHashNode> qpgm_thread_local_storage_t;
 
-class ThreadLocalVariableData : public ThreadLocalData<LocalVarValue> {
-public:
-   // marks all variables as finalized on the stack
-   DLLLOCAL void finalize(arg_vec_t*& cl) {
-      ThreadLocalVariableData::iterator i(curr);
-      while (i.next()) {
-         AbstractQoreNode* n = i.get().finalize();
-         if (n && n->isReferenceCounted()) {
-            if (!cl)
-               cl = new arg_vec_t;
-            cl->push_back(n);
-         }
-      }
-   }
-
-   // deletes everything on the stack
-   DLLLOCAL void del(ExceptionSink* xsink) {
-      // then we uninstantiate
-      while (curr->prev || curr->pos)
-         uninstantiate(xsink);
-   }
-
-   DLLLOCAL LocalVarValue* instantiate() {
-      if (curr->pos == QORE_THREAD_STACK_BLOCK) {
-	 if (curr->next)
-	    curr = curr->next;
-	 else {
-	    curr->next = new Block(curr);
-	    //printf("this: %p: add curr: %p, curr->next: %p\n", this, curr, curr->next);
-	    curr = curr->next;
-	 }
-      }
-      return &curr->var[curr->pos++];
-   }
-
-   DLLLOCAL void uninstantiate(ExceptionSink* xsink) {
-      if (!curr->pos) {
-	 if (curr->next) {
-	    //printf("this %p: del curr: %p, curr->next: %p\n", this, curr, curr->next);
-	    delete curr->next;
-	    curr->next = 0;
-	 }
-	 curr = curr->prev;
-      }
-      curr->var[--curr->pos].uninstantiate(xsink);
-   }
-
-   DLLLOCAL LocalVarValue* find(const char* id) {
-      Block* w = curr;
-      while (true) {
-	 int p = w->pos;
-	 while (p) {
-	    if (w->var[--p].id == id && !w->var[p].skip)
-	       return &w->var[p];
-	 }
-	 w = w->prev;
-#ifdef DEBUG
-	 if (!w) {
-            printd(0, "ThreadLocalVariableData::find() this: %p no local variable '%s' (%p) on stack (pgm: %p) p: %d\n", this, id, id, getProgram(), p);
-            p = curr->pos - 1;
-            while (p >= 0) {
-               printd(0, "var p: %d: %s (%p) (skip: %d)\n", p, curr->var[p].id, curr->var[p].id, curr->var[p].skip);
-               --p;
-            }
-         }
-#endif
-	 assert(w);
-      }
-      // to avoid a warning on most compilers - note that this generates a warning on recent versions of aCC!
-      return 0;
-   }
-};
-
-class ThreadClosureVariableStack : public ThreadLocalData<ClosureVarValue*> {
-private:
-   DLLLOCAL void instantiate(ClosureVarValue* cvar) {
-      //printd(5, "ThreadClosureVariableStack::instantiate(%p = '%s') this: %p pgm: %p\n", cvar->id, cvar->id, this, getProgram());
-
-      if (curr->pos == QORE_THREAD_STACK_BLOCK) {
-	 if (curr->next)
-	    curr = curr->next;
-	 else {
-	    curr->next = new Block(curr);
-	    //printf("this: %p: add curr: %p, curr->next: %p\n", this, curr, curr->next);
-	    curr = curr->next;
-	 }
-      }
-      curr->var[curr->pos++] = cvar;
-   }
-
-public:
-   // marks all variables as finalized on the stack
-   DLLLOCAL void finalize(arg_vec_t*& cl) {
-      ThreadClosureVariableStack::iterator i(curr);
-      while (i.next()) {
-         AbstractQoreNode* n = i.get()->finalize();
-         if (n && n->isReferenceCounted()) {
-            if (!cl)
-               cl = new arg_vec_t;
-            cl->push_back(n);
-         }
-      }
-   }
-
-   // deletes everything on the stack
-   DLLLOCAL void del(ExceptionSink* xsink) {
-      while (curr->prev || curr->pos)
-         uninstantiate(xsink);
-   }
-
-   DLLLOCAL ClosureVarValue* instantiate(const char* id, const QoreTypeInfo* typeInfo, QoreValue& nval) {
-      ClosureVarValue* cvar = new ClosureVarValue(id, typeInfo, nval);
-      instantiate(cvar);
-      return cvar;
-   }
-
-   DLLLOCAL void uninstantiate(ExceptionSink* xsink) {
-#if 0
-      if (!curr->pos)
-         printd(5, "ThreadClosureVariableStack::uninstantiate() this: %p pos: %d %p %s\n", this, curr->prev->pos - 1, curr->prev->var[curr->prev->pos - 1]->id, curr->prev->var[curr->prev->pos - 1]->id);
-      else
-         printd(5, "ThreadClosureVariableStack::uninstantiate() this: %p pos: %d %p %s\n", this, curr->pos - 1, curr->var[curr->pos - 1]->id, curr->var[curr->pos - 1]->id);
-#endif
-      if (!curr->pos) {
-	 if (curr->next) {
-	    //printf("this %p: del curr: %p, curr->next: %p\n", this, curr, curr->next);
-	    delete curr->next;
-	    curr->next = 0;
-	 }
-	 curr = curr->prev;
-      }
-      curr->var[--curr->pos]->deref(xsink);
-   }
-
-   DLLLOCAL ClosureVarValue* find(const char* id) {
-      //printd(5, "ThreadClosureVariableStack::find() this: %p id: %p\n", this, id);
-      Block* w = curr;
-      while (true) {
-	 int p = w->pos;
-	 while (p) {
-	    //printd(5, "ThreadClosureVariableStack::find(%p '%s') this: %p checking %p '%s' skip: %d\n", id, id, this, w->var[p - 1]->id, w->var[p - 1]->id, w->var[p - 1]->skip);
-	    if (w->var[--p]->id == id && !w->var[p]->skip) {
-	       //printd(5, "ThreadClosureVariableStack::find(%p '%s') this: %p returning: %p\n", id, id, this, w->var[p]);
-	       return w->var[p];
-	    }
-	 }
-	 w = w->prev;
-#ifdef DEBUG
-	 if (!w) {
-	    //printd(5, "ThreadClosureVariableStack::find() this: %p no closure-bound local variable '%s' (%p) on stack (pgm: %p) p: %d curr->prev: %p\n", this, id, id, getProgram(), p, curr->prev);
-            p = curr->pos - 1;
-            while (p >= 0) {
-               //printd(5, "var p: %d: %s (%p) (skip: %d)\n", p, curr->var[p]->id, curr->var[p]->id, curr->var[p]->skip);
-               --p;
-            }
-         }
-#endif
-	 assert(w);
-      }
-      // to avoid a warning on most compilers - note that this generates a warning on recent versions of aCC!
-      return 0;
-   }
-};
-
-struct ThreadLocalProgramData {
-private:
-   // not implemented
-   DLLLOCAL ThreadLocalProgramData(const ThreadLocalProgramData& old);
-
-public:
-   // local variable data slots
-   ThreadLocalVariableData lvstack;
-   // closure variable stack
-   ThreadClosureVariableStack cvstack;
-   // current thread's time zone locale (if any)
-   const AbstractQoreZoneInfo* tz;
-   // the "time zone set" flag
-   bool tz_set : 1;
-
-   // top-level vars instantiated
-   bool inst : 1;
-
-   DLLLOCAL ThreadLocalProgramData() : tz(0), tz_set(false), inst(false) {
-      //printd(5, "ThreadLocalProgramData::ThreadLocalProgramData() this: %p\n", this);
-   }
-
-   DLLLOCAL ~ThreadLocalProgramData() {
-      assert(lvstack.empty());
-      assert(cvstack.empty());
-   }
-
-   DLLLOCAL void finalize(arg_vec_t*& cl) {
-      lvstack.finalize(cl);
-      cvstack.finalize(cl);
-   }
-
-   DLLLOCAL void del(ExceptionSink* xsink) {
-      lvstack.del(xsink);
-      cvstack.del(xsink);
-      delete this;
-   }
-
-   DLLLOCAL void setTZ(const AbstractQoreZoneInfo* n_tz) {
-      tz_set = true;
-      tz = n_tz;
-   }
-
-   DLLLOCAL void clearTZ() {
-      tz_set = false;
-      tz = 0;
-   }
-};
-
 // maps from thread handles to thread-local data
 typedef std::map<ThreadProgramData*, ThreadLocalProgramData*> pgm_data_map_t;
 
@@ -393,6 +180,9 @@ public:
    // thread initialization user code
    ResolvedCallReferenceNode* thr_init;
 
+   // enable lock statistics for new lock objects created in this Program
+   bool lock_stats;
+
    // return value for use with %exec-class
    AbstractQoreNode* exec_class_rv;
    
@@ -404,7 +194,7 @@ public:
         only_first_except(false), po_locked(false), po_allow_restrict(true), exec_class(false), base_object(false),
         requires_exception(false), tclear(0),
         exceptions_raised(0), ptid(0), pwo(n_parse_options), dom(0), pend_dom(0), thread_local_storage(0), twaiting(0),
-        thr_init(0), exec_class_rv(0), pgm(n_pgm) {
+        thr_init(0), lock_stats(false), exec_class_rv(0), pgm(n_pgm) {
       //printd(5, "qore_program_private_base::qore_program_private_base() this: %p pgm: %p po: "QLLD"\n", this, pgm, n_parse_options);
       
       if (p_pgm)
@@ -1607,6 +1397,14 @@ public:
       return pgm.priv->setThreadInit(n_thr_init, xsink);
    }
 
+   DLLLOCAL static void setLockStats(QoreProgram& pgm, bool enable) {
+      pgm.priv->lock_stats = enable;
+   }
+
+   DLLLOCAL static bool getLockStats(const QoreProgram& pgm) {
+      return pgm.priv->lock_stats;
+   }
+
    DLLLOCAL static ResolvedCallReferenceNode* runtimeGetCallReference(QoreProgram* pgm, const char* name, ExceptionSink* xsink) {
       return pgm->priv->runtimeGetCallReference(name, xsink);
    }
@@ -35,6 +35,8 @@
 #include <qore/intern/SSLSocketHelper.h>
 
 #include <qore/intern/QC_Queue.h>
+#include <qore/intern/QoreDnsCache.h>
+#include <qore/intern/qore_http_scan.h>
 
 #include <ctype.h>
 #include <stdlib.h>
@@ -50,6 +52,24 @@
 #include <sys/select.h>
 #endif
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#else
+// buffers for scatter/gather writes are always coalesced when writev() is not available
+struct iovec {
+   void* iov_base;
+   size_t iov_len;
+};
+#endif
+
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+#include <sys/sendfile.h>
+#define QORE_USE_SENDFILE 1
+#endif
+
 #ifndef DEFAULT_SOCKET_BUFSIZE
 #define DEFAULT_SOCKET_BUFSIZE 4096
 #endif
@@ -58,6 +78,14 @@
 #define QORE_MAX_HEADER_SIZE 16384
 #endif
 
+// maximum number of bytes sent with a single sendfile() call, so that send events and timeouts stay responsive
+#define QORE_SENDFILE_CHUNK (1024 * 1024)
+// size of the buffer used when file data has to be copied through user space (ex: with SSL connections)
+#define QORE_SENDFILE_BUFSIZE (64 * 1024)
+
+// the maximum number of datagrams received or sent with one recvmmsg() or sendmmsg() call
+#define QORE_DGRAM_MAX_BATCH 1024
+
 #define CHF_HTTP11  (1 << 0)
 #define CHF_PROCESS (1 << 1)
 #define CHF_REQUEST (1 << 2)
@@ -144,6 +172,19 @@ public:
    DLLLOCAL ~OptionalNonBlockingHelper();
 };
 
+// sets TCP_CORK (where supported) for the lifetime of the object, so that data written with several calls is sent in full segments
+class TcpCorkHelper {
+public:
+   qore_socket_private& sock;
+   bool set;
+
+   DLLLOCAL TcpCorkHelper(qore_socket_private& s, bool n_set);
+   DLLLOCAL ~TcpCorkHelper();
+
+   // removes the cork and sends any data held back by it
+   DLLLOCAL void uncork();
+};
+
 class PrivateQoreSocketTimeoutBase {
 protected:
    struct qore_socket_private* sock;
@@ -172,6 +213,16 @@ public:
    DLLLOCAL void finalize(int64 bytes);
 };
 
+// receives HTTP message body data block by block as it is read from the socket, so that bodies do not have to be buffered in memory
+class AbstractHttpBodySink {
+public:
+   DLLLOCAL virtual ~AbstractHttpBodySink() {
+   }
+
+   // processes a block of body data; returns 0 for OK, -1 if an exception was raised
+   DLLLOCAL virtual int data(const void* ptr, size_t len, bool chunked, ExceptionSink* xsink) = 0;
+};
+
 struct qore_socket_private;
 
 struct qore_socket_op_helper {
@@ -216,18 +267,23 @@ struct qore_socket_private {
       tp_us_min             // throughput: minimum time for transfer to be considered
       ;
    AbstractQoreNode* callback_arg;
-   bool del, in_op, http_exp_chunked_body;
+   // receive buffer for datagrams; kept for the lifetime of the socket to avoid allocating it for each batch
+   char* dgram_buf;
+   size_t dgram_buf_size;
+   bool del, in_op, http_exp_chunked_body,
+      reuseport;            // set SO_REUSEPORT on INET sockets when they are opened
    
    DLLLOCAL qore_socket_private(int n_sock = QORE_INVALID_SOCKET, int n_sfamily = AF_UNSPEC, int n_stype = SOCK_STREAM, int n_prot = 0, const QoreEncoding* n_enc = QCS_DEFAULT) : 
       sock(n_sock), sfamily(n_sfamily), port(-1), stype(n_stype), sprot(n_prot), enc(n_enc), 
       ssl(0), cb_queue(0), warn_queue(0), buflen(0), bufoffset(0), tl_warning_us(0), tp_warning_bs(0), 
       tp_bytes_sent(0), tp_bytes_recv(0), tp_us_sent(0), tp_us_recv(0), tp_us_min(0),
-      callback_arg(0), del(false), in_op(false), http_exp_chunked_body(false) {
+      callback_arg(0), dgram_buf(0), dgram_buf_size(0), del(false), in_op(false), http_exp_chunked_body(false), reuseport(false) {
       //sendTimeout = recvTimeout = -1
    }
 
    DLLLOCAL ~qore_socket_private() {
       close_internal();
+      free(dgram_buf);
 
       // must be dereferenced and removed before deleting
       assert(!cb_queue); 
@@ -450,6 +506,83 @@ struct qore_socket_private {
       }
    }
    
+   DLLLOCAL int accept_cloexec() {
+#ifdef HAVE_ACCEPT4
+      return ::accept4(sock, 0, 0, SOCK_CLOEXEC);
+#else
+      int rc = ::accept(sock, 0, 0);
+#ifndef _Q_WINDOWS
+      if (rc != QORE_INVALID_SOCKET)
+         fcntl(rc, F_SETFD, FD_CLOEXEC);
+#endif
+      return rc;
+#endif
+   }
+
+   // waits for a connection like accept_intern() and then accepts all other pending connections up to "max" without
+   // waiting; the new descriptors are added to "fds"; returns 0 for OK (including a timeout), -1 for error
+   DLLLOCAL int acceptMany(std::vector<int>& fds, int max, int timeout_ms, ExceptionSink* xsink) {
+      assert(max > 0);
+      if (sock == QORE_INVALID_SOCKET) {
+         xsink->raiseException("SOCKET-NOT-OPEN", "socket must be opened, bound, and in a listening state before new connections can be accepted");
+         return QSE_NOT_OPEN;
+      }
+      if (in_op) {
+         se_in_op("acceptMany", xsink);
+         return QSE_IN_OP;
+      }
+
+      while (true) {
+         if (timeout_ms >= 0 && !isDataAvailable(timeout_ms, "acceptMany", xsink))
+            return *xsink ? -1 : 0;
+
+         int rc = accept_cloexec();
+         if (rc != QORE_INVALID_SOCKET) {
+            fds.push_back(rc);
+            break;
+         }
+
+         if (sock_get_error() == EINTR)
+            continue;
+
+         qore_socket_error(xsink, "SOCKET-ACCEPT-ERROR", "error in accept()");
+         return -1;
+      }
+
+      if ((int)fds.size() >= max)
+         return 0;
+
+      // drain the backlog; errors here only end the batch, the connections already accepted are returned
+#ifdef _Q_WINDOWS
+      while ((int)fds.size() < max && select(0, true, "acceptMany", 0)) {
+         int rc = accept_cloexec();
+         if (rc == QORE_INVALID_SOCKET)
+            break;
+         fds.push_back(rc);
+      }
+#else
+      // the listening socket is made non-blocking while draining so that no wait is needed for each connection
+      int fl = fcntl(sock, F_GETFL, 0);
+      if (fl < 0 || fcntl(sock, F_SETFL, fl | O_NONBLOCK))
+         return 0;
+      while ((int)fds.size() < max) {
+         int rc = accept_cloexec();
+         if (rc == QORE_INVALID_SOCKET) {
+            if (errno == EINTR)
+               continue;
+            break;
+         }
+         // accept() on BSD-derived systems copies O_NONBLOCK from the listening socket
+#ifndef HAVE_ACCEPT4
+         fcntl(rc, F_SETFL, fl & ~O_NONBLOCK);
+#endif
+         fds.push_back(rc);
+      }
+      fcntl(sock, F_SETFL, fl);
+#endif
+      return 0;
+   }
+
    // returns a new socket
    DLLLOCAL int accept_internal(SocketSource *source, int timeout_ms = -1, ExceptionSink* xsink = 0) {
       if (sock == QORE_INVALID_SOCKET) {
@@ -678,7 +811,7 @@ struct qore_socket_private {
       }
    }
 
-   DLLLOCAL void do_send_event(int bytes_sent, int total_sent, int bufsize) {
+   DLLLOCAL void do_send_event(int64 bytes_sent, int64 total_sent, int64 bufsize) {
       // post bytes sent on event queue, if any
       if (cb_queue) {
 	 QoreHashNode* h = new QoreHashNode;
@@ -738,6 +871,13 @@ struct qore_socket_private {
       xsink->raiseException("SOCKET-CONNECTUNIX-ERROR", "UNIX sockets are not available under Windows");
       return -1;
 #else
+      // the socket cannot be closed and reconnected while another operation is in progress
+      if (in_op) {
+         if (xsink)
+            se_in_op("connect", xsink);
+         return QSE_IN_OP;
+      }
+
       // close socket if already open
       close();
 
@@ -826,6 +966,11 @@ struct qore_socket_private {
       return rc;
    }
 
+   // returns true if data can be read without reading from the socket
+   DLLLOCAL bool hasBufferedData() const {
+      return buflen || (ssl && ssl->pending());
+   }
+
    DLLLOCAL bool isDataAvailable(int timeout_ms, const char* mname, ExceptionSink* xsink) {
       if (buflen)
 	 return true;
@@ -956,6 +1101,13 @@ struct qore_socket_private {
 
       QORE_TRACE("qore_socket_private::connectINET()");
 
+      // the socket cannot be closed and reconnected while another operation is in progress
+      if (in_op) {
+         if (xsink)
+            se_in_op("connect", xsink);
+         return QSE_IN_OP;
+      }
+
       // close socket if already open
       close();
 
@@ -963,22 +1115,24 @@ struct qore_socket_private {
 
       do_resolve_event(host, service);
 
-      QoreAddrInfo ai;
-      if (ai.getInfo(xsink, host, service, family, 0, type, protocol))
+      // resolve the host through the process-wide DNS cache (which performs a plain lookup if the cache is disabled)
+      dns_addr_list_t addrs;
+      if (qore_dns_cache.lookup(xsink, host, service, family, type, protocol, addrs))
 	 return -1;
 
-      struct addrinfo *aip = ai.getAddrInfo();
-
       // emit all "resolved" events
       if (cb_queue)
-	 for (struct addrinfo *p = aip; p; p = p->ai_next)
-	    do_resolved_event(p->ai_addr);
+	 for (dns_addr_list_t::iterator i = addrs.begin(), e = addrs.end(); i != e; ++i)
+	    do_resolved_event((struct sockaddr*)&i->addr);
 
-      int prt = q_get_port_from_addr(aip->ai_addr);
+      int prt = addrs.empty() ? -1 : q_get_port_from_addr((struct sockaddr*)&addrs[0].addr);
 
-      for (struct addrinfo *p = aip; p; p = p->ai_next) {
-	 if (!connectINETIntern(host, service, p->ai_family, p->ai_addr, p->ai_addrlen, p->ai_socktype, p->ai_protocol, prt, timeout_ms, xsink, true))
+      for (dns_addr_list_t::iterator i = addrs.begin(), e = addrs.end(); i != e; ++i) {
+         struct sockaddr* addr = (struct sockaddr*)&i->addr;
+	 if (!connectINETIntern(host, service, i->family, addr, i->addrlen, i->socktype, i->protocol, prt, timeout_ms, xsink, true))
 	    return 0;
+         // try addresses that could not be connected last in subsequent connections
+         qore_dns_cache.reportFailure(host, service, family, type, protocol, addr, i->addrlen);
 	 if (xsink && *xsink)
 	    break;
       }
@@ -1098,6 +1252,10 @@ struct qore_socket_private {
       if ((sock = socket(family, sock_type, protocol)) == QORE_INVALID_SOCKET)
 	 return -1;
 
+      // must be set before the socket is bound
+      if (reuseport)
+         reuse_port(1);
+
       sfamily = family;
       stype = sock_type;
       sprot = protocol;
@@ -1110,6 +1268,26 @@ struct qore_socket_private {
       return setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (SETSOCKOPT_ARG_4)&opt, sizeof(int));
    }
 
+   DLLLOCAL int reuse_port(int opt) {
+#ifdef SO_REUSEPORT
+      return setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, (SETSOCKOPT_ARG_4)&opt, sizeof(int));
+#else
+      errno = ENOSYS;
+      return -1;
+#endif
+   }
+
+   // sets SO_REUSEPORT for sockets opened from now on (and on the current socket if open); returns -1 if not supported
+   DLLLOCAL int setReusePort(bool b) {
+#ifdef SO_REUSEPORT
+      reuseport = b;
+      return sock != QORE_INVALID_SOCKET && (sfamily == AF_INET || sfamily == AF_INET6) ? reuse_port(b) : 0;
+#else
+      errno = ENOSYS;
+      return -1;
+#endif
+   }
+
    DLLLOCAL int bindIntern(struct sockaddr* ai_addr, size_t ai_addrlen, int prt, bool reuseaddr, ExceptionSink* xsink = 0) {
       reuse(reuseaddr);
 
@@ -1425,6 +1603,14 @@ struct qore_socket_private {
       return rc;
    }
 
+   // returns the last "n" bytes of a buffer returned by brecv() to the read buffer so that they are returned by the next read
+   DLLLOCAL void unread(const char* buf, qore_size_t n) {
+      if (!n)
+         return;
+      bufoffset = buf - rbuf;
+      buflen += n;
+   }
+
    //! read until \\r\\n\\r\\n and return the string
    DLLLOCAL QoreStringNode* readHTTPData(ExceptionSink* xsink, const char* meth, int timeout, qore_offset_t& rc, bool exit_early = false) {
       assert(meth);
@@ -1450,8 +1636,9 @@ struct qore_socket_private {
 
       while (true) {
 	 char* buf;
-	 rc = brecv(xsink, meth, buf, 1, 0, timeout, false);
-	 //printd(5, "qore_socket_private::readHTTPData() this: %p Socket::%s(): rc: "QLLD" read char: %c (%03d) (old state: %d)\n", this, meth, rc, rc > 0 && buf[0] > 31 ? buf[0] : '?', rc > 0 ? buf[0] : 0, state);
+	 // all buffered data is scanned at once; any data following the header is returned to the buffer
+	 rc = brecv(xsink, meth, buf, DEFAULT_SOCKET_BUFSIZE, 0, timeout, false);
+	 //printd(5, "qore_socket_private::readHTTPData() this: %p Socket::%s(): rc: "QLLD" (old state: %d)\n", this, meth, rc, state);
 	 if (rc <= 0) {
 	    //printd(5, "qore_socket_private::readHTTPData(timeout=%d) hdr='%s' (len: %d), rc="QSD", errno=%d: '%s'\n", timeout, hdr->getBuffer(), hdr->strlen(), rc, errno, strerror(errno));
 
@@ -1465,51 +1652,86 @@ struct qore_socket_private {
 	    }
 	    return 0;
 	 }
-	 char c = buf[0];
-	 if (++count == QORE_MAX_HEADER_SIZE) {
-	    if (xsink)
-	       xsink->raiseException("SOCKET-HTTP-ERROR", "header size cannot exceed "QSD" bytes", count);
-	    return 0;
+
+	 const char* e = buf + rc;
+	 // do not scan beyond the maximum header size
+	 bool limit = false;
+	 if (count + rc >= QORE_MAX_HEADER_SIZE) {
+	    e = buf + (QORE_MAX_HEADER_SIZE - count - 1);
+	    limit = true;
 	 }
-	 
-	 // check if we can progress to the next state
-	 if (c == '\n') {
+
+	 const char* p = buf;
+	 bool done = false;
+	 while (p < e) {
 	    if (state == -1) {
-	       state = 3;
-	       continue;
+	       // copy everything up to the next line end character at once
+	       const char* q = q_http_find_eol(p, e);
+	       if (q > p) {
+		  hdr->concat(p, q - p);
+		  p = q;
+		  if (p == e)
+		     break;
+	       }
 	    }
-	    if (!state) {
-               if (exit_early && hdr->empty())
-                  return 0;
-	       state = 1;
-	       continue;
+
+	    char c = *p++;
+
+	    // check if we can progress to the next state
+	    if (c == '\n') {
+	       if (state == -1) {
+		  state = 3;
+		  continue;
+	       }
+	       if (!state) {
+		  if (exit_early && hdr->empty()) {
+		     unread(p, buf + rc - p);
+		     return 0;
+		  }
+		  state = 1;
+		  continue;
+	       }
+	       assert(state > 0);
+	       done = true;
+	       break;
 	    }
-	    assert(state > 0);
-	    break;
-	 }
-	 else if (c == '\r') {
-	    if (state == -1) {
-	       state = 0;
-	       continue;
+	    else if (c == '\r') {
+	       if (state == -1) {
+		  state = 0;
+		  continue;
+	       }
+	       if (!state) {
+		  done = true;
+		  break;
+	       }
+	       if (state == 1) {
+		  state = 2;
+		  continue;
+	       }
 	    }
-	    if (!state)
-	       break;
-	    if (state == 1) {
-	       state = 2;
-	       continue;
+
+	    if (state != -1) {
+	       switch (state) {
+		  case 0: hdr->concat('\r'); break;
+		  case 1: hdr->concat("\r\n"); break;
+		  case 2: hdr->concat("\r\n\r"); break;
+		  case 3: hdr->concat('\n'); break;
+	       }
+	       state = -1;
 	    }
+	    hdr->concat(c);
 	 }
 
-	 if (state != -1) {
-	    switch (state) {
-	       case 0: hdr->concat('\r'); break;
-	       case 1: hdr->concat("\r\n"); break;
-	       case 2: hdr->concat("\r\n\r"); break;
-	       case 3: hdr->concat('\n'); break;
-	    }
-	    state = -1;
+	 count += p - buf;
+	 if (done) {
+	    unread(p, buf + rc - p);
+	    break;
+	 }
+	 if (limit) {
+	    if (xsink)
+	       xsink->raiseException("SOCKET-HTTP-ERROR", "header size cannot exceed "QSD" bytes", count + 1);
+	    return 0;
 	 }
-	 hdr->concat(c);
       }
       hdr->concat('\n');
       
@@ -1897,7 +2119,8 @@ struct qore_socket_private {
       return 0;
    }
 
-   DLLLOCAL int sendHttpChunkedWithCallback(ExceptionSink* xsink, const char* mname, const ResolvedCallReferenceNode& send_callback, QoreThreadLock& l, int source, int timeout_ms = -1, bool* aborted = 0) {
+   // if "cork" is set, the cork is removed after the first chunk has been sent
+   DLLLOCAL int sendHttpChunkedWithCallback(ExceptionSink* xsink, const char* mname, const ResolvedCallReferenceNode& send_callback, QoreThreadLock& l, int source, int timeout_ms = -1, bool* aborted = 0, TcpCorkHelper* cork = 0) {
       assert(xsink);
       assert(!aborted || !(*aborted));
 
@@ -1941,8 +2164,10 @@ struct qore_socket_private {
 
          //printd(5, "qore_socket_private::sendHttpChunkedWithCallback() this: %p res: %s\n", this, get_type_name(*res));
 
-         // check callback return val
+         // check callback return val; chunk data is sent directly from the value returned without being copied
          QoreString buf;
+         const void* data = 0;
+         qore_size_t data_size = 0;
 
          switch (res->getType()) {
             case NT_STRING: {
@@ -1952,7 +2177,8 @@ struct qore_socket_private {
                   break;
                }
                buf.sprintf("%x\r\n", (int)str->size());
-               buf.concat(str->getBuffer(), str->size());
+               data = str->getBuffer();
+               data_size = str->size();
                break;
             }
 
@@ -1963,7 +2189,8 @@ struct qore_socket_private {
                   break;
                }
                buf.sprintf("%x\r\n", (int)b->size());
-               buf.concat((const char*)b->getPtr(), b->size());
+               data = b->getPtr();
+               data_size = b->size();
                break;
             }
 
@@ -2003,14 +2230,34 @@ struct qore_socket_private {
          if (buf.empty())
             buf.concat("0\r\n");
 
-         // add trailing \r\n
-         buf.concat("\r\n");
-
-         // send chunk buffer data
-         rc = sendIntern(xsink, mname, buf.getBuffer(), buf.size(), timeout_ms, total);
+         // send the chunk size, data and trailing \r\n with a single write
+         struct iovec iov[3];
+         int iovcnt;
+         if (data_size) {
+            iov[0].iov_base = (void*)buf.getBuffer();
+            iov[0].iov_len = buf.size();
+            iov[1].iov_base = (void*)data;
+            iov[1].iov_len = data_size;
+            iov[2].iov_base = (void*)"\r\n";
+            iov[2].iov_len = 2;
+            iovcnt = 3;
+         }
+         else {
+            buf.concat("\r\n");
+            iov[0].iov_base = (void*)buf.getBuffer();
+            iov[0].iov_len = buf.size();
+            iovcnt = 1;
+         }
+         rc = sendvIntern(xsink, mname, iov, iovcnt, timeout_ms, total);
 
          //printd(5, "qore_socket_private::sendHttpChunkedWithCallback() this: %p sent: %s\n", this, buf.getBuffer());
 
+         // the header and the first chunk have been coalesced; later chunks are sent immediately
+         if (cork) {
+            cork->uncork();
+            cork = 0;
+         }
+
          if (rc < 0 || sock == QORE_INVALID_SOCKET)
             break;
       }
@@ -2093,6 +2340,113 @@ struct qore_socket_private {
       return rc;
    }
    
+   // sends all data in the given buffers; the array is updated while data is written
+   // with plain sockets the buffers are written with writev() without being copied into a single buffer first, so that
+   // for example an HTTP header and body are sent with one system call; with SSL connections the buffers are coalesced so
+   // that they can be sent with a single SSL write
+   DLLLOCAL int sendvIntern(ExceptionSink* xsink, const char* mname, struct iovec* iov, int iovcnt, int timeout_ms, int64& total) {
+      qore_size_t size = 0;
+      for (int i = 0; i < iovcnt; ++i)
+         size += iov[i].iov_len;
+
+#ifdef HAVE_SYS_UIO_H
+      if (!ssl) {
+         // set the non-blocking flag (for use with non-ssl connections)
+         bool nb = (timeout_ms >= 0);
+         qore_size_t bs = 0;
+
+         while (bs < size) {
+            ssize_t rc = ::writev(sock, iov, iovcnt);
+            if (rc < 0) {
+               sock_get_error();
+               // try again if we were interrupted by a signal
+               if (errno == EINTR)
+                  continue;
+               // check that the send finishes before the timeout if we are using non-blocking I/O
+               if (nb && (errno == EAGAIN
+#ifdef EWOULDBLOCK
+                          || errno == EWOULDBLOCK
+#endif
+                      )) {
+                  if (!isWriteFinished(timeout_ms, mname, xsink)) {
+                     if (xsink) {
+                        if (*xsink)
+                           return -1;
+                        se_timeout(mname, timeout_ms, xsink);
+                     }
+                     return QSE_TIMEOUT;
+                  }
+                  continue;
+               }
+               if (xsink)
+                  xsink->raiseErrnoException("SOCKET-SEND-ERROR", errno, "error while executing Socket::%s()", mname);
+#ifdef EPIPE
+               if (errno == EPIPE)
+                  close();
+#endif
+#ifdef ECONNRESET
+               if (errno == ECONNRESET)
+                  close();
+#endif
+               return -1;
+            }
+
+            total += rc;
+            bs += rc;
+            do_send_event(rc, bs, size);
+
+            // skip the buffers that have been sent completely and adjust the first partially-sent buffer
+            while (iovcnt && (qore_size_t)rc >= iov->iov_len) {
+               rc -= iov->iov_len;
+               ++iov;
+               --iovcnt;
+            }
+            if (rc) {
+               iov->iov_base = (char*)iov->iov_base + rc;
+               iov->iov_len -= rc;
+            }
+         }
+         return 0;
+      }
+#endif
+
+      if (iovcnt == 1)
+         return sendIntern(xsink, mname, (const char*)iov[0].iov_base, iov[0].iov_len, timeout_ms, total);
+
+      QoreString buf;
+      buf.reserve(size);
+      for (int i = 0; i < iovcnt; ++i)
+         buf.concat((const char*)iov[i].iov_base, iov[i].iov_len);
+      return sendIntern(xsink, mname, buf.getBuffer(), buf.size(), timeout_ms, total);
+   }
+
+   DLLLOCAL int sendv(ExceptionSink* xsink, const char* mname, struct iovec* iov, int iovcnt, int timeout_ms = -1) {
+      if (sock == QORE_INVALID_SOCKET) {
+	 if (xsink)
+	    se_not_open(mname, xsink);
+
+	 return QSE_NOT_OPEN;
+      }
+      if (in_op) {
+         if (xsink)
+            se_in_op(mname, xsink);
+         return QSE_IN_OP;
+      }
+
+      PrivateQoreSocketThroughputHelper th(this, true);
+
+      // set non-blocking I/O (and restore on exit) if we have a timeout and a non-ssl connection
+      OptionalNonBlockingHelper onbh(*this, !ssl && timeout_ms >= 0, xsink);
+      if (*xsink)
+         return -1;
+
+      int64 total = 0;
+      qore_offset_t rc = sendvIntern(xsink, mname, iov, iovcnt, timeout_ms, total);
+      th.finalize(total);
+
+      return rc < 0 || sock == QORE_INVALID_SOCKET ? rc : 0;
+   }
+
    DLLLOCAL int send(ExceptionSink* xsink, const char* mname, const char* buf, qore_size_t size, int timeout_ms = -1) {
       if (sock == QORE_INVALID_SOCKET) {
 	 if (xsink)
@@ -2122,6 +2476,388 @@ struct qore_socket_private {
       return rc < 0 || sock == QORE_INVALID_SOCKET ? rc : 0;
    }
 
+   DLLLOCAL int checkDatagram(const char* mname, ExceptionSink* xsink) {
+      if (sock == QORE_INVALID_SOCKET) {
+         se_not_open(mname, xsink);
+         return QSE_NOT_OPEN;
+      }
+      if (in_op) {
+         se_in_op(mname, xsink);
+         return QSE_IN_OP;
+      }
+      if (stype != SOCK_DGRAM) {
+         xsink->raiseException("SOCKET-DATAGRAM-ERROR", "Socket::%s() can only be called on datagram (SOCK_DGRAM) sockets", mname);
+         return -1;
+      }
+      return 0;
+   }
+
+   DLLLOCAL char* getDatagramBuffer(size_t size) {
+      if (size > dgram_buf_size) {
+         char* nb = (char*)realloc(dgram_buf, size);
+         if (!nb)
+            return 0;
+         dgram_buf = nb;
+         dgram_buf_size = size;
+      }
+      return dgram_buf;
+   }
+
+   DLLLOCAL QoreHashNode* getDatagram(const char* buf, size_t len, const struct sockaddr_storage& addr, socklen_t alen) const {
+      QoreHashNode* h = new QoreHashNode;
+      BinaryNode* b = new BinaryNode;
+      b->append(buf, len);
+      h->setKeyValue("data", b, 0);
+      if (alen && (addr.ss_family == AF_INET || addr.ss_family == AF_INET6))
+         h->setKeyValue("peer", getAddrInfo(addr, alen, false), 0);
+      return h;
+   }
+
+   // receives up to "max" datagrams of up to "size" bytes each; waits up to "timeout_ms" for the first datagram, the
+   // others are only returned if they are already queued; returns an empty list on timeout
+   DLLLOCAL QoreListNode* recvDatagrams(ExceptionSink* xsink, int max, size_t size, int timeout_ms) {
+      assert(max > 0 && size > 0);
+      if (checkDatagram("recvDatagrams", xsink))
+         return 0;
+      if (max > QORE_DGRAM_MAX_BATCH)
+         max = QORE_DGRAM_MAX_BATCH;
+
+      PrivateQoreSocketThroughputHelper th(this, false);
+
+      ReferenceHolder<QoreListNode> rv(new QoreListNode, xsink);
+      if (timeout_ms >= 0 && !isDataAvailable(timeout_ms, "recvDatagrams", xsink))
+         return *xsink ? 0 : rv.release();
+
+      int64 total = 0;
+#ifdef HAVE_RECVMMSG
+      char* buf = getDatagramBuffer(max * size);
+      if (!buf) {
+         xsink->outOfMemory();
+         return 0;
+      }
+
+      std::vector<struct mmsghdr> msgs(max);
+      std::vector<struct iovec> iov(max);
+      std::vector<struct sockaddr_storage> addrs(max);
+      for (int i = 0; i < max; ++i) {
+         iov[i].iov_base = buf + i * size;
+         iov[i].iov_len = size;
+         memset(&msgs[i], 0, sizeof(struct mmsghdr));
+         msgs[i].msg_hdr.msg_name = &addrs[i];
+         msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+         msgs[i].msg_hdr.msg_iov = &iov[i];
+         msgs[i].msg_hdr.msg_iovlen = 1;
+      }
+
+      int n;
+      while (true) {
+         // with a timeout, the socket is already readable; otherwise wait for the first datagram only
+         n = recvmmsg(sock, &msgs[0], max, timeout_ms >= 0 ? MSG_DONTWAIT : MSG_WAITFORONE, 0);
+         if (n >= 0)
+            break;
+         if (errno == EINTR)
+            continue;
+         // the data may have been read by another process sharing the socket
+         if (errno == EAGAIN
+#ifdef EWOULDBLOCK
+             || errno == EWOULDBLOCK
+#endif
+            )
+            return rv.release();
+         qore_socket_error(xsink, "SOCKET-RECV-ERROR", "error in recvmmsg()");
+         return 0;
+      }
+
+      for (int i = 0; i < n; ++i) {
+         rv->push(getDatagram(buf + i * size, msgs[i].msg_len, addrs[i], msgs[i].msg_hdr.msg_namelen));
+         total += msgs[i].msg_len;
+      }
+#else
+      char* buf = getDatagramBuffer(size);
+      if (!buf) {
+         xsink->outOfMemory();
+         return 0;
+      }
+
+      for (int i = 0; i < max; ++i) {
+         // only the first datagram is waited for
+         if (i && select(0, true, "recvDatagrams", 0) <= 0)
+            break;
+
+         struct sockaddr_storage addr;
+         socklen_t len = sizeof addr;
+         qore_offset_t rc = ::recvfrom(sock, buf, size, 0, (struct sockaddr*)&addr, &len);
+         if (rc == QORE_SOCKET_ERROR) {
+            if (sock_get_error() == EINTR) {
+               --i;
+               continue;
+            }
+            if (i)
+               break;
+            qore_socket_error(xsink, "SOCKET-RECV-ERROR", "error in recvfrom()");
+            return 0;
+         }
+         rv->push(getDatagram(buf, rc, addr, len));
+         total += rc;
+      }
+#endif
+
+      th.finalize(total);
+      return rv.release();
+   }
+
+   // gets the destination address of a datagram from a hash with "address" and "port" keys
+   DLLLOCAL static int getDatagramPeer(const QoreHashNode* peer, struct sockaddr_storage& addr, socklen_t& len, ExceptionSink* xsink) {
+      const AbstractQoreNode* a = peer->getKeyValue("address");
+      if (get_node_type(a) != NT_STRING) {
+         xsink->raiseException("SOCKET-DATAGRAM-ERROR", "the peer hash has no string \"address\" key");
+         return -1;
+      }
+      const char* astr = reinterpret_cast<const QoreStringNode*>(a)->getBuffer();
+      bool found;
+      int port = (int)peer->getKeyAsBigInt("port", found);
+
+      memset(&addr, 0, sizeof addr);
+      struct sockaddr_in* a4 = (struct sockaddr_in*)&addr;
+      struct sockaddr_in6* a6 = (struct sockaddr_in6*)&addr;
+      if (inet_pton(AF_INET, astr, &a4->sin_addr) == 1) {
+         a4->sin_family = AF_INET;
+         a4->sin_port = htons(port);
+         len = sizeof(struct sockaddr_in);
+      }
+      else if (inet_pton(AF_INET6, astr, &a6->sin6_addr) == 1) {
+         a6->sin6_family = AF_INET6;
+         a6->sin6_port = htons(port);
+         len = sizeof(struct sockaddr_in6);
+      }
+      else {
+         xsink->raiseException("SOCKET-DATAGRAM-ERROR", "cannot parse peer address '%s'; a numeric IPv4 or IPv6 address is required", astr);
+         return -1;
+      }
+      return 0;
+   }
+
+   // sends each hash in the list as one datagram; returns the number of datagrams sent or -1 for error
+   DLLLOCAL int sendDatagrams(ExceptionSink* xsink, const QoreListNode* l) {
+      if (checkDatagram("sendDatagrams", xsink))
+         return -1;
+
+      size_t n = l->size();
+      std::vector<struct iovec> iov(n);
+      std::vector<struct sockaddr_storage> addrs(n);
+      std::vector<socklen_t> alens(n);
+      // holds strings converted to the socket's encoding until the data has been sent
+      ReferenceHolder<QoreListNode> tmp(new QoreListNode, xsink);
+
+      for (size_t i = 0; i < n; ++i) {
+         const AbstractQoreNode* e = l->retrieve_entry(i);
+         if (get_node_type(e) != NT_HASH) {
+            xsink->raiseException("SOCKET-DATAGRAM-ERROR", "element " QLLD " of the list is type '%s'; expecting 'hash'", (int64)i, get_type_name(e));
+            return -1;
+         }
+         const QoreHashNode* h = reinterpret_cast<const QoreHashNode*>(e);
+
+         const AbstractQoreNode* d = h->getKeyValue("data");
+         qore_type_t t = get_node_type(d);
+         if (t == NT_BINARY) {
+            const BinaryNode* b = reinterpret_cast<const BinaryNode*>(d);
+            iov[i].iov_base = (void*)b->getPtr();
+            iov[i].iov_len = b->size();
+         }
+         else if (t == NT_STRING) {
+            const QoreStringNode* str = reinterpret_cast<const QoreStringNode*>(d);
+            if (str->getEncoding() != enc) {
+               QoreStringNode* cstr = str->convertEncoding(enc, xsink);
+               if (!cstr)
+                  return -1;
+               tmp->push(cstr);
+               str = cstr;
+            }
+            iov[i].iov_base = (void*)str->getBuffer();
+            iov[i].iov_len = str->strlen();
+         }
+         else {
+            xsink->raiseException("SOCKET-DATAGRAM-ERROR", "element " QLLD " of the list has no string or binary \"data\" key", (int64)i);
+            return -1;
+         }
+
+         const AbstractQoreNode* p = h->getKeyValue("peer");
+         if (get_node_type(p) == NT_HASH) {
+            if (getDatagramPeer(reinterpret_cast<const QoreHashNode*>(p), addrs[i], alens[i], xsink))
+               return -1;
+         }
+         else
+            alens[i] = 0;
+      }
+
+      PrivateQoreSocketThroughputHelper th(this, true);
+      int64 total = 0;
+      size_t sent = 0;
+
+#ifdef HAVE_SENDMMSG
+      std::vector<struct mmsghdr> msgs(n);
+      for (size_t i = 0; i < n; ++i) {
+         memset(&msgs[i], 0, sizeof(struct mmsghdr));
+         if (alens[i]) {
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = alens[i];
+         }
+         msgs[i].msg_hdr.msg_iov = &iov[i];
+         msgs[i].msg_hdr.msg_iovlen = 1;
+      }
+
+      while (sent < n) {
+         int rc = sendmmsg(sock, &msgs[sent], n - sent > QORE_DGRAM_MAX_BATCH ? QORE_DGRAM_MAX_BATCH : n - sent, 0);
+         if (rc < 0) {
+            if (errno == EINTR)
+               continue;
+            th.finalize(total);
+            qore_socket_error(xsink, "SOCKET-SEND-ERROR", "error in sendmmsg()");
+            return -1;
+         }
+         for (int i = 0; i < rc; ++i)
+            total += msgs[sent + i].msg_len;
+         sent += rc;
+      }
+#else
+      while (sent < n) {
+         qore_offset_t rc = ::sendto(sock, (const char*)iov[sent].iov_base, iov[sent].iov_len, 0, alens[sent] ? (struct sockaddr*)&addrs[sent] : 0, alens[sent]);
+         if (rc == QORE_SOCKET_ERROR) {
+            if (sock_get_error() == EINTR)
+               continue;
+            th.finalize(total);
+            qore_socket_error(xsink, "SOCKET-SEND-ERROR", "error in sendto()");
+            return -1;
+         }
+         total += rc;
+         ++sent;
+      }
+#endif
+
+      th.finalize(total);
+      return (int)sent;
+   }
+
+   // sends file data at the given offset without changing the file position; a negative size sends all data up to the end of the file
+   DLLLOCAL int sendFile(ExceptionSink* xsink, const char* mname, int fd, int64 offset, int64 size, int timeout_ms = -1) {
+      assert(xsink);
+      if (sock == QORE_INVALID_SOCKET) {
+         se_not_open(mname, xsink);
+	 return QSE_NOT_OPEN;
+      }
+      if (in_op) {
+         se_in_op(mname, xsink);
+         return QSE_IN_OP;
+      }
+      if (offset < 0) {
+         xsink->raiseException("SOCKET-SENDFILE-ERROR", "Socket::%s(): the file offset cannot be negative (value passed: " QLLD ")", mname, offset);
+         return -1;
+      }
+      if (size < 0) {
+         struct stat sbuf;
+         if (fstat(fd, &sbuf)) {
+            xsink->raiseErrnoException("SOCKET-SENDFILE-ERROR", errno, "Socket::%s(): cannot determine the size of the file", mname);
+            return -1;
+         }
+         size = sbuf.st_size > offset ? sbuf.st_size - offset : 0;
+      }
+      if (!size)
+         return 0;
+
+      PrivateQoreSocketThroughputHelper th(this, true);
+
+      // set non-blocking I/O (and restore on exit) if we have a timeout and a non-ssl connection
+      OptionalNonBlockingHelper onbh(*this, !ssl && timeout_ms >= 0, xsink);
+      if (*xsink)
+         return -1;
+
+      int64 total = 0;
+      int rc = 1;
+#ifdef QORE_USE_SENDFILE
+      if (!ssl)
+         rc = sendFileZeroCopy(xsink, mname, fd, offset, size, timeout_ms, total);
+#endif
+      // fall back to copying the data through a buffer with SSL connections or if the file does not support sendfile()
+      if (rc > 0)
+         rc = sendFileBuffered(xsink, mname, fd, offset, size, timeout_ms, total);
+      th.finalize(total);
+
+      return rc < 0 || sock == QORE_INVALID_SOCKET ? -1 : 0;
+   }
+
+#ifdef QORE_USE_SENDFILE
+   // returns 1 if sendfile() cannot be used with the given file and no data has been sent
+   DLLLOCAL int sendFileZeroCopy(ExceptionSink* xsink, const char* mname, int fd, int64 offset, int64 size, int timeout_ms, int64& total) {
+      off_t off = offset;
+      int64 bs = 0;
+      while (bs < size) {
+         int64 len = size - bs;
+         if (len > QORE_SENDFILE_CHUNK)
+            len = QORE_SENDFILE_CHUNK;
+         ssize_t rc = ::sendfile(sock, fd, &off, len);
+         if (rc < 0) {
+            sock_get_error();
+            if (errno == EINTR)
+               continue;
+            if (timeout_ms >= 0 && (errno == EAGAIN
+#ifdef EWOULDBLOCK
+                                    || errno == EWOULDBLOCK
+#endif
+                   )) {
+               if (!isWriteFinished(timeout_ms, mname, xsink)) {
+                  if (!*xsink)
+                     se_timeout(mname, timeout_ms, xsink);
+                  return -1;
+               }
+               continue;
+            }
+            if (!bs && (errno == EINVAL || errno == ENOSYS))
+               return 1;
+            xsink->raiseErrnoException("SOCKET-SEND-ERROR", errno, "error while executing Socket::%s()", mname);
+            if (errno == EPIPE || errno == ECONNRESET)
+               close();
+            return -1;
+         }
+         if (!rc) {
+            xsink->raiseException("SOCKET-SENDFILE-ERROR", "Socket::%s(): end of file reached after sending " QLLD " of " QLLD " byte%s", mname, bs, size, size == 1 ? "" : "s");
+            return -1;
+         }
+         bs += rc;
+         total += rc;
+         do_send_event(rc, bs, size);
+      }
+      return 0;
+   }
+#endif
+
+   DLLLOCAL int sendFileBuffered(ExceptionSink* xsink, const char* mname, int fd, int64 offset, int64 size, int timeout_ms, int64& total) {
+      char* buf = (char*)malloc(QORE_SENDFILE_BUFSIZE);
+      ON_BLOCK_EXIT(free, buf);
+
+      int64 bs = 0;
+      while (bs < size) {
+         int64 len = size - bs;
+         if (len > QORE_SENDFILE_BUFSIZE)
+            len = QORE_SENDFILE_BUFSIZE;
+         ssize_t rc = ::pread(fd, buf, len, offset + bs);
+         if (rc < 0) {
+            if (errno == EINTR)
+               continue;
+            xsink->raiseErrnoException("SOCKET-SENDFILE-ERROR", errno, "Socket::%s(): error reading file data", mname);
+            return -1;
+         }
+         if (!rc) {
+            xsink->raiseException("SOCKET-SENDFILE-ERROR", "Socket::%s(): end of file reached after sending " QLLD " of " QLLD " byte%s", mname, bs, size, size == 1 ? "" : "s");
+            return -1;
+         }
+         // sendIntern() raises send events for each block written
+         if (sendIntern(xsink, mname, buf, rc, timeout_ms, total) < 0 || sock == QORE_INVALID_SOCKET)
+            return -1;
+         bs += rc;
+      }
+      return 0;
+   }
+
    DLLLOCAL int sendHttpMessage(ExceptionSink* xsink, QoreHashNode* info, const char* method, const char* path, const char* http_version, const QoreHashNode* headers, const void *data, qore_size_t size, const ResolvedCallReferenceNode* send_callback, int source, int timeout_ms = -1, QoreThreadLock* l = 0, bool* aborted = 0) {
       assert(!(data && send_callback));
       // prepare header string
@@ -2141,16 +2877,27 @@ struct qore_socket_private {
 
       //printd(5, "qore_socket_private::sendHttpMessage() hdr: %s\n", hdr.getBuffer());
 
+      // send the header and body with a single write
+      if (size && data) {
+         struct iovec iov[2];
+         iov[0].iov_base = (void*)hdr.getBuffer();
+         iov[0].iov_len = hdr.strlen();
+         iov[1].iov_base = (void*)data;
+         iov[1].iov_len = size;
+         return sendv(xsink, "sendHTTPMessage", iov, 2, timeout_ms);
+      }
+
+      // cork the socket for chunked messages so that the header is sent in the same segment as the first chunk
+      TcpCorkHelper tch(*this, send_callback && !ssl);
+
       int rc;
       if ((rc = send(xsink, "sendHTTPMessage", hdr.getBuffer(), hdr.strlen(), timeout_ms)))
 	 return rc;
-      
-      if (size && data)
-         return send(xsink, "sendHTTPMessage", (char*)data, size, timeout_ms);
-      else if (send_callback) {
+
+      if (send_callback) {
          assert(l);
          assert(!aborted || !(*aborted));
-         return sendHttpChunkedWithCallback(xsink, "sendHTTPMessage", *send_callback, *l, source, timeout_ms, aborted);
+         return sendHttpChunkedWithCallback(xsink, "sendHTTPMessage", *send_callback, *l, source, timeout_ms, aborted, &tch);
       }
 
       return 0;
@@ -2171,22 +2918,85 @@ struct qore_socket_private {
    
       //printd(5, "QoreSocket::sendHTTPResponse() this: %p data: %p size: %ld send_callback: %p hdr: %s", this, data, size, send_callback, hdr.getBuffer());
    
+      // send the header and body with a single write
+      if (size && data) {
+         struct iovec iov[2];
+         iov[0].iov_base = (void*)hdr.getBuffer();
+         iov[0].iov_len = hdr.strlen();
+         iov[1].iov_base = (void*)data;
+         iov[1].iov_len = size;
+         return sendv(xsink, "sendHTTPResponse", iov, 2, timeout_ms);
+      }
+
+      // cork the socket for chunked messages so that the header is sent in the same segment as the first chunk
+      TcpCorkHelper tch(*this, send_callback && !ssl);
+
       int rc;
       if ((rc = send(xsink, "sendHTTPResponse", hdr.getBuffer(), hdr.strlen(), timeout_ms)))
 	 return rc;
 
-      if (size && data)
-         return send(xsink, "sendHTTPResponse", (char*)data, size, timeout_ms);
-      else if (send_callback) {
+      if (send_callback) {
          assert(l);
          assert(!aborted || !(*aborted));
-         return sendHttpChunkedWithCallback(xsink, "sendHTTPResponse", *send_callback, *l, source, timeout_ms, aborted);
+         return sendHttpChunkedWithCallback(xsink, "sendHTTPResponse", *send_callback, *l, source, timeout_ms, aborted, &tch);
+      }
+
+      return 0;
+   }
+
+   // reads a message body of the given length (or until the remote end closes the connection if len < 0) and passes it to "sink" in blocks of at most DEFAULT_SOCKET_BUFSIZE bytes
+   DLLLOCAL int readHttpBody(ExceptionSink* xsink, const char* mname, int64 len, int timeout, AbstractHttpBodySink& sink) {
+      assert(xsink);
+
+      if (sock == QORE_INVALID_SOCKET) {
+         se_not_open(mname, xsink);
+         return QSE_NOT_OPEN;
+      }
+      if (in_op) {
+         se_in_op(mname, xsink);
+         return QSE_IN_OP;
+      }
+
+      // the sink can run a callback with the socket lock released; other operations must not read from the socket
+      // until the body has been read
+      qore_socket_op_helper oh(this);
+
+      PrivateQoreSocketThroughputHelper th(this, false);
+
+      int64 br = 0;
+      while (len < 0 || br < len) {
+         qore_size_t bs = len < 0 || (len - br) > DEFAULT_SOCKET_BUFSIZE ? DEFAULT_SOCKET_BUFSIZE : (qore_size_t)(len - br);
+
+         char* buf;
+         qore_offset_t rc = brecv(xsink, mname, buf, bs, 0, timeout, false);
+         if (rc < 0) {
+            th.finalize(br);
+            return rc;
+         }
+         if (!rc) {
+            // a closed connection only terminates the message when no length is known
+            if (len < 0)
+               break;
+            th.finalize(br);
+            se_closed(mname, xsink);
+            return QSE_NOT_OPEN;
+         }
+
+         br += rc;
+         do_read_event(rc, br, len < 0 ? 0 : len);
+
+         if (sink.data(buf, rc, false, xsink)) {
+            th.finalize(br);
+            return -1;
+         }
       }
 
+      th.finalize(br);
       return 0;
    }
 
-   DLLLOCAL QoreHashNode* readHttpChunkedBodyBinary(int timeout, ExceptionSink* xsink, int source, const ResolvedCallReferenceNode* recv_callback = 0, QoreThreadLock* l = 0, QoreObject* obj = 0) {
+   // if "sink" is given, then each block of data received is passed to it directly instead of being buffered
+   DLLLOCAL QoreHashNode* readHttpChunkedBodyBinary(int timeout, ExceptionSink* xsink, int source, const ResolvedCallReferenceNode* recv_callback = 0, QoreThreadLock* l = 0, QoreObject* obj = 0, AbstractHttpBodySink* sink = 0) {
       assert(xsink);
 
       if (sock == QORE_INVALID_SOCKET) {
@@ -2272,7 +3082,12 @@ struct qore_socket_private {
                return 0;
             }
             
-            b->append(buf, rc);
+            if (sink) {
+               if (sink->data(buf, rc, true, xsink))
+                  return 0;
+            }
+            else
+               b->append(buf, rc);
             br += rc;
             
             if (br >= size)
@@ -2302,7 +3117,7 @@ struct qore_socket_private {
 
          do_chunked_read(QORE_EVENT_HTTP_CHUNKED_DATA_RECEIVED, size, size + 2, source);
 
-         if (recv_callback) {
+         if (recv_callback && !sink) {
             if (runDataCallback(xsink, "readHTTPChunkedBodyBinary", *recv_callback, l, *b, true))
                return 0;
             b->clear();
@@ -2318,7 +3133,7 @@ struct qore_socket_private {
          return 0;
 
       ReferenceHolder<QoreHashNode> h(new QoreHashNode, xsink);
-      if (!recv_callback)
+      if (!recv_callback && !sink)
          h->setKeyValue("body", b.release(), xsink);
    
       if (hdr) {
@@ -2589,37 +3404,33 @@ struct qore_socket_private {
       const char* senc = 0;
       // accept-charset
       bool acceptcharset = false;
-      while (*p) {
+      // each line is processed in place in a single pass: the line end and name separator are found with vectorized
+      // scans and the value string is created with its known length
+      char* end = p + strlen(p);
+      while (p < end) {
 	 char* buf = p;
 
-	 if ((p = strstr(buf, "\r\n"))) {
-	    *p = '\0';
-	    p += 2;
-	 }
-	 else if ((p = strchr(buf, '\n'))) {
-	    *p = '\0';
-	    p++;
-	 }
-	 else if ((p = strchr(buf, '\r'))) {
-	    *p = '\0';
-	    p++;
-	 }
-	 else
+	 char* eol = (char*)q_http_find_eol(buf, end);
+	 if (eol == end)
 	    break;
-	 char* t = strchr(buf, ':');
-	 if (!t)
+	 p = eol + (*eol == '\r' && eol[1] == '\n' ? 2 : 1);
+	 *eol = '\0';
+
+	 char* t = (char*)q_http_find_char(buf, eol, ':');
+	 if (t == eol)
 	    break;
+	 q_http_lower(buf, t);
+	 q_http_header_id_e hid = q_http_header_id(buf, t - buf);
 	 *t = '\0';
 	 t++;
-	 while (t && isblank(*t))
+	 while (isblank(*t))
 	    t++;
-	 strtolower(buf);
 	 //printd(5, "setting %s = '%s'\n", buf, t);
 
-	 AbstractQoreNode* val = new QoreStringNode(t);
+	 AbstractQoreNode* val = new QoreStringNode(t, eol - t);
 
 	 if (flags & CHF_PROCESS) {
-	    if (!strcmp(buf, "connection")) {
+	    if (hid == QHH_CONNECTION) {
 	       if (flags & CHF_HTTP11) {
 		  if (strcasestr(t, "close"))
 		     close = true;
@@ -2629,7 +3440,7 @@ struct qore_socket_private {
 		     close = false;
 	       }
 	    }
-	    else if (!strcmp(buf, "content-type")) {
+	    else if (hid == QHH_CONTENT_TYPE) {
 	       char* a = strcasestr(t, "charset=");
 	       if (a) {
 		  // find end
@@ -2678,13 +3489,13 @@ struct qore_socket_private {
 		  info->setKeyValue("body-content-type", val->refSelf(), 0);
 	       }
 	    }
-            else if (chunked && !strcmp(buf, "transfer-encoding") && !strcasecmp(t, "chunked")) {
+            else if (chunked && hid == QHH_TRANSFER_ENCODING && !strcasecmp(t, "chunked")) {
                *chunked = true;
             }
 	    else if (info) {
-	       if (!strcmp(buf, "accept-charset"))
+	       if (hid == QHH_ACCEPT_CHARSET)
 		  acceptcharset = do_accept_charset(t, *info);
-	       else if ((flags & CHF_REQUEST) && !strcmp(buf, "accept-encoding"))
+	       else if ((flags & CHF_REQUEST) && hid == QHH_ACCEPT_ENCODING)
 		  do_accept_encoding(t, *info);
 	    }
 	 }
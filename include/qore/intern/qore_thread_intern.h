@@ -93,6 +93,51 @@ class VNode;
 class AbstractQoreZoneInfo;
 class ThreadData;
 
+// use native thread-local variables for the current thread's data where supported, otherwise
+// the current thread's data is stored with QoreThreadLocalStorage (i.e. pthread_getspecific())
+#if !defined(QORE_NO_NATIVE_TLS) && defined(__GNUC__) && (defined(LINUX) || defined(__linux__))
+#define QORE_HAVE_NATIVE_TLS 1
+// the initial-exec model avoids calls to __tls_get_addr(); the few bytes required fit in the
+// static TLS reserve even when the library is loaded with dlopen()
+#define QORE_TLS __thread __attribute__((tls_model("initial-exec")))
+
+// the current thread's data; maintained when thread entries are activated and deleted
+DLLLOCAL extern QORE_TLS ThreadData* q_thread_data;
+// the current thread's TID or -1 if the current thread is not registered
+DLLLOCAL extern QORE_TLS int q_thread_tid;
+#ifdef QORE_BIASED_REFCOUNT
+// the current thread's reference count owner ID (thread generation << 32 | TID) or -1 if not registered
+DLLLOCAL extern QORE_TLS int64 q_thread_owner_id;
+#endif
+#endif
+
+#ifdef QORE_BIASED_REFCOUNT
+// returns the current thread's reference count owner ID; biased reference counting is only
+// used for threads when native thread-local variables are available
+DLLLOCAL inline int64 q_get_owner_id() {
+#ifdef QORE_HAVE_NATIVE_TLS
+   return q_thread_owner_id;
+#else
+   return -1;
+#endif
+}
+
+// returns true if the thread with the given reference count owner ID has not yet terminated
+DLLLOCAL bool q_owner_active(int64 owner_id);
+#endif
+
+// returns the current thread's Program; defined in ThreadData.h
+DLLLOCAL inline QoreProgram* q_get_program();
+
+// returns the current thread's TID; can be inlined in the library if native TLS is available
+DLLLOCAL inline int q_gettid() {
+#ifdef QORE_HAVE_NATIVE_TLS
+   return q_thread_tid;
+#else
+   return gettid();
+#endif
+}
+
 struct ModuleContextNamespaceCommit {
    qore_ns_private* parent;
    qore_ns_private* nns;
@@ -234,12 +279,12 @@ DLLLOCAL void purge_thread_resources(ExceptionSink* xsink);
 DLLLOCAL void mark_thread_resources();
 DLLLOCAL void beginParsing(const char* file, void* ps = NULL, const char* src = 0, int offset = 0);
 DLLLOCAL void* endParsing();
-DLLLOCAL Context* get_context_stack();
-DLLLOCAL void update_context_stack(Context* cstack);
+DLLLOCAL inline Context* get_context_stack();
+DLLLOCAL inline void update_context_stack(Context* cstack);
 
-DLLLOCAL QoreProgramLocation get_runtime_location();
-DLLLOCAL QoreProgramLocation update_get_runtime_location(const QoreProgramLocation& loc);
-DLLLOCAL void update_runtime_location(const QoreProgramLocation& loc);
+DLLLOCAL inline QoreProgramLocation get_runtime_location();
+DLLLOCAL inline QoreProgramLocation update_get_runtime_location(const QoreProgramLocation& loc);
+DLLLOCAL inline void update_runtime_location(const QoreProgramLocation& loc);
 
 DLLLOCAL void update_parse_line_location(int start_line, int end_line);
 DLLLOCAL void set_parse_file_info(QoreProgramLocation& loc);
@@ -264,7 +309,7 @@ DLLLOCAL void substituteObjectIfEqual(QoreObject* o);
 DLLLOCAL QoreObject* substituteObject(QoreObject* o);
 DLLLOCAL QoreException* catchSwapException(QoreException* e);
 DLLLOCAL QoreException* catchGetException();
-DLLLOCAL VLock* getVLock();
+DLLLOCAL inline VLock* getVLock();
 DLLLOCAL void end_signal_thread(ExceptionSink* xsink);
 DLLLOCAL void delete_thread_local_data();
 DLLLOCAL void parse_cond_push(bool mark = false);
@@ -329,8 +374,8 @@ DLLLOCAL void set_reexport(QoreAbstractModule* m, bool reexport);
 DLLLOCAL void parseSetCodeInfo(const char* parse_code, const QoreTypeInfo* returnTypeInfo, const char*& old_code, const QoreTypeInfo*& old_returnTypeInfo);
 DLLLOCAL void parseRestoreCodeInfo(const char* parse_code, const QoreTypeInfo* returnTypeInfo);
 // sets the new type and returns the old
-DLLLOCAL const QoreTypeInfo* saveReturnTypeInfo(const QoreTypeInfo* returnTypeInfo);
-DLLLOCAL const QoreTypeInfo* getReturnTypeInfo();
+DLLLOCAL inline const QoreTypeInfo* saveReturnTypeInfo(const QoreTypeInfo* returnTypeInfo);
+DLLLOCAL inline const QoreTypeInfo* getReturnTypeInfo();
 
 DLLLOCAL const QoreTypeInfo* parse_get_return_type_info();
 
@@ -401,6 +446,17 @@ DLLLOCAL int get_thread_entry();
 // acquires TID 0 and sets up the signal thread entry, always returns 0
 DLLLOCAL int get_signal_thread_entry();
 DLLLOCAL void deregister_signal_thread();
+
+// minimum number of elements of lists and hashes freed by the background reclaimer; 0 = disabled
+DLLLOCAL extern volatile unsigned qore_deferred_free_min;
+// returns true if the given container with "size" elements and no objects, closures or call references should be freed by the background reclaimer
+DLLLOCAL bool qore_check_deferred_free(const AbstractQoreNode* n, size_t size);
+// queues a container with one reference to be freed by the background reclaimer; returns false if it could not be queued
+DLLLOCAL bool qore_deferred_free(AbstractQoreNode* n);
+// returns the number of containers freed by the background reclaimer
+DLLLOCAL int64 qore_get_deferred_free_count();
+// calls the code for each element of the list in parallel threads and returns the results in the original order
+DLLLOCAL QoreListNode* qore_parallel_map(const QoreListNode* l, const ResolvedCallReferenceNode* f, int64 chunk, int64 max_threads, ExceptionSink* xsink);
 DLLLOCAL void register_thread(int tid, pthread_t ptid, QoreProgram* pgm, bool foreign = false);
 DLLLOCAL void deregister_thread(int tid);
 DLLLOCAL void delete_signal_thread();
@@ -416,21 +472,21 @@ DLLLOCAL block_list_t::iterator popBlock();
 // called by each "on_block_exit" statement to activate it's code for the block exit
 DLLLOCAL void advanceOnBlockExit();
 
-DLLLOCAL LocalVarValue* thread_instantiate_lvar();
-DLLLOCAL void thread_uninstantiate_lvar(ExceptionSink* xsink);
+DLLLOCAL inline LocalVarValue* thread_instantiate_lvar();
+DLLLOCAL inline void thread_uninstantiate_lvar(ExceptionSink* xsink);
 
 DLLLOCAL void thread_set_closure_parse_env(ClosureParseEnvironment* cenv);
 DLLLOCAL ClosureParseEnvironment* thread_get_closure_parse_env();
 
-DLLLOCAL ClosureVarValue* thread_instantiate_closure_var(const char* id, const QoreTypeInfo* typeInfo, QoreValue& nval);
-DLLLOCAL void thread_uninstantiate_closure_var(ExceptionSink* xsink);
-DLLLOCAL ClosureVarValue* thread_find_closure_var(const char* id);
+DLLLOCAL inline ClosureVarValue* thread_instantiate_closure_var(const char* id, const QoreTypeInfo* typeInfo, QoreValue& nval);
+DLLLOCAL inline void thread_uninstantiate_closure_var(ExceptionSink* xsink);
+DLLLOCAL inline ClosureVarValue* thread_find_closure_var(const char* id);
 
-DLLLOCAL ClosureVarValue* thread_get_runtime_closure_var(const LocalVar* id);
+DLLLOCAL inline ClosureVarValue* thread_get_runtime_closure_var(const LocalVar* id);
 DLLLOCAL const QoreClosureBase* thread_set_runtime_closure_env(const QoreClosureBase* current);
 
-DLLLOCAL int get_implicit_element();
-DLLLOCAL int save_implicit_element(int n_element);
+DLLLOCAL inline int get_implicit_element();
+DLLLOCAL inline int save_implicit_element(int n_element);
 
 DLLLOCAL void save_global_vnode(VNode* vn);
 DLLLOCAL VNode* get_global_vnode();
@@ -469,7 +525,7 @@ public:
 
 DLLLOCAL const QoreListNode* thread_get_implicit_args();
 
-DLLLOCAL LocalVarValue* thread_find_lvar(const char* id);
+DLLLOCAL inline LocalVarValue* thread_find_lvar(const char* id);
 
 // to get the current runtime object
 DLLLOCAL QoreObject* runtime_get_stack_object();
@@ -548,7 +604,7 @@ public:
    QoreProgram* pgm;
    const void* lvalue_id;
 
-   DLLLOCAL lvalue_ref(AbstractQoreNode* n_lvexp, QoreObject* n_self, const void* lvid) : vexp(n_lvexp), self(n_self), pgm(getProgram()), lvalue_id(lvid) {
+   DLLLOCAL lvalue_ref(AbstractQoreNode* n_lvexp, QoreObject* n_self, const void* lvid) : vexp(n_lvexp), self(n_self), pgm(q_get_program()), lvalue_id(lvid) {
       //printd(5, "lvalue_ref::lvalue_ref() this: %p vexp: %p self: %p pgm: %p\n", this, vexp, self, pgm);
       if (self)
          self->tRef();
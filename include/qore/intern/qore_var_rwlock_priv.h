@@ -63,8 +63,8 @@ public:
    }
 
    //! grabs the write lock
-   DLLLOCAL void wrlock() {
-      int tid = gettid();
+   DLLLOCAL virtual void wrlock() {
+      int tid = q_gettid();
       AutoLocker al(l);
       assert(tid != write_tid);
 
@@ -78,8 +78,8 @@ public:
    }
 
    //! tries to grab the write lock; does not block if unsuccessful; returns 0 if successful
-   DLLLOCAL int trywrlock() {
-      int tid = gettid();
+   DLLLOCAL virtual int trywrlock() {
+      int tid = q_gettid();
       AutoLocker al(l);
       assert(tid != write_tid);
       if (readers || write_tid != -1)
@@ -90,8 +90,8 @@ public:
    }
 
    //! unlocks the lock (assumes the lock is locked)
-   DLLLOCAL void unlock() {
-      int tid = gettid();
+   DLLLOCAL virtual void unlock() {
+      int tid = q_gettid();
       AutoLocker al(l);
       if (write_tid == tid) {
          write_tid = -1;
@@ -108,9 +108,9 @@ public:
    }
 
    //! grabs the read lock
-   DLLLOCAL void rdlock() {
+   DLLLOCAL virtual void rdlock() {
       AutoLocker al(l);
-      assert(write_tid != gettid());
+      assert(write_tid != q_gettid());
       while (write_tid != -1) {
 	 ++read_waiting;
 	 read_cond.wait(l);
@@ -121,9 +121,9 @@ public:
    }
 
    //! tries to grab the read lock; does not block if unsuccessful; returns 0 if successful
-   DLLLOCAL int tryrdlock() {
+   DLLLOCAL virtual int tryrdlock() {
       AutoLocker al(l);
-      assert(write_tid != gettid());
+      assert(write_tid != q_gettid());
       if (write_tid != -1)
 	 return -1;
 
@@ -145,6 +145,216 @@ public:
    }
 };
 
+// the number of reader count stripes for global variable locks; must be a power of 2
+#define QORE_VAR_LOCK_STRIPES 16
+// the size of a cache line; used to keep reader count stripes on separate cache lines
+#define QORE_CACHE_LINE_SIZE 64
+
+template <unsigned N>
+struct qore_var_reader_stripe {
+   volatile int count;
+   char pad[QORE_CACHE_LINE_SIZE - sizeof(int)];
+};
+
+// a single reader count does not need padding
+template <>
+struct qore_var_reader_stripe<1> {
+   volatile int count;
+};
+
+// read-write lock where read locks are counted atomically without acquiring the mutex; with N > 1 the
+// readers are counted in per-thread stripes on separate cache lines, so concurrent readers do not contend
+// with each other.  A writer sets write_pending, which sends new readers to a slow path that takes the mutex,
+// and waits for the reader counts to drain.  As with qore_var_rwlock_priv, readers only block while a writer
+// holds the lock, so a thread holding a read lock can acquire it again while a writer is waiting.  A sequence
+// counter also allows values that can be copied without side effects to be read without locking
+template <unsigned N>
+class qore_var_counted_rwlock_priv : public qore_var_rwlock_priv {
+protected:
+   qore_var_reader_stripe<N> stripe[N];
+   // set while a writer holds or is acquiring the lock
+   volatile int write_pending;
+   // incremented when the write lock is acquired and released; odd while a writer holds the lock
+   volatile unsigned seq;
+   // for the writer waiting for readers to release the lock
+   QoreCondition drain_cond;
+   int drain_waiting;
+
+   DLLLOCAL volatile int* readCount(int tid) {
+      return &stripe[tid & (N - 1)].count;
+   }
+
+   DLLLOCAL bool drained() const {
+      for (unsigned i = 0; i < N; ++i) {
+         if (qore_atomic_get(&stripe[i].count))
+            return false;
+      }
+      return true;
+   }
+
+   // returns true if the read lock was acquired
+   DLLLOCAL bool rdlockFast(int tid) {
+      volatile int* c = readCount(tid);
+      qore_atomic_add(c, 1);
+      if (!qore_atomic_get(&write_pending))
+         return true;
+      // back off and take the slow path
+      rdunlockIntern(c);
+      return false;
+   }
+
+   DLLLOCAL void rdunlockIntern(volatile int* c) {
+      qore_atomic_sub(c, 1);
+      if (qore_atomic_get(&write_pending)) {
+         AutoLocker al(l);
+         if (drain_waiting)
+            drain_cond.signal();
+      }
+   }
+
+   // grabs the read lock in the slow path; must be called with the mutex held
+   DLLLOCAL void rdlockIntern(int tid) {
+      // no writer can set write_pending while the mutex is held, so a pending writer will see this reader
+      qore_atomic_add(readCount(tid), 1);
+   }
+
+   // announces the writer; the compare and swap is a full barrier, so either a reader's count increment is
+   // visible to the writer or the reader sees write_pending and backs off; must be called with the mutex held
+   DLLLOCAL void setWritePending() {
+      qore_atomic_cas(&write_pending, 0, 1);
+   }
+
+public:
+   DLLLOCAL qore_var_counted_rwlock_priv() : write_pending(0), seq(0), drain_waiting(0) {
+      for (unsigned i = 0; i < N; ++i)
+         stripe[i].count = 0;
+   }
+
+   //! grabs the write lock
+   DLLLOCAL virtual void wrlock() {
+      int tid = q_gettid();
+      AutoLocker al(l);
+      assert(tid != write_tid);
+
+      while (write_tid != -1 || write_pending) {
+         ++write_waiting;
+         write_cond.wait(l);
+         --write_waiting;
+      }
+
+      setWritePending();
+      while (!drained()) {
+         ++drain_waiting;
+         drain_cond.wait(l);
+         --drain_waiting;
+      }
+      write_tid = tid;
+      qore_atomic_add(&seq, 1u);
+   }
+
+   //! tries to grab the write lock; does not block if unsuccessful; returns 0 if successful
+   DLLLOCAL virtual int trywrlock() {
+      int tid = q_gettid();
+      AutoLocker al(l);
+      assert(tid != write_tid);
+      if (write_tid != -1 || write_pending)
+         return -1;
+
+      setWritePending();
+      if (!drained()) {
+         qore_atomic_set(&write_pending, 0);
+         if (write_waiting)
+            write_cond.signal();
+         return -1;
+      }
+      write_tid = tid;
+      qore_atomic_add(&seq, 1u);
+      return 0;
+   }
+
+   //! unlocks the lock (assumes the lock is locked)
+   DLLLOCAL virtual void unlock() {
+      int tid = q_gettid();
+      // write_tid can only be equal to the current TID if this thread holds the write lock
+      if (write_tid == tid) {
+         AutoLocker al(l);
+         qore_atomic_add(&seq, 1u);
+         write_tid = -1;
+         qore_atomic_set(&write_pending, 0);
+         if (has_notify)
+            notifyIntern();
+
+         unlock_signal();
+         return;
+      }
+
+      rdunlockIntern(readCount(tid));
+   }
+
+   //! grabs the read lock
+   DLLLOCAL virtual void rdlock() {
+      int tid = q_gettid();
+      assert(write_tid != tid);
+      if (rdlockFast(tid))
+         return;
+
+      AutoLocker al(l);
+      while (write_tid != -1) {
+         ++read_waiting;
+         read_cond.wait(l);
+         --read_waiting;
+      }
+      rdlockIntern(tid);
+   }
+
+   //! tries to grab the read lock; does not block if unsuccessful; returns 0 if successful
+   DLLLOCAL virtual int tryrdlock() {
+      int tid = q_gettid();
+      assert(write_tid != tid);
+      if (rdlockFast(tid))
+         return 0;
+
+      AutoLocker al(l);
+      if (write_tid != -1)
+         return -1;
+      rdlockIntern(tid);
+      return 0;
+   }
+
+   //! starts an optimistic read; returns false if a writer holds the lock
+   DLLLOCAL bool readBegin(unsigned& s) const {
+      s = qore_atomic_get(&seq);
+      return !(s & 1);
+   }
+
+   //! returns true if no writer has acquired the lock since readBegin()
+   DLLLOCAL bool readValidate(unsigned s) const {
+      // the reads of the protected data must complete before the sequence is read again
+      __sync_synchronize();
+      return seq == s;
+   }
+};
+
+// lock for global variables
+typedef qore_var_counted_rwlock_priv<QORE_VAR_LOCK_STRIPES> qore_var_striped_rwlock_priv;
+
+// global variable lock with scalable read locking and optimistic reads
+class QoreVarStripedRWLock : public QoreVarRWLock {
+public:
+   DLLLOCAL QoreVarStripedRWLock() : QoreVarRWLock(new qore_var_striped_rwlock_priv) {
+   }
+
+   //! starts an optimistic read; returns false if a writer holds the lock
+   DLLLOCAL bool readBegin(unsigned& s) const {
+      return static_cast<qore_var_striped_rwlock_priv*>(priv)->readBegin(s);
+   }
+
+   //! returns true if no writer has acquired the lock since readBegin()
+   DLLLOCAL bool readValidate(unsigned s) const {
+      return static_cast<qore_var_striped_rwlock_priv*>(priv)->readValidate(s);
+   }
+};
+
 class QoreAutoVarRWReadLocker {
 private:
    //! this function is not implemented; it is here as a private function in order to prohibit it from being used
@@ -162,4 +162,16 @@ When you are done, don't forget to free XXH state space, using typically XXHnn_f
   
 #if defined (__cplusplus)
 }
+
+#include <string>
+
+   struct qore_hash_std_str {
+      DLLLOCAL size_t operator()(const std::string& s) const {
+#if TARGET_BITS == 64
+	return XXH64(s.data(), s.size(), 0);
+#else
+	return XXH32(s.data(), s.size(), 0);
+#endif
+      }
+   };
 #endif
@@ -227,6 +227,38 @@ DLLEXPORT int q_deregister_reserved_foreign_thread();
  */
 int q_start_thread(ExceptionSink* xsink, q_thread_t f, void* arg = 0);
 
+//! sets the maximum number of idle pthreads kept parked for reuse by the background operator
+/** when non-zero, threads started with the background operator run in pooled pthreads; each background
+    expression still gets a new TID, thread-local data, thread resource list and call stack, only the
+    underlying pthread is reused.  Parked pthreads exit after one minute without work
+
+    @param max_idle the maximum number of parked pthreads; 0 (the default) disables pooling
+
+    @since %Qore 0.8.12
+ */
+DLLEXPORT void qore_set_background_thread_pool(unsigned max_idle);
+
+//! returns the maximum number of idle pthreads kept parked for reuse by the background operator; 0 means that pooling is disabled
+/** @since %Qore 0.8.12
+ */
+DLLEXPORT unsigned qore_get_background_thread_pool();
+
+//! sets the minimum number of elements of lists and hashes that are freed in a background thread
+/** when non-zero, lists and hashes with at least this number of elements that contain only lists, hashes and
+    simple values (no objects, closures or call references, even when nested) are handed to a background pthread
+    when their last reference is released instead of being freed in the releasing thread
+
+    @param min_size the minimum number of elements; 0 (the default) disables deferred freeing
+
+    @since %Qore 0.8.12
+ */
+DLLEXPORT void qore_set_deferred_free(unsigned min_size);
+
+//! returns the minimum number of elements of lists and hashes that are freed in a background thread; 0 means that deferred freeing is disabled
+/** @since %Qore 0.8.12
+ */
+DLLEXPORT unsigned qore_get_deferred_free();
+
 //! use this class to temporarily register and deregister a foreign thread to allow Qore code to be executed and the Qore library to be used from threads not created by the Qore library
 /** @since %Qore 0.8.7
  */
@@ -107,16 +107,16 @@ void AbstractQoreNode::deref(ExceptionSink* xsink) {
       printd(REF_LVL, "AbstractQoreNode::deref() %p type: %d %s (%d->%d)\n", this, type, getTypeName(), references, references - 1);
 
 #endif
-   if (references > 10000000 || references <= 0){
+   if (reference_count() > 10000000 || reference_count() <= 0){
       if (type == NT_STRING)
 	 printd(0, "AbstractQoreNode::deref() WARNING, node %p references: %d (type: %s) (val=\"%s\")\n",
-		this, references, getTypeName(), ((QoreStringNode*)this)->getBuffer());
+		this, reference_count(), getTypeName(), ((QoreStringNode*)this)->getBuffer());
       else
-	 printd(0, "AbstractQoreNode::deref() WARNING, node %p references: %d (type: %s)\n", this, references, getTypeName());
+	 printd(0, "AbstractQoreNode::deref() WARNING, node %p references: %d (type: %s)\n", this, reference_count(), getTypeName());
       assert(false);
    }
 #endif
-   assert(references > 0);
+   assert(reference_count() > 0);
 
    if (there_can_be_only_one) {
       assert(is_unique());
@@ -511,8 +511,12 @@ AbstractQoreNode* copy_and_resolve_lvar_refs(const AbstractQoreNode* n, Exceptio
    // must make sure to return a value here or it could cause a segfault - parse expressions expect non-NULL values for the operands
    else if (ntype == NT_FIND)
       return eval_notnull(n, xsink);
-   else if (ntype == NT_VARREF && reinterpret_cast<const VarRefNode*>(n)->getType() != VT_GLOBAL)
-      return eval_notnull(n, xsink);
+   else if (ntype == NT_VARREF && reinterpret_cast<const VarRefNode*>(n)->getType() != VT_GLOBAL) {
+      AbstractQoreNode* rv = eval_notnull(n, xsink);
+      // local variable values are handed off to the background thread
+      q_share_value(rv);
+      return rv;
+   }
    else if (ntype == NT_FUNCREFCALL)
       return call_ref_call_copy(reinterpret_cast<const CallReferenceCallNode*>(n), xsink);
    else if (ntype == NT_METHOD_CALL)
@@ -586,7 +590,11 @@ bool get_container_obj(const AbstractQoreNode* n) {
    switch (n->getType()) {
       case NT_LIST: return qore_list_private::getObjectCount(*static_cast<const QoreListNode*>(n)) ? true : false;
       case NT_HASH: return qore_hash_private::getObjectCount(*static_cast<const QoreHashNode*>(n)) ? true : false;
-      case NT_OBJECT: return true;
+      case NT_OBJECT:
+      // closures and call references can hold references to objects
+      case NT_RUNTIME_CLOSURE:
+      case NT_FUNCREF:
+         return true;
    }
 
    return false;
@@ -601,3 +609,27 @@ void inc_container_obj(const AbstractQoreNode* n, int dt) {
       default: assert(false);
    }
 }
+
+#ifdef QORE_BIASED_REFCOUNT
+void q_share_value(const AbstractQoreNode* n) {
+   // objects manage their own reference counts; values that have already been handed off or that are owned
+   // by another thread are not processed further
+   if (!n || !n->isReferenceCounted() || n->getType() == NT_OBJECT || !n->ROshare())
+      return;
+
+   switch (n->getType()) {
+      case NT_LIST: {
+         const QoreListNode* l = reinterpret_cast<const QoreListNode*>(n);
+         for (unsigned i = 0; i < l->size(); ++i)
+            q_share_value(l->retrieve_entry(i));
+         break;
+      }
+      case NT_HASH: {
+         ConstHashIterator hi(reinterpret_cast<const QoreHashNode*>(n));
+         while (hi.next())
+            q_share_value(hi.getValue());
+         break;
+      }
+   }
+}
+#endif
@@ -32,12 +32,12 @@
 #include <qore/intern/AbstractSmartLock.h>
 
 void AbstractSmartLock::cleanupImpl() {
-   if (tid == gettid())
+   if (tid == q_gettid())
       release_and_signal();
 }
 
 void AbstractSmartLock::cleanup(ExceptionSink *xsink) {
-   xsink->raiseException("LOCK-ERROR", "TID %d terminated while holding a %s lock; the lock will be automatically released", gettid(), getName());
+   xsink->raiseException("LOCK-ERROR", "TID %d terminated while holding a %s lock; the lock will be automatically released", q_gettid(), getName());
    AutoLocker al(&asl_lock);	    
    cleanupImpl();
 }
@@ -47,6 +47,9 @@ void AbstractSmartLock::mark_and_push(int mtid, VLock *nvl) {
    
    tid = mtid;
    vl = nvl;
+
+   if (stats)
+      stats->acquired(nvl->takeWaitStart());
 }
 
 void AbstractSmartLock::signalAllImpl() {
@@ -60,6 +63,9 @@ void AbstractSmartLock::signalImpl() {
 }
 
 void AbstractSmartLock::release_and_signal() {
+   if (stats)
+      stats->released();
+
    vl->pop(this);
    
    if (tid >= 0)
@@ -88,7 +94,7 @@ void AbstractSmartLock::destructor(ExceptionSink *xsink) {
    if (tid >= 0) {
       vl->pop(this);
       
-      int mtid = gettid();
+      int mtid = q_gettid();
       if (mtid == tid) {
 	 xsink->raiseException("LOCK-ERROR", "TID %d deleted %s object while holding the lock", mtid, getName());
 	 remove_thread_resource(this);
@@ -107,25 +113,27 @@ void AbstractSmartLock::destructor(ExceptionSink *xsink) {
 //    < 0 = error occured (deadlock or timeout)
 /*
 int AbstractSmartLock::grabIntern(ExceptionSink *xsink) {
-int mtid = gettid();
+int mtid = q_gettid();
 AutoLocker al(&asl_lock);
 return grabInternImpl(mtid);
 }
 */
 
 int AbstractSmartLock::grab(ExceptionSink *xsink, int64 timeout_ms) {
-   int mtid = gettid();
+   int mtid = q_gettid();
    
    VLock *nvl = getVLock();
    AutoLocker al(&asl_lock);
    int rc = grabImpl(mtid, nvl, xsink, timeout_ms);
    if (!rc)
       grab_intern(mtid, nvl);
+   else if (rc < 0)
+      nvl->takeWaitStart();
    return rc;
 }
 
 int AbstractSmartLock::tryGrab() {
-   int mtid = gettid();
+   int mtid = q_gettid();
    VLock *nvl = getVLock();
    AutoLocker al(&asl_lock);
    int rc = tryGrabImpl(mtid, nvl);
@@ -157,7 +165,28 @@ int AbstractSmartLock::externWaitImpl(int mtid, QoreCondition *cond, ExceptionSi
 
 int AbstractSmartLock::extern_wait(QoreCondition *cond, ExceptionSink *xsink, int64 timeout_ms) {
    AutoLocker al(&asl_lock);
-   return externWaitImpl(gettid(), cond, xsink, timeout_ms);
+   int rc = externWaitImpl(q_gettid(), cond, xsink, timeout_ms);
+   // discard any wait time not consumed by reacquiring the lock
+   if (stats)
+      getVLock()->takeWaitStart();
+   return rc;
+}
+
+void AbstractSmartLock::setLockStats(bool enable) {
+   AutoLocker al(&asl_lock);
+   if (enable == (bool)stats)
+      return;
+   if (enable)
+      stats = new QoreLockStats(getName());
+   else {
+      delete stats;
+      stats = 0;
+   }
+}
+
+QoreHashNode* AbstractSmartLock::getLockStats() const {
+   AutoLocker al(&asl_lock);
+   return stats ? stats->getHash() : 0;
 }
 
 int AbstractSmartLock::verify_wait_unlocked(int mtid, ExceptionSink *xsink) {
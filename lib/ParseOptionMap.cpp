@@ -80,6 +80,7 @@ void ParseOptionMap::static_init() {
    DO_MAP("no-api",                   PO_NO_API);
    DO_MAP("no-user-constants",        PO_NO_INHERIT_USER_CONSTANTS);
    DO_MAP("no-system-constants",      PO_NO_INHERIT_SYSTEM_CONSTANTS);
+   DO_MAP("no-deadlock-detection",    PO_NO_DEADLOCK_DETECTION);
 }
 
 int ParseOptionMap::find_code(const char *name) {
@@ -0,0 +1,372 @@
+/*
+  QoreCache.cpp
+
+  Qore Programming Language
+
+  Copyright (C) 2005 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+
+#include <qore/Qore.h>
+#include <qore/intern/QoreCache.h>
+
+// fixed overhead of a cache entry: the list node, the map node and the entry itself
+#define QORE_CACHE_ENTRY_OVERHEAD (sizeof(QoreCacheEntry) + 64)
+
+QoreCache::QoreCache(int64 n_max_entries, int64 n_max_bytes, int64 ttl_ms, ResolvedCallReferenceNode* n_loader) : nshards(QORE_CACHE_SHARDS), ttl_us(ttl_ms * 1000), loader(n_loader) {
+   // use fewer shards for small caches so that LRU eviction stays reasonably accurate
+   while (nshards > 1 && ((n_max_entries && (n_max_entries / nshards) < QORE_CACHE_MIN_SHARD_ENTRIES)
+                          || (n_max_bytes && (n_max_bytes / nshards) < QORE_CACHE_MIN_SHARD_BYTES)))
+      nshards >>= 1;
+   shards = new QoreCacheShard[nshards];
+   max_entries = n_max_entries ? (size_t)((n_max_entries + nshards - 1) / nshards) : 0;
+   max_bytes = n_max_bytes ? (size_t)((n_max_bytes + nshards - 1) / nshards) : 0;
+}
+
+size_t QoreCache::getNodeSize(const AbstractQoreNode* n) {
+   if (!n)
+      return 0;
+
+   switch (n->getType()) {
+      case NT_STRING:
+         return sizeof(QoreStringNode) + reinterpret_cast<const QoreStringNode*>(n)->capacity();
+
+      case NT_BINARY:
+         return sizeof(BinaryNode) + reinterpret_cast<const BinaryNode*>(n)->size();
+
+      case NT_LIST: {
+         const QoreListNode* l = reinterpret_cast<const QoreListNode*>(n);
+         size_t rv = sizeof(QoreListNode) + l->size() * sizeof(AbstractQoreNode*);
+         ConstListIterator li(l);
+         while (li.next())
+            rv += getNodeSize(li.getValue());
+         return rv;
+      }
+
+      case NT_HASH: {
+         const QoreHashNode* h = reinterpret_cast<const QoreHashNode*>(n);
+         size_t rv = sizeof(QoreHashNode);
+         ConstHashIterator hi(h);
+         while (hi.next())
+            rv += QORE_CACHE_ENTRY_OVERHEAD + strlen(hi.getKey()) + getNodeSize(hi.getValue());
+         return rv;
+      }
+
+      case NT_OBJECT:
+         // object members are not traversed, as objects can be shared and referenced recursively
+         return 256;
+
+      default:
+         return 32;
+   }
+}
+
+void QoreCache::erase(QoreCacheShard& s, cache_map_t::iterator i, cache_node_list_t& rel) {
+   cache_lru_t::iterator li = i->second;
+   rel.push_back(li->val);
+   s.bytes -= li->size;
+   --s.count;
+   s.map.erase(i);
+   s.lru.erase(li);
+}
+
+bool QoreCache::find(QoreCacheShard& s, const std::string& key, AbstractQoreNode*& rv, cache_node_list_t& rel) {
+   cache_map_t::iterator i = s.map.find(key);
+   if (i == s.map.end())
+      return false;
+
+   cache_lru_t::iterator li = i->second;
+   // expired entries are removed lazily when they are accessed or evicted
+   if (li->expires && li->expires <= q_clock_getmicros()) {
+      erase(s, i, rel);
+      ++s.expirations;
+      return false;
+   }
+
+   // move to the front of the LRU list
+   if (li != s.lru.begin())
+      s.lru.splice(s.lru.begin(), s.lru, li);
+   rv = li->val ? li->val->refSelf() : 0;
+   return true;
+}
+
+void QoreCache::set(QoreCacheShard& s, const std::string& key, AbstractQoreNode* val, int64 n_ttl_us, cache_node_list_t& rel) {
+   int64 expires = n_ttl_us ? q_clock_getmicros() + n_ttl_us : 0;
+   size_t size = max_bytes ? QORE_CACHE_ENTRY_OVERHEAD + key.size() + getNodeSize(val) : 0;
+
+   cache_map_t::iterator i = s.map.find(key);
+   if (i != s.map.end()) {
+      cache_lru_t::iterator li = i->second;
+      rel.push_back(li->val);
+      li->val = val;
+      li->expires = expires;
+      s.bytes = s.bytes - li->size + size;
+      li->size = size;
+      if (li != s.lru.begin())
+         s.lru.splice(s.lru.begin(), s.lru, li);
+   }
+   else {
+      s.lru.push_front(QoreCacheEntry(key, val, expires, size));
+      s.map[key] = s.lru.begin();
+      ++s.count;
+      s.bytes += size;
+   }
+
+   // evict least recently used entries; the new entry is always kept
+   while (s.count > 1 && ((max_entries && s.count > max_entries) || (max_bytes && s.bytes > max_bytes))) {
+      cache_lru_t::iterator li = s.lru.end();
+      --li;
+      if (li->expires && li->expires <= q_clock_getmicros())
+         ++s.expirations;
+      else
+         ++s.evictions;
+      erase(s, s.map.find(li->key), rel);
+   }
+}
+
+int QoreCache::startWait(int tid, int ltid) {
+   AutoLocker al(wait_lock);
+   // follow the chain of threads that the loader is waiting for; the chain cannot contain a cycle that does not
+   // include the current thread, since each cycle is detected by the thread that would complete it
+   for (int t = ltid; ; ) {
+      if (t == tid)
+         return -1;
+      cache_wait_map_t::iterator i = waits.find(t);
+      if (i == waits.end())
+         break;
+      t = i->second;
+   }
+   waits[tid] = ltid;
+   return 0;
+}
+
+AbstractQoreNode* QoreCache::get(const QoreStringNode* kstr, ExceptionSink* xsink) {
+   TempEncodingHelper tmp(kstr, QCS_DEFAULT, xsink);
+   if (*xsink)
+      return 0;
+   std::string key(tmp->getBuffer(), tmp->strlen());
+
+   QoreCacheShard& s = getShard(key);
+   cache_node_list_t rel;
+   AbstractQoreNode* rv = 0;
+
+   SafeLocker sl(s.l);
+   if (find(s, key, rv, rel)) {
+      ++s.hits;
+      sl.unlock();
+      derefList(rel, xsink);
+      return rv;
+   }
+   ++s.misses;
+
+   if (!loader) {
+      sl.unlock();
+      derefList(rel, xsink);
+      return 0;
+   }
+
+   int tid = gettid();
+   cache_load_map_t::iterator li = s.loads.find(key);
+   if (li != s.loads.end()) {
+      // another thread is already loading this key; wait for the result
+      QoreCacheLoad* ld = li->second;
+      if (ld->tid == tid) {
+         sl.unlock();
+         derefList(rel, xsink);
+         xsink->raiseException("CACHE-LOADER-ERROR", "the loader for key '%s' requested the same key recursively", key.c_str());
+         return 0;
+      }
+      // the loader may itself be waiting for a key that is being loaded by this thread
+      if (startWait(tid, ld->tid)) {
+         int ltid = ld->tid;
+         sl.unlock();
+         derefList(rel, xsink);
+         xsink->raiseException("CACHE-LOADER-ERROR", "waiting for the loader for key '%s' in TID %d would deadlock, as it is waiting for a key being loaded by TID %d", key.c_str(), ltid, tid);
+         return 0;
+      }
+      ++ld->refs;
+      while (!ld->done)
+         ld->cond.wait(s.l);
+      endWait(tid);
+      bool failed = ld->failed;
+      int ltid = ld->tid;
+      rv = ld->val ? ld->val->refSelf() : 0;
+      if (!--ld->refs) {
+         rel.push_back(ld->val);
+         delete ld;
+      }
+      sl.unlock();
+      derefList(rel, xsink);
+      if (failed)
+         xsink->raiseException("CACHE-LOADER-ERROR", "the loader for key '%s' raised an exception in TID %d", key.c_str(), ltid);
+      return rv;
+   }
+
+   QoreCacheLoad* ld = new QoreCacheLoad(tid);
+   s.loads[key] = ld;
+   sl.unlock();
+   derefList(rel, xsink);
+   rel.clear();
+
+   // run the loader without holding the shard lock
+   ReferenceHolder<QoreListNode> args(new QoreListNode, xsink);
+   args->push(kstr->refSelf());
+   rv = loader->execValue(*args, xsink).takeNode();
+
+   sl.lock();
+   s.loads.erase(key);
+   if (*xsink) {
+      ld->failed = true;
+      rel.push_back(rv);
+      rv = 0;
+   }
+   else {
+      ++s.loaded;
+      // the value is not stored if the key was set or removed while the loader was running
+      if (!ld->invalidated)
+         set(s, key, rv ? rv->refSelf() : 0, ttl_us, rel);
+      ld->val = rv ? rv->refSelf() : 0;
+   }
+   ld->done = true;
+   if (ld->refs > 1)
+      ld->cond.broadcast();
+   if (!--ld->refs) {
+      rel.push_back(ld->val);
+      delete ld;
+   }
+   sl.unlock();
+   derefList(rel, xsink);
+   return rv;
+}
+
+void QoreCache::put(const std::string& key, AbstractQoreNode* val, int64 ttl_ms, ExceptionSink* xsink) {
+   QoreCacheShard& s = getShard(key);
+   cache_node_list_t rel;
+   {
+      AutoLocker al(s.l);
+      invalidateLoad(s, key);
+      set(s, key, val, ttl_ms < 0 ? ttl_us : ttl_ms * 1000, rel);
+   }
+   derefList(rel, xsink);
+}
+
+AbstractQoreNode* QoreCache::remove(const std::string& key, ExceptionSink* xsink) {
+   QoreCacheShard& s = getShard(key);
+   cache_node_list_t rel;
+   AbstractQoreNode* rv = 0;
+   {
+      AutoLocker al(s.l);
+      invalidateLoad(s, key);
+      cache_map_t::iterator i = s.map.find(key);
+      if (i != s.map.end()) {
+         cache_lru_t::iterator li = i->second;
+         if (li->expires && li->expires <= q_clock_getmicros()) {
+            ++s.expirations;
+            erase(s, i, rel);
+         }
+         else {
+            // take over the reference from the entry
+            rv = li->val;
+            li->val = 0;
+            erase(s, i, rel);
+         }
+      }
+   }
+   derefList(rel, xsink);
+   return rv;
+}
+
+bool QoreCache::exists(const std::string& key, ExceptionSink* xsink) {
+   QoreCacheShard& s = getShard(key);
+   cache_node_list_t rel;
+   bool rv;
+   {
+      AutoLocker al(s.l);
+      cache_map_t::iterator i = s.map.find(key);
+      if (i == s.map.end())
+         rv = false;
+      else if (i->second->expires && i->second->expires <= q_clock_getmicros()) {
+         ++s.expirations;
+         erase(s, i, rel);
+         rv = false;
+      }
+      else
+         rv = true;
+   }
+   derefList(rel, xsink);
+   return rv;
+}
+
+int64 QoreCache::size() {
+   int64 rv = 0;
+   for (unsigned i = 0; i < nshards; ++i) {
+      AutoLocker al(shards[i].l);
+      rv += shards[i].count;
+   }
+   return rv;
+}
+
+void QoreCache::clear(ExceptionSink* xsink) {
+   cache_node_list_t rel;
+   for (unsigned i = 0; i < nshards; ++i) {
+      QoreCacheShard& s = shards[i];
+      AutoLocker al(s.l);
+      for (cache_load_map_t::iterator i = s.loads.begin(), e = s.loads.end(); i != e; ++i)
+         i->second->invalidated = true;
+      for (cache_lru_t::iterator li = s.lru.begin(), e = s.lru.end(); li != e; ++li)
+         rel.push_back(li->val);
+      s.lru.clear();
+      s.map.clear();
+      s.count = 0;
+      s.bytes = 0;
+   }
+   derefList(rel, xsink);
+}
+
+QoreHashNode* QoreCache::getStats() {
+   int64 hits = 0, misses = 0, evictions = 0, expirations = 0, loaded = 0, entries = 0, bytes = 0;
+   for (unsigned i = 0; i < nshards; ++i) {
+      QoreCacheShard& s = shards[i];
+      AutoLocker al(s.l);
+      hits += s.hits;
+      misses += s.misses;
+      evictions += s.evictions;
+      expirations += s.expirations;
+      loaded += s.loaded;
+      entries += s.count;
+      bytes += s.bytes;
+   }
+
+   QoreHashNode* h = new QoreHashNode;
+   h->setKeyValue("hits", new QoreBigIntNode(hits), 0);
+   h->setKeyValue("misses", new QoreBigIntNode(misses), 0);
+   h->setKeyValue("evictions", new QoreBigIntNode(evictions), 0);
+   h->setKeyValue("expirations", new QoreBigIntNode(expirations), 0);
+   h->setKeyValue("loads", new QoreBigIntNode(loaded), 0);
+   h->setKeyValue("entries", new QoreBigIntNode(entries), 0);
+   h->setKeyValue("bytes", new QoreBigIntNode(bytes), 0);
+   h->setKeyValue("shards", new QoreBigIntNode(nshards), 0);
+   return h;
+}
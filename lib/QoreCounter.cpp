@@ -30,15 +30,18 @@
 
 #include <qore/Qore.h>
 #include <qore/QoreCounter.h>
+#include <qore/intern/qore_atomic.h>
 
+// the count and the number of waiting threads are updated atomically; the lock and condition are
+// only used when threads are waiting for the count to reach zero or when the counter is deleted
 struct qore_counter_private {
       enum cond_status_e { Cond_Deleted = -1 };
 
       QoreThreadLock l;
       QoreCondition cond;
-      int cnt;
-      int waiting;
-      
+      volatile int cnt;
+      volatile int waiting;
+
       DLLLOCAL qore_counter_private(int nc) : cnt(nc), waiting(0) {
 	 assert(nc >= 0);
       }
@@ -46,46 +49,72 @@ struct qore_counter_private {
       DLLLOCAL ~qore_counter_private() {
       }
 
+      // wakes up waiting threads after the count has reached zero
+      DLLLOCAL void wakeup() {
+	 // the atomic update of the count is a full barrier, and waiting threads increment "waiting"
+	 // atomically before checking the count, so at least one side always sees the other
+	 if (qore_atomic_get(&waiting)) {
+	    AutoLocker al(&l);
+	    cond.broadcast();
+	 }
+      }
+
       DLLLOCAL void destructor(ExceptionSink* xsink) {
 	 AutoLocker al(&l);
 	 //printd(5, "qore_counter_private::destructor() this: %p waiting: %d cnt: %d\n", this, waiting, cnt);
-	 assert(cnt != Cond_Deleted);
-	 cnt = Cond_Deleted;
-	 if (waiting) {
+	 while (true) {
+	    int c = cnt;
+	    assert(c != Cond_Deleted);
+	    if (qore_atomic_cas(&cnt, c, (int)Cond_Deleted))
+	       break;
+	 }
+	 int w = qore_atomic_get(&waiting);
+	 if (w) {
 	    xsink->raiseException("COUNTER-ERROR", "Counter deleted while there %s %d waiting thread%s",
-				  waiting == 1 ? "is" : "are", waiting, waiting == 1 ? "" : "s");
+				  w == 1 ? "is" : "are", w, w == 1 ? "" : "s");
 	    cond.broadcast();
 	 }
       }
 
       DLLLOCAL void inc() {
-	 AutoLocker al(&l);
-	 if (cnt >= 0)
-	    cnt++;
+	 while (true) {
+	    int c = cnt;
+	    if (c < 0 || qore_atomic_cas(&cnt, c, c + 1))
+	       return;
+	 }
       }
 
       DLLLOCAL void dec(ExceptionSink* xsink) {
-	 AutoLocker al(&l);
-	 if (cnt == Cond_Deleted) {
-	    xsink->raiseException("COUNTER-ERROR", "cannot execute Counter::dec(): Counter has been deleted in another thread");
-	    return;
+	 int c;
+	 while (true) {
+	    c = cnt;
+	    if (c == Cond_Deleted) {
+	       xsink->raiseException("COUNTER-ERROR", "cannot execute Counter::dec(): Counter has been deleted in another thread");
+	       return;
+	    }
+	    if (!c) {
+	       xsink->raiseException("COUNTER-ERROR", "cannot execute Counter::dec(): Counter is already at 0; you must call Counter::inc() once before every call to Counter::dec()");
+	       return;
+	    }
+	    if (qore_atomic_cas(&cnt, c, c - 1))
+	       break;
 	 }
-	 if (!cnt) {
-	    xsink->raiseException("COUNTER-ERROR", "cannot execute Counter::dec(): Counter is already at 0; you must call Counter::inc() once before every call to Counter::dec()");
-	    return;
-	 }
-	    
-	 if (!--cnt && waiting)
-	    cond.broadcast();
+
+	 if (c == 1)
+	    wakeup();
       }
 
       DLLLOCAL int waitForZero(ExceptionSink* xsink, int timeout_ms) {
+	 // return immediately without locking if the count is already zero
+	 if (!qore_atomic_get(&cnt))
+	    return 0;
+
 	 // NOTE that we do not do a while(true) { cond.wait(); } because any broadcast means that the
 	 // counter hit zero, so even it it's bigger than zero by the time we are allowed to execute, it's ok
 	 // --- synchronization must be done externally
 	 int rc = 0;
 	 SafeLocker sl(&l);
-	 ++waiting;
+	 qore_atomic_add(&waiting, 1);
 	 while (cnt && cnt != Cond_Deleted) {
 	    if (!timeout_ms)
 	       cond.wait(&l);
@@ -93,7 +122,7 @@ struct qore_counter_private {
 	       if ((rc = cond.wait(&l, timeout_ms)))
 		  break;
 	 }
-	 --waiting;
+	 qore_atomic_sub(&waiting, 1);
 	 if (cnt == Cond_Deleted) {
 	    xsink->raiseException("COUNTER-ERROR", "cannot execute Counter::waitForZero(); Counter was deleted in another thread while waiting %p", this);
 	    return -1;
@@ -103,16 +132,15 @@ struct qore_counter_private {
 
       DLLLOCAL void waitForZero() {
 	 AutoLocker al(&l);
-	 ++waiting;
+	 qore_atomic_add(&waiting, 1);
 	 while (cnt)
 	    cond.wait(&l);
-	 --waiting;
+	 qore_atomic_sub(&waiting, 1);
       }
 
       DLLLOCAL void dec() {
-	 AutoLocker al(&l);
-	 if (!--cnt && waiting)
-	    cond.broadcast();
+	 if (!qore_atomic_sub(&cnt, 1))
+	    wakeup();
       }
 };
 
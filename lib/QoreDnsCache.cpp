@@ -0,0 +1,258 @@
+/*
+  QoreDnsCache.cpp
+
+  Qore Programming Language
+
+  Copyright (C) 2005 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#include <qore/Qore.h>
+#include <qore/intern/QoreDnsCache.h>
+
+#include <stdio.h>
+#include <string.h>
+
+QoreDnsCache qore_dns_cache;
+
+std::string QoreDnsCache::getKey(const char* host, const char* service, int family, int type, int protocol) {
+   char buf[64];
+   snprintf(buf, sizeof buf, "/%d/%d/%d", family, type, protocol);
+   std::string key(host ? host : "");
+   key += ':';
+   key += service ? service : "";
+   key += buf;
+   return key;
+}
+
+// raises the same exception as QoreAddrInfo::getInfo()
+void QoreDnsCache::raiseError(ExceptionSink* xsink, const char* host, const char* service, int family, int status) {
+   if (xsink)
+      xsink->raiseException("QOREADDRINFO-GETINFO-ERROR", "getaddrinfo(node: '%s', service: '%s', address_family: %d='%s', flags: 0) error: %s", host ? host : "", service ? service : "", family, QoreAddrInfo::getFamilyName(family), gai_strerror(status));
+}
+
+// returns true if the getaddrinfo() error is a definitive answer that may be cached; temporary failures such as
+// EAI_AGAIN are never cached so that the next connection attempt makes a new lookup
+bool QoreDnsCache::isDefinitiveError(int status) {
+   switch (status) {
+      case EAI_NONAME:
+      case EAI_SERVICE:
+#ifdef EAI_NODATA
+      case EAI_NODATA:
+#endif
+#ifdef EAI_ADDRFAMILY
+      case EAI_ADDRFAMILY:
+#endif
+         return true;
+   }
+   return false;
+}
+
+void QoreDnsCache::interleave(dns_addr_list_t& addrs) {
+   if (addrs.size() < 3)
+      return;
+   int first = addrs[0].family;
+   dns_addr_list_t a, b;
+   for (dns_addr_list_t::iterator i = addrs.begin(), e = addrs.end(); i != e; ++i)
+      (i->family == first ? a : b).push_back(*i);
+   if (b.empty())
+      return;
+   addrs.clear();
+   for (size_t i = 0; i < a.size() || i < b.size(); ++i) {
+      if (i < a.size())
+         addrs.push_back(a[i]);
+      if (i < b.size())
+         addrs.push_back(b[i]);
+   }
+}
+
+void QoreDnsCache::prune(int64 now) {
+   for (dns_entry_map_t::iterator i = emap.begin(), e = emap.end(); i != e;) {
+      if (i->second.expires <= now)
+         emap.erase(i++);
+      else
+         ++i;
+   }
+   if (emap.size() < max_entries)
+      return;
+   dns_entry_map_t::iterator victim = emap.begin();
+   for (dns_entry_map_t::iterator i = emap.begin(), e = emap.end(); i != e; ++i)
+      if (i->second.hits < victim->second.hits)
+         victim = i;
+   emap.erase(victim);
+}
+
+int QoreDnsCache::lookup(ExceptionSink* xsink, const char* host, const char* service, int family, int type, int protocol, dns_addr_list_t& rv) {
+   std::string key;
+   int64 now = 0;
+   {
+      AutoLocker al(l);
+      if (ttl) {
+         key = getKey(host, service, family, type, protocol);
+         now = q_clock_getmillis();
+         dns_entry_map_t::iterator i = emap.find(key);
+         if (i != emap.end()) {
+            if (i->second.expires > now) {
+               ++i->second.hits;
+               if (!i->second.status) {
+                  ++hits;
+                  rv = i->second.addrs;
+                  return 0;
+               }
+               ++negative_hits;
+               raiseError(xsink, host, service, family, i->second.status);
+               return -1;
+            }
+            emap.erase(i);
+         }
+         ++misses;
+      }
+   }
+
+   // the lookup is made without holding the lock
+   struct addrinfo hints;
+   memset(&hints, 0, sizeof hints);
+   hints.ai_family = family;
+   hints.ai_socktype = type;
+   hints.ai_protocol = protocol;
+
+   struct addrinfo* ai = 0;
+   int status = getaddrinfo(host, service, &hints, &ai);
+   if (!status) {
+      for (struct addrinfo* p = ai; p; p = p->ai_next) {
+         if (p->ai_addrlen > sizeof(struct sockaddr_storage))
+            continue;
+         QoreDnsAddr a;
+         memcpy(&a.addr, p->ai_addr, p->ai_addrlen);
+         a.addrlen = p->ai_addrlen;
+         a.family = p->ai_family;
+         a.socktype = p->ai_socktype;
+         a.protocol = p->ai_protocol;
+         rv.push_back(a);
+      }
+      freeaddrinfo(ai);
+   }
+
+   if (!key.empty()) {
+      AutoLocker al(l);
+      // the cache may have been disabled or reconfigured in the meantime
+      if (ttl && (status ? (negative_ttl && isDefinitiveError(status)) : 1)) {
+         if (emap.size() >= max_entries)
+            prune(now);
+         QoreDnsEntry& e = emap[key];
+         e.host = host ? host : "";
+         e.service = service ? service : "";
+         e.status = status;
+         e.expires = now + (status ? negative_ttl : ttl);
+         e.hits = 0;
+         if (!status) {
+            e.addrs = rv;
+            interleave(e.addrs);
+            rv = e.addrs;
+         }
+      }
+   }
+
+   if (status) {
+      raiseError(xsink, host, service, family, status);
+      return -1;
+   }
+   return 0;
+}
+
+void QoreDnsCache::reportFailure(const char* host, const char* service, int family, int type, int protocol, const struct sockaddr* addr, size_t addrlen) {
+   AutoLocker al(l);
+   if (!ttl)
+      return;
+   dns_entry_map_t::iterator i = emap.find(getKey(host, service, family, type, protocol));
+   if (i == emap.end())
+      return;
+   dns_addr_list_t& addrs = i->second.addrs;
+   for (dns_addr_list_t::iterator ai = addrs.begin(), e = addrs.end(); ai != e; ++ai) {
+      if (ai->addrlen == addrlen && !memcmp(&ai->addr, addr, addrlen)) {
+         QoreDnsAddr a = *ai;
+         addrs.erase(ai);
+         addrs.push_back(a);
+         break;
+      }
+   }
+}
+
+void QoreDnsCache::set(int64 n_ttl, int64 n_negative_ttl, size_t n_max_entries) {
+   AutoLocker al(l);
+   ttl = n_ttl;
+   negative_ttl = n_negative_ttl;
+   max_entries = n_max_entries;
+   if (!ttl)
+      emap.clear();
+   else if (emap.size() > max_entries) {
+      int64 now = q_clock_getmillis();
+      while (emap.size() > max_entries)
+         prune(now);
+   }
+}
+
+void QoreDnsCache::clear() {
+   AutoLocker al(l);
+   emap.clear();
+}
+
+QoreHashNode* QoreDnsCache::getInfo() const {
+   QoreHashNode* h = new QoreHashNode;
+   QoreListNode* l = new QoreListNode;
+
+   AutoLocker al(this->l);
+   int64 now = q_clock_getmillis();
+   h->setKeyValue("ttl", new QoreBigIntNode(ttl), 0);
+   h->setKeyValue("negative_ttl", new QoreBigIntNode(negative_ttl), 0);
+   h->setKeyValue("max_entries", new QoreBigIntNode(max_entries), 0);
+   h->setKeyValue("hits", new QoreBigIntNode(hits), 0);
+   h->setKeyValue("negative_hits", new QoreBigIntNode(negative_hits), 0);
+   h->setKeyValue("misses", new QoreBigIntNode(misses), 0);
+
+   for (dns_entry_map_t::const_iterator i = emap.begin(), e = emap.end(); i != e; ++i) {
+      if (i->second.expires <= now)
+         continue;
+      QoreHashNode* eh = new QoreHashNode;
+      eh->setKeyValue("host", new QoreStringNode(i->second.host), 0);
+      if (!i->second.service.empty())
+         eh->setKeyValue("service", new QoreStringNode(i->second.service), 0);
+      eh->setKeyValue("expires_ms", new QoreBigIntNode(i->second.expires - now), 0);
+      eh->setKeyValue("hits", new QoreBigIntNode(i->second.hits), 0);
+      if (i->second.status)
+         eh->setKeyValue("error", new QoreStringNode(gai_strerror(i->second.status)), 0);
+      else {
+         QoreListNode* al = new QoreListNode;
+         for (dns_addr_list_t::const_iterator ai = i->second.addrs.begin(), ae = i->second.addrs.end(); ai != ae; ++ai) {
+            QoreStringNode* str = q_addr_to_string2((const struct sockaddr*)&ai->addr);
+            if (str)
+               al->push(str);
+         }
+         eh->setKeyValue("addresses", al, 0);
+      }
+      l->push(eh);
+   }
+   h->setKeyValue("entries", l, 0);
+   return h;
+}
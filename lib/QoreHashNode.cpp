@@ -35,6 +35,7 @@
 #include <qore/intern/QoreNamespaceIntern.h>
 #include <qore/intern/ParserSupport.h>
 #include <qore/intern/qore_program_private.h>
+#include <qore/intern/qore_thread_intern.h>
 
 #include <string.h>
 #include <strings.h>
@@ -403,6 +404,16 @@ AbstractQoreNode** QoreHashNode::getExistingValuePtr(const char* key) {
 }
 
 bool QoreHashNode::derefImpl(ExceptionSink* xsink) {
+   // large hashes without objects are freed by the background reclaimer if enabled
+   if (qore_deferred_free_min && !priv->obj_count && qore_check_deferred_free(this, priv->size())) {
+      QoreHashNode* h = new QoreHashNode;
+      h->priv->swap(*priv);
+      if (qore_deferred_free(h))
+         return true;
+      // the reclaimer is not available; free the members here
+      priv->swap(*h->priv);
+      h->deref(xsink);
+   }
    return priv->derefImpl(xsink);
 }
 
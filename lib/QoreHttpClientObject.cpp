@@ -41,10 +41,12 @@
 #include <qore/intern/QC_Socket.h>
 #include <qore/intern/QC_Queue.h>
 #include <qore/intern/QoreHttpClientObjectIntern.h>
+#include <qore/intern/ql_compression.h>
 
 #include <qore/intern/qore_socket_private.h>
 
 #include <string>
+#include <memory>
 #include <map>
 #include <set>
 
@@ -53,6 +55,93 @@
 method_map_t method_map;
 strcase_set_t header_ignore;
 
+// passes message body data to a receive callback or writes it to a file as it is read from the socket, decompressing it first if required
+class QoreHttpClientBodySink : public AbstractHttpBodySink, public AbstractDecompressorOutput {
+protected:
+   qore_socket_private& sock;
+   const char* mname;
+   const ResolvedCallReferenceNode* recv_callback;
+   QoreThreadLock* l;
+   QoreFile* file;
+   const QoreEncoding* enc;
+   std::auto_ptr<QoreStreamDecompressor> dec;
+   // the bytes of an incomplete multi-byte character at the end of the last block passed to the callback as a string
+   std::string partial;
+   // content-encoded data is passed to the callback as binary data, otherwise as strings
+   bool binary,
+      chunked;
+
+   DLLLOCAL int runCallback(AbstractQoreNode* d, ExceptionSink* xsink) {
+      ReferenceHolder<AbstractQoreNode> holder(d, xsink);
+      return sock.runDataCallback(xsink, mname, *recv_callback, l, d, chunked) ? -1 : 0;
+   }
+
+public:
+   DLLLOCAL QoreHttpClientBodySink(qore_socket_private& s, const char* m, const ResolvedCallReferenceNode* rcb, QoreThreadLock* lck, QoreFile* f, const QoreEncoding* e, bool bin) : sock(s), mname(m), recv_callback(rcb), l(lck), file(f), enc(e), binary(bin), chunked(false) {
+   }
+
+   DLLLOCAL void setDecompressor(QoreStreamDecompressor* d) {
+      dec.reset(d);
+   }
+
+   DLLLOCAL bool decompress() const {
+      return dec.get();
+   }
+
+   DLLLOCAL virtual int data(const void* ptr, size_t len, bool n_chunked, ExceptionSink* xsink) {
+      chunked = n_chunked;
+      return dec.get() ? dec->decompress(ptr, len, *this, xsink) : output(ptr, len, xsink);
+   }
+
+   DLLLOCAL virtual int output(const void* ptr, size_t len, ExceptionSink* xsink) {
+      if (file)
+         return file->write(ptr, len, xsink) < 0 ? -1 : 0;
+
+      assert(recv_callback);
+      if (binary) {
+         BinaryNode* b = new BinaryNode;
+         b->append(ptr, len);
+         return runCallback(b, xsink);
+      }
+
+      if (!enc->isMultiByte())
+         return runCallback(new QoreStringNode((const char*)ptr, len, enc), xsink);
+
+      // strings are only split on character boundaries; an incomplete character at the end of the block is
+      // passed with the next block
+      partial.append((const char*)ptr, len);
+      const char* p = partial.data();
+      const char* end = p + partial.size();
+      while (p < end) {
+         qore_offset_t cl = (qore_offset_t)enc->getCharLen(p, end - p);
+         // invalid characters are passed as-is
+         if (!cl)
+            cl = 1;
+         else if (cl < 0)
+            break;
+         p += cl;
+      }
+      size_t clen = p - partial.data();
+      if (!clen)
+         return 0;
+      QoreStringNode* str = new QoreStringNode(partial.data(), clen, enc);
+      partial.erase(0, clen);
+      return runCallback(str, xsink);
+   }
+
+   // checks that the compressed stream is complete after the entire body has been read and passes any remaining
+   // bytes to the callback
+   DLLLOCAL int finish(ExceptionSink* xsink) {
+      if (dec.get() && dec->finish(xsink))
+         return -1;
+      if (partial.empty())
+         return 0;
+      QoreStringNode* str = new QoreStringNode(partial.data(), partial.size(), enc);
+      partial.clear();
+      return runCallback(str, xsink);
+   }
+};
+
 struct qore_httpclient_priv {
    my_socket_priv* msock;
 
@@ -64,7 +153,9 @@ struct qore_httpclient_priv {
    bool connected, 
       nodelay, 
       proxy_connected, // means that a CONNECT message has been processed and the connection is now made as if it were directly with the client
-      persistent;      // turns off implicit connections for the current connection only
+      persistent,      // turns off implicit connections for the current connection only
+      recv_decompress, // decompress content-encoded message bodies before passing them to receive callbacks
+      recv_stream;     // pass non-chunked message bodies to receive callbacks in blocks as they are read
    int default_port, max_redirects;
    std::string default_path;
    int timeout;
@@ -77,7 +168,7 @@ struct qore_httpclient_priv {
    DLLLOCAL qore_httpclient_priv(my_socket_priv* ms) :
       msock(ms), http11(true), connection(HTTPCLIENT_DEFAULT_PORT),
       connected(false), nodelay(false), proxy_connected(false),
-      persistent(false),
+      persistent(false), recv_decompress(false), recv_stream(false),
       default_port(HTTPCLIENT_DEFAULT_PORT), 
       max_redirects(HTTPCLIENT_DEFAULT_MAX_REDIRECTS),
       timeout(HTTPCLIENT_DEFAULT_TIMEOUT),
@@ -172,6 +263,24 @@ struct qore_httpclient_priv {
       return nodelay;
    }
 
+   DLLLOCAL void setRecvDecompression(bool b) {
+      AutoLocker al(msock->m);
+      recv_decompress = b;
+   }
+
+   DLLLOCAL bool getRecvDecompression() const {
+      return recv_decompress;
+   }
+
+   DLLLOCAL void setRecvStreaming(bool b) {
+      AutoLocker al(msock->m);
+      recv_stream = b;
+   }
+
+   DLLLOCAL bool getRecvStreaming() const {
+      return recv_stream;
+   }
+
    DLLLOCAL void setPersistent(ExceptionSink* xsink) {
       AutoLocker al(msock->m);
       
@@ -342,7 +451,7 @@ struct qore_httpclient_priv {
       return (const char*)pstr.getBuffer();
    }   
 
-   DLLLOCAL QoreHashNode* send_internal(ExceptionSink* xsink, const char* mname, const char* meth, const char* mpath, const QoreHashNode* headers, const void* data, unsigned size, const ResolvedCallReferenceNode* send_callback, bool getbody, QoreHashNode* info, int timeout_ms, const ResolvedCallReferenceNode* recv_callback = 0, QoreObject* obj = 0);
+   DLLLOCAL QoreHashNode* send_internal(ExceptionSink* xsink, const char* mname, const char* meth, const char* mpath, const QoreHashNode* headers, const void* data, unsigned size, const ResolvedCallReferenceNode* send_callback, bool getbody, QoreHashNode* info, int timeout_ms, const ResolvedCallReferenceNode* recv_callback = 0, QoreObject* obj = 0, QoreFile* file = 0);
 
    DLLLOCAL void addProxyAuthorization(const QoreHashNode* headers, QoreHashNode& h, ExceptionSink* xsink) {
       if (proxy_connection.username.empty())
@@ -795,7 +904,7 @@ static const char* get_string_header(ExceptionSink* xsink, QoreHashNode& h, cons
    return str && !str->empty() ? str->getBuffer() : 0;
 }
 
-QoreHashNode* qore_httpclient_priv::send_internal(ExceptionSink* xsink, const char* mname, const char* meth, const char* mpath, const QoreHashNode* headers, const void* data, unsigned size, const ResolvedCallReferenceNode* send_callback, bool getbody, QoreHashNode* info, int timeout_ms, const ResolvedCallReferenceNode* recv_callback, QoreObject* obj) {
+QoreHashNode* qore_httpclient_priv::send_internal(ExceptionSink* xsink, const char* mname, const char* meth, const char* mpath, const QoreHashNode* headers, const void* data, unsigned size, const ResolvedCallReferenceNode* send_callback, bool getbody, QoreHashNode* info, int timeout_ms, const ResolvedCallReferenceNode* recv_callback, QoreObject* obj, QoreFile* file) {
    assert(!(data && send_callback));
 
    // check if method is valid
@@ -1137,6 +1246,10 @@ QoreHashNode* qore_httpclient_priv::send_internal(ExceptionSink* xsink, const ch
 
    // code >= 300 && < 400 is already handled above
    if (bodyp && (code < 100 || code >= 200) && code != 204) {
+      // error responses are never written to the target file but are processed as with send()
+      if (file && (code < 200 || code >= 300))
+	 file = 0;
+
       // see if we should do a binary or string read
       content_encoding = get_string_header(xsink, **ans, "content-encoding");
       if (*xsink) {
@@ -1150,8 +1263,8 @@ QoreHashNode* qore_httpclient_priv::send_internal(ExceptionSink* xsink, const ch
 	    msock->socket->setEncoding(QEM.findCreate(content_encoding));
 	    content_encoding = 0;
 	 }
-	 else if (!recv_callback) {
-	    // only decode message bodies automatically if there is no receive callback
+	 else if (!recv_callback && !file) {
+	    // only decode message bodies automatically if there is no receive callback or target file
 	    if (!strcasecmp(content_encoding, "deflate") || !strcasecmp(content_encoding, "x-deflate"))
 	       dec = qore_inflate_to_string;
 	    else if (!strcasecmp(content_encoding, "gzip") || !strcasecmp(content_encoding, "x-gzip"))
@@ -1178,11 +1291,37 @@ QoreHashNode* qore_httpclient_priv::send_internal(ExceptionSink* xsink, const ch
       if (cl && cb_queue)
 	 do_content_length_event(cb_queue, msock->socket->getObjectIDForEvents(), len);
 
+      // target files and receive callbacks with streaming or decompression enabled get the body in blocks as it
+      // is read, so the entire body is never held in memory
+      QoreHttpClientBodySink sink(*msock->socket->priv, mname, recv_callback, &msock->m, file, msock->socket->getEncoding(), (bool)content_encoding);
+      if (content_encoding && (file || (recv_callback && recv_decompress))) {
+	 QoreStreamDecompressor* d = QoreStreamDecompressor::getForContentEncoding(content_encoding, xsink);
+	 if (d)
+	    sink.setDecompressor(d);
+	 else if (*xsink || file) {
+	    if (!*xsink)
+	       xsink->raiseException("HTTP-CLIENT-RECEIVE-ERROR", "don't know how to handle content-encoding '%s'", content_encoding);
+	    disconnect_unlocked();
+	    return 0;
+	 }
+	 // unsupported content encodings are passed to receive callbacks as-is
+      }
+
       if (te && !strcasecmp(te, "chunked")) { // check for chunked response body
 	 if (cb_queue)
 	    do_event(cb_queue, msock->socket->getObjectIDForEvents(), QORE_EVENT_HTTP_CHUNKED_START);
 	 ReferenceHolder<QoreHashNode> nah(xsink);
-	 if (recv_callback) {
+	 if (file || sink.decompress()) {
+	    nah = msock->socket->priv->readHttpChunkedBodyBinary(timeout_ms, xsink, QORE_SOURCE_HTTPCLIENT, recv_callback, &msock->m, obj, &sink);
+	    if (!*xsink)
+	       sink.finish(xsink);
+	    // the rest of the body cannot be read after an error
+	    if (*xsink) {
+	       disconnect_unlocked();
+	       return 0;
+	    }
+	 }
+	 else if (recv_callback) {
 	    if (content_encoding)
 	       msock->socket->priv->readHttpChunkedBodyBinary(timeout_ms, xsink, QORE_SOURCE_HTTPCLIENT, recv_callback, &msock->m, obj);
 	    else
@@ -1215,7 +1354,18 @@ QoreHashNode* qore_httpclient_priv::send_internal(ExceptionSink* xsink, const ch
 	 }
       }
       else if (getbody || len) {
-	 if (content_encoding) {
+	 // other receive callbacks get non-chunked bodies in one call after the body has been read in full
+	 if (file || sink.decompress() || (recv_callback && recv_stream)) {
+	    // without a content-length header the body is terminated by the server closing the connection
+	    // "len" cannot hold the length of bodies over 2GB
+	    if (msock->socket->priv->readHttpBody(xsink, mname, cl ? strtoll(cl, 0, 10) : -1, timeout_ms, sink) || sink.finish(xsink)) {
+	       disconnect_unlocked();
+	       return 0;
+	    }
+	    if (recv_callback && msock->socket->priv->runHeaderCallback(xsink, mname, *recv_callback, &msock->m, 0, send_aborted, obj))
+	       return 0;
+	 }
+	 else if (content_encoding) {
 	    SimpleRefHolder<BinaryNode> bobj(msock->socket->recvBinary(len, timeout_ms, xsink));
 	    if (!(*xsink) && bobj)
 	       body = bobj.release();
@@ -1305,6 +1455,11 @@ void QoreHttpClientObject::sendWithRecvCallback(const char* meth, const char* mp
    http_priv->send_internal(xsink, "sendWithRecvCallback", meth, mpath, headers, data, size, 0, getbody, info, timeout_ms, recv_callback, obj);
 }
 
+QoreHashNode* QoreHttpClientObject::sendToFile(const char* meth, const char* mpath, const QoreHashNode* headers, const void* data, unsigned size, QoreFile* file, QoreHashNode* info, int timeout_ms, ExceptionSink* xsink) {
+   assert(file);
+   return http_priv->send_internal(xsink, "sendToFile", meth, mpath, headers, data, size, 0, true, info, timeout_ms, 0, 0, file);
+}
+
 void QoreHttpClientObject::sendWithCallbacks(const char* meth, const char* mpath, const QoreHashNode* headers, const ResolvedCallReferenceNode* send_callback, bool getbody, QoreHashNode* info, int timeout_ms, const ResolvedCallReferenceNode* recv_callback, QoreObject* obj, ExceptionSink* xsink) {
    http_priv->send_internal(xsink, "sendWithCallbacks", meth, mpath, headers, 0, 0, send_callback, getbody, info, timeout_ms, recv_callback, obj);
 }
@@ -1373,6 +1528,22 @@ bool QoreHttpClientObject::getNoDelay() const {
    return http_priv->getNoDelay();
 }
 
+void QoreHttpClientObject::setRecvDecompression(bool b) {
+   http_priv->setRecvDecompression(b);
+}
+
+bool QoreHttpClientObject::getRecvDecompression() const {
+   return http_priv->getRecvDecompression();
+}
+
+void QoreHttpClientObject::setRecvStreaming(bool b) {
+   http_priv->setRecvStreaming(b);
+}
+
+bool QoreHttpClientObject::getRecvStreaming() const {
+   return http_priv->getRecvStreaming();
+}
+
 bool QoreHttpClientObject::isConnected() const {
    return http_priv->connected;
 }
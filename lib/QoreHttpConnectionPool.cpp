@@ -0,0 +1,362 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#include <qore/Qore.h>
+#include <qore/intern/QoreHttpConnectionPool.h>
+
+#include <string.h>
+
+// splits the URL into the base URL identifying the connection (scheme://[user:pass@]host[:port]) and the path
+static int http_pool_split_url(const char* url, std::string& base, const char*& path, ExceptionSink* xsink) {
+   const char* p = strstr(url, "://");
+   if (!p || p == url || !p[3] || p[3] == '/') {
+      xsink->raiseException("HTTP-CONNECTION-POOL-URL-ERROR", "URL '%s' does not have the format scheme://host[:port][/path]", url);
+      return -1;
+   }
+   const char* s = strchr(p + 3, '/');
+   base.assign(url, s ? s - url : strlen(url));
+   path = s ? s : "/";
+   return 0;
+}
+
+// acquires a pooled connection for the given URL and returns it to the pool when it goes out of scope
+class QoreHttpPoolConnHelper {
+protected:
+   QoreHttpConnectionPool& pool;
+   std::string base;
+   const char* path;
+   QoreHttpPoolHost* host;
+   QoreHttpClientObject* client;
+   ExceptionSink* xsink;
+
+public:
+   DLLLOCAL QoreHttpPoolConnHelper(QoreHttpConnectionPool& p, const char* url, ExceptionSink* xs) : pool(p), path(0), host(0), client(0), xsink(xs) {
+      if (!http_pool_split_url(url, base, path, xsink))
+         client = pool.acquire(base, host, xsink);
+   }
+
+   DLLLOCAL ~QoreHttpPoolConnHelper() {
+      if (client)
+         pool.release(base, host, client, xsink);
+   }
+
+   DLLLOCAL operator bool() const {
+      return client;
+   }
+
+   DLLLOCAL QoreHttpClientObject* operator->() {
+      return client;
+   }
+
+   DLLLOCAL const char* getPath() const {
+      return path;
+   }
+};
+
+QoreHttpConnectionPool::QoreHttpConnectionPool(unsigned n_max_connections, unsigned n_max_idle, unsigned n_min_idle, int64 n_idle_timeout, int64 n_wait_timeout, QoreHashNode* opts)
+   : client_opts(opts), max_connections(n_max_connections), max_idle(n_max_idle), min_idle(n_min_idle), idle_timeout(n_idle_timeout), wait_timeout(n_wait_timeout) {
+}
+
+QoreHttpConnectionPool::~QoreHttpConnectionPool() {
+   assert(!client_opts);
+   for (http_pool_host_map_t::iterator i = hmap.begin(), e = hmap.end(); i != e; ++i) {
+      assert(!i->second->busy);
+      assert(i->second->idle.empty());
+      delete i->second;
+   }
+}
+
+void QoreHttpConnectionPool::deref(ExceptionSink* xsink) {
+   if (ROdereference()) {
+      clear(xsink);
+      if (client_opts) {
+         client_opts->deref(xsink);
+         client_opts = 0;
+      }
+      delete this;
+   }
+}
+
+void QoreHttpConnectionPool::pruneIdle(QoreHttpPoolHost& h, int64 now, http_pool_client_vec_t& del) {
+   if (!idle_timeout)
+      return;
+   // the least recently used connections are at the front
+   while (h.idle.size() > min_idle && now - h.idle.front().last_used >= idle_timeout) {
+      del.push_back(h.idle.front().client);
+      h.idle.pop_front();
+      ++h.closed;
+   }
+}
+
+void QoreHttpConnectionPool::pruneAllIdle(int64 now, http_pool_client_vec_t& del) {
+   for (http_pool_host_map_t::iterator i = hmap.begin(), e = hmap.end(); i != e; ++i)
+      pruneIdle(*i->second, now, del);
+}
+
+void QoreHttpConnectionPool::derefClients(http_pool_client_vec_t& del, ExceptionSink* xsink) {
+   for (http_pool_client_vec_t::iterator i = del.begin(), e = del.end(); i != e; ++i)
+      (*i)->deref(xsink);
+}
+
+QoreHttpClientObject* QoreHttpConnectionPool::acquire(const std::string& base, QoreHttpPoolHost*& host, ExceptionSink* xsink) {
+   http_pool_client_vec_t del;
+   QoreHttpClientObject* client = 0;
+   bool timeout = false;
+   {
+      AutoLocker al(l);
+      http_pool_host_map_t::iterator i = hmap.find(base);
+      if (i == hmap.end())
+         i = hmap.insert(http_pool_host_map_t::value_type(base, new QoreHttpPoolHost)).first;
+      host = i->second;
+      QoreHttpPoolHost& h = *host;
+      ++h.requests;
+
+      int64 start = q_clock_getmillis();
+      // idle connections are closed by the thread that uses the pool after they expire; this also closes
+      // idle connections to servers that are no longer requested
+      pruneAllIdle(start, del);
+      bool waited = false;
+      while (true) {
+         if (!h.idle.empty()) {
+            client = h.idle.back().client;
+            h.idle.pop_back();
+            ++h.busy;
+            ++h.reused;
+            break;
+         }
+         // reserve a slot for a new connection, which is created without holding the lock
+         if (h.busy < max_connections) {
+            ++h.busy;
+            break;
+         }
+
+         if (!waited) {
+            ++h.waits;
+            waited = true;
+         }
+         ++h.waiting;
+         if (wait_timeout < 0)
+            h.cond.wait(l);
+         else {
+            int64 to = wait_timeout - (q_clock_getmillis() - start);
+            if (to <= 0 || h.cond.wait2(l, to)) {
+               --h.waiting;
+               // check for a connection returned just before the timeout
+               if (!h.idle.empty() || h.busy < max_connections)
+                  continue;
+               ++h.timeouts;
+               timeout = true;
+               break;
+            }
+         }
+         --h.waiting;
+      }
+   }
+   derefClients(del, xsink);
+
+   if (timeout) {
+      xsink->raiseException("HTTP-CONNECTION-POOL-TIMEOUT", "timed out after " QLLD " ms waiting for a connection to '%s'; all %u connections are in use", wait_timeout, base.c_str(), max_connections);
+      return 0;
+   }
+
+   if (client) {
+      // a connection that has data available while idle has been closed by the server or has unread data
+      // from a previous response; it is reconnected implicitly with the next request
+      ExceptionSink txsink;
+      if (client->isDataAvailable(&txsink, 0) || txsink) {
+         txsink.clear();
+         client->disconnect();
+      }
+      return client;
+   }
+
+   client = newClient(base, host, xsink);
+   if (!client) {
+      // release the reserved slot
+      AutoLocker al(l);
+      --host->busy;
+      if (host->waiting)
+         host->cond.signal();
+   }
+   return client;
+}
+
+QoreHttpClientObject* QoreHttpConnectionPool::newClient(const std::string& base, QoreHttpPoolHost* host, ExceptionSink* xsink) {
+   ReferenceHolder<QoreHttpClientObject> c(new QoreHttpClientObject, xsink);
+   if ((client_opts && c->setOptions(client_opts, xsink)) || c->setURL(base.c_str(), xsink))
+      return 0;
+
+   SimpleRefHolder<QoreStringNode> url(c->getURL());
+   AutoLocker al(l);
+   ++host->created;
+   if (host->url.empty() && url)
+      host->url = url->getBuffer();
+   return c.release();
+}
+
+void QoreHttpConnectionPool::fillIdle(const std::string& base, QoreHttpPoolHost* host) {
+   while (true) {
+      {
+         AutoLocker al(l);
+         if (host->idle.size() + host->filling >= min_idle || host->busy + host->idle.size() >= max_connections)
+            return;
+         // reserve a slot for the new connection
+         ++host->busy;
+         ++host->filling;
+      }
+
+      // errors are not raised here, because the request that returned the connection succeeded; they are raised
+      // by the next request that needs a new connection to the server
+      ExceptionSink xsink;
+      QoreHttpClientObject* client = newClient(base, host, &xsink);
+      bool failed = client && client->connect(&xsink);
+      if (failed) {
+         client->deref(&xsink);
+         client = 0;
+      }
+      xsink.clear();
+
+      AutoLocker al(l);
+      --host->busy;
+      --host->filling;
+      if (failed)
+         ++host->closed;
+      if (client)
+         host->idle.push_back(QoreHttpPoolConn(client, q_clock_getmillis()));
+      if (host->waiting)
+         host->cond.signal();
+      if (!client)
+         return;
+   }
+}
+
+void QoreHttpConnectionPool::release(const std::string& base, QoreHttpPoolHost* host, QoreHttpClientObject* client, ExceptionSink* xsink) {
+   // connections are not reused after errors, because the state of the connection is unknown, or after
+   // redirects, which change the URL of the connection
+   bool reuse = !*xsink && client->isConnected();
+   if (reuse) {
+      SimpleRefHolder<QoreStringNode> url(client->getURL());
+      reuse = url && host->url == url->getBuffer();
+   }
+
+   http_pool_client_vec_t del;
+   {
+      AutoLocker al(l);
+      assert(host->busy);
+      --host->busy;
+      int64 now = q_clock_getmillis();
+      if (reuse && host->idle.size() < max_idle) {
+         host->idle.push_back(QoreHttpPoolConn(client, now));
+         client = 0;
+      }
+      else
+         ++host->closed;
+      pruneAllIdle(now, del);
+      if (host->waiting)
+         host->cond.signal();
+   }
+
+   if (client) {
+      client->disconnect();
+      client->deref(xsink);
+   }
+   derefClients(del, xsink);
+
+   // idle connections are not created after a failed request, because the server may be unavailable
+   if (min_idle && !*xsink)
+      fillIdle(base, host);
+}
+
+QoreHashNode* QoreHttpConnectionPool::send(const char* meth, const char* url, const QoreHashNode* headers, const void* data, unsigned size, bool getbody, QoreHashNode* info, ExceptionSink* xsink) {
+   QoreHttpPoolConnHelper ch(*this, url, xsink);
+   if (!ch)
+      return 0;
+   return ch->send(meth, ch.getPath(), headers, data, size, getbody, info, xsink);
+}
+
+AbstractQoreNode* QoreHttpConnectionPool::get(const char* url, const QoreHashNode* headers, QoreHashNode* info, ExceptionSink* xsink) {
+   QoreHttpPoolConnHelper ch(*this, url, xsink);
+   if (!ch)
+      return 0;
+   return ch->get(ch.getPath(), headers, info, xsink);
+}
+
+QoreHashNode* QoreHttpConnectionPool::head(const char* url, const QoreHashNode* headers, QoreHashNode* info, ExceptionSink* xsink) {
+   QoreHttpPoolConnHelper ch(*this, url, xsink);
+   if (!ch)
+      return 0;
+   return ch->head(ch.getPath(), headers, info, xsink);
+}
+
+AbstractQoreNode* QoreHttpConnectionPool::post(const char* url, const QoreHashNode* headers, const void* data, unsigned size, QoreHashNode* info, ExceptionSink* xsink) {
+   QoreHttpPoolConnHelper ch(*this, url, xsink);
+   if (!ch)
+      return 0;
+   return ch->post(ch.getPath(), headers, data, size, info, xsink);
+}
+
+void QoreHttpConnectionPool::clear(ExceptionSink* xsink) {
+   http_pool_client_vec_t del;
+   {
+      AutoLocker al(l);
+      for (http_pool_host_map_t::iterator i = hmap.begin(), e = hmap.end(); i != e; ++i) {
+         QoreHttpPoolHost& h = *i->second;
+         for (http_pool_conn_list_t::iterator ci = h.idle.begin(), ce = h.idle.end(); ci != ce; ++ci)
+            del.push_back(ci->client);
+         h.closed += h.idle.size();
+         h.idle.clear();
+      }
+   }
+   derefClients(del, xsink);
+}
+
+QoreHashNode* QoreHttpConnectionPool::getStats(ExceptionSink* xsink) {
+   http_pool_client_vec_t del;
+   QoreHashNode* rv = new QoreHashNode;
+   {
+      AutoLocker al(l);
+      pruneAllIdle(q_clock_getmillis(), del);
+      for (http_pool_host_map_t::iterator i = hmap.begin(), e = hmap.end(); i != e; ++i) {
+         const QoreHttpPoolHost& h = *i->second;
+         QoreHashNode* hh = new QoreHashNode;
+         hh->setKeyValue("busy", new QoreBigIntNode(h.busy), 0);
+         hh->setKeyValue("idle", new QoreBigIntNode(h.idle.size()), 0);
+         hh->setKeyValue("waiting", new QoreBigIntNode(h.waiting), 0);
+         hh->setKeyValue("requests", new QoreBigIntNode(h.requests), 0);
+         hh->setKeyValue("created", new QoreBigIntNode(h.created), 0);
+         hh->setKeyValue("reused", new QoreBigIntNode(h.reused), 0);
+         hh->setKeyValue("closed", new QoreBigIntNode(h.closed), 0);
+         hh->setKeyValue("waits", new QoreBigIntNode(h.waits), 0);
+         hh->setKeyValue("timeouts", new QoreBigIntNode(h.timeouts), 0);
+         rv->setKeyValue(i->first.c_str(), hh, 0);
+      }
+   }
+   derefClients(del, xsink);
+   return rv;
+}
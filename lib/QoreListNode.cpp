@@ -30,6 +30,7 @@
 
 #include <qore/Qore.h>
 #include <qore/intern/qore_list_private.h>
+#include <qore/intern/qore_thread_intern.h>
 
 #include <stdlib.h>
 #include <string.h>
@@ -42,6 +43,9 @@
 #endif
 
 #include <algorithm>
+#include <vector>
+
+#include <unistd.h>
 
 #define LIST_BLOCK 20
 #define LIST_PAD   15
@@ -677,8 +681,233 @@ QoreListNode *QoreListNode::sortStable(const ResolvedCallReferenceNode *fr, Exce
    return rv.release();
 }
 
+// minimum number of elements sorted by each thread in a parallel sort
+#define QORE_PARALLEL_SORT_MIN 16384
+
+// stable merge sort of an array in several threads: each thread sorts a partition of the array, then
+// adjacent partitions are merged pairwise (also in parallel) until one sorted partition is left; no Qore
+// code is executed, so plain pthreads without thread entries are used
+template <typename T, typename C>
+class ParallelStableSort {
+protected:
+   struct Part {
+      ParallelStableSort* ps;
+      size_t start, mid, end;
+   };
+
+   T* data;
+   C cmp;
+
+   DLLLOCAL static void* sortThread(void* arg) {
+      Part* p = (Part*)arg;
+      std::stable_sort(p->ps->data + p->start, p->ps->data + p->end, p->ps->cmp);
+      return 0;
+   }
+
+   DLLLOCAL static void* mergeThread(void* arg) {
+      Part* p = (Part*)arg;
+      std::inplace_merge(p->ps->data + p->start, p->ps->data + p->mid, p->ps->data + p->end, p->ps->cmp);
+      return 0;
+   }
+
+   // runs f on all parts; the first part is processed in the calling thread, and parts are processed
+   // in the calling thread as well if no thread can be started
+   DLLLOCAL static void run(std::vector<Part>& parts, void* (*f)(void*)) {
+      std::vector<pthread_t> ptid(parts.size());
+      std::vector<bool> started(parts.size(), false);
+      for (size_t i = 1; i < parts.size(); ++i)
+         started[i] = !pthread_create(&ptid[i], ta_default.get_ptr(), f, &parts[i]);
+      f(&parts[0]);
+      for (size_t i = 1; i < parts.size(); ++i) {
+         if (started[i])
+            pthread_join(ptid[i], 0);
+         else
+            f(&parts[i]);
+      }
+   }
+
+public:
+   DLLLOCAL ParallelStableSort(T* d, C c) : data(d), cmp(c) {
+   }
+
+   DLLLOCAL void sort(size_t size, unsigned threads) {
+      if (threads > size / QORE_PARALLEL_SORT_MIN)
+         threads = size / QORE_PARALLEL_SORT_MIN;
+      if (threads <= 1) {
+         std::stable_sort(data, data + size, cmp);
+         return;
+      }
+
+      std::vector<Part> parts(threads);
+      for (unsigned i = 0; i < threads; ++i) {
+         parts[i].ps = this;
+         parts[i].start = size * i / threads;
+         parts[i].end = size * (i + 1) / threads;
+      }
+      run(parts, sortThread);
+
+      // merge adjacent sorted partitions; the earlier partition is always the left side of the merge to keep the sort stable
+      while (parts.size() > 1) {
+         std::vector<Part> merge, next;
+         for (size_t i = 0; i + 1 < parts.size(); i += 2) {
+            Part p = {this, parts[i].start, parts[i].end, parts[i + 1].end};
+            merge.push_back(p);
+            next.push_back(p);
+         }
+         run(merge, mergeThread);
+         if (parts.size() % 2)
+            next.push_back(parts.back());
+         parts.swap(next);
+      }
+   }
+};
+
+template <typename K>
+struct SortByEntry {
+   K key;
+   AbstractQoreNode* val;
+};
+
+template <typename K>
+struct SortByLess {
+   bool descending;
+
+   DLLLOCAL SortByLess(bool d) : descending(d) {
+   }
+
+   DLLLOCAL bool operator()(const SortByEntry<K>& l, const SortByEntry<K>& r) const {
+      return descending ? r.key < l.key : l.key < r.key;
+   }
+};
+
+struct SortByStrLess {
+   bool descending;
+
+   DLLLOCAL SortByStrLess(bool d) : descending(d) {
+   }
+
+   DLLLOCAL bool operator()(const SortByEntry<const char*>& l, const SortByEntry<const char*>& r) const {
+      return (descending ? strcmp(r.key, l.key) : strcmp(l.key, r.key)) < 0;
+   }
+};
+
+// compares keys of mixed types; elements with no key are sorted last in both orders; the first exception raised by
+// a comparison is kept in the caller's ExceptionSink, and all later comparisons return false without comparing the
+// keys so that the sort finishes immediately
+struct SortByNodeLess {
+   bool descending;
+   ExceptionSink* xsink;
+
+   DLLLOCAL SortByNodeLess(bool d, ExceptionSink* xs) : descending(d), xsink(xs) {
+   }
+
+   DLLLOCAL bool operator()(const SortByEntry<AbstractQoreNode*>& l, const SortByEntry<AbstractQoreNode*>& r) const {
+      if (*xsink || is_nothing(l.key))
+         return false;
+      if (is_nothing(r.key))
+         return true;
+      return descending
+         ? QoreLogicalLessThanOperatorNode::doLessThan(r.key, l.key, xsink)
+         : QoreLogicalLessThanOperatorNode::doLessThan(l.key, r.key, xsink);
+   }
+};
+
+template <typename K, typename C>
+static QoreListNode* sort_by_intern(std::vector<SortByEntry<K> >& v, C cmp, unsigned threads) {
+   if (!v.empty()) {
+      ParallelStableSort<SortByEntry<K>, C> ps(&v[0], cmp);
+      ps.sort(v.size(), threads);
+   }
+   QoreListNode* rv = new QoreListNode;
+   for (typename std::vector<SortByEntry<K> >::iterator i = v.begin(), e = v.end(); i != e; ++i)
+      rv->push(i->val ? i->val->refSelf() : 0);
+   return rv;
+}
+
+QoreListNode* QoreListNode::sortBy(const ResolvedCallReferenceNode* fr, bool descending, int max_threads, ExceptionSink* xsink) const {
+   // get the sort key of each element
+   ReferenceHolder<QoreListNode> keys(new QoreListNode, xsink);
+   bool all_int = true, all_num = true, all_str = true;
+   const QoreEncoding* enc = 0;
+   for (qore_size_t i = 0; i < priv->length; ++i) {
+      safe_qorelist_t args(new QoreListNode, xsink);
+      args->push(priv->entry[i] ? priv->entry[i]->refSelf() : 0);
+      AbstractQoreNode* k = fr->execValue(*args, xsink).takeNode();
+      if (*xsink) {
+         discard(k, xsink);
+         return 0;
+      }
+      keys->push(k);
+
+      qore_type_t t = get_node_type(k);
+      if (t != NT_INT)
+         all_int = false;
+      if (t != NT_INT && t != NT_FLOAT)
+         all_num = false;
+      if (t != NT_STRING)
+         all_str = false;
+      else {
+         const QoreEncoding* e = reinterpret_cast<const QoreStringNode*>(k)->getEncoding();
+         if (!enc)
+            enc = e;
+         else if (e != enc)
+            all_str = false;
+      }
+   }
+
+   if (max_threads <= 0) {
+      long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+      max_threads = ncpus > 0 ? ncpus : 1;
+   }
+
+   // sort by native keys where all keys have the same type
+   if (all_int) {
+      std::vector<SortByEntry<int64> > v(priv->length);
+      for (qore_size_t i = 0; i < priv->length; ++i) {
+         v[i].key = reinterpret_cast<const QoreBigIntNode*>(keys->retrieve_entry(i))->val;
+         v[i].val = priv->entry[i];
+      }
+      return sort_by_intern(v, SortByLess<int64>(descending), max_threads);
+   }
+   if (all_num) {
+      std::vector<SortByEntry<double> > v(priv->length);
+      for (qore_size_t i = 0; i < priv->length; ++i) {
+         v[i].key = keys->retrieve_entry(i)->getAsFloat();
+         v[i].val = priv->entry[i];
+      }
+      return sort_by_intern(v, SortByLess<double>(descending), max_threads);
+   }
+   if (all_str) {
+      std::vector<SortByEntry<const char*> > v(priv->length);
+      for (qore_size_t i = 0; i < priv->length; ++i) {
+         v[i].key = reinterpret_cast<const QoreStringNode*>(keys->retrieve_entry(i))->getBuffer();
+         v[i].val = priv->entry[i];
+      }
+      return sort_by_intern(v, SortByStrLess(descending), max_threads);
+   }
+
+   // mixed key types are sorted with soft comparisons in the calling thread
+   std::vector<SortByEntry<AbstractQoreNode*> > v(priv->length);
+   for (qore_size_t i = 0; i < priv->length; ++i) {
+      v[i].key = keys->retrieve_entry(i);
+      v[i].val = priv->entry[i];
+   }
+   ReferenceHolder<QoreListNode> rv(sort_by_intern(v, SortByNodeLess(descending, xsink), 1), xsink);
+   return *xsink ? 0 : rv.release();
+}
+
 // does a deep dereference
 bool QoreListNode::derefImpl(ExceptionSink* xsink) {
+   // large lists without objects are freed by the background reclaimer if enabled
+   if (qore_deferred_free_min && !priv->obj_count && qore_check_deferred_free(this, priv->length)) {
+      QoreListNode* l = new QoreListNode;
+      l->priv->swap(*priv);
+      if (qore_deferred_free(l))
+         return true;
+      // the reclaimer is not available; free the elements here
+      priv->swap(*l->priv);
+      l->deref(xsink);
+   }
    for (qore_size_t i = 0; i < priv->length; i++)
       if (priv->entry[i])
          priv->entry[i]->deref(xsink);
@@ -0,0 +1,124 @@
+/*
+  QoreLockStats.cpp
+ 
+  Qore Programming Language
+ 
+  Copyright (C) 2003 - 2015 David Nichols
+ 
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#include <qore/Qore.h>
+#include <qore/intern/QoreLockStats.h>
+#include <qore/intern/qore_program_private.h>
+
+#include <set>
+#include <map>
+#include <string>
+
+// statistics aggregated for all locks of one type
+struct QoreLockStatsTotal {
+   int64 locks, acquisitions, contended, wait_total, wait_max, hold_total, hold_max;
+
+   DLLLOCAL QoreLockStatsTotal() : locks(0), acquisitions(0), contended(0), wait_total(0), wait_max(0), hold_total(0), hold_max(0) {
+   }
+
+   DLLLOCAL void add(const QoreLockStats& s) {
+      acquisitions += s.acquisitions;
+      contended += s.contended;
+      wait_total += s.wait_total;
+      if (s.wait_max > wait_max)
+         wait_max = s.wait_max;
+      hold_total += s.hold_total;
+      if (s.hold_max > hold_max)
+         hold_max = s.hold_max;
+   }
+};
+
+typedef std::set<const QoreLockStats*> lock_stats_set_t;
+typedef std::map<std::string, QoreLockStatsTotal> lock_stats_total_map_t;
+
+// protects the registry and retired totals below; never held while acquiring a lock's internal mutex
+static QoreThreadLock lock_stats_lock;
+// all live lock statistics objects
+static lock_stats_set_t lock_stats_set;
+// totals of statistics objects that have been deleted
+static lock_stats_total_map_t lock_stats_retired;
+
+static void set_stats_keys(QoreHashNode* h, int64 acquisitions, int64 contended, int64 wait_total, int64 wait_max, int64 hold_total, int64 hold_max) {
+   h->setKeyValue("acquisitions", new QoreBigIntNode(acquisitions), 0);
+   h->setKeyValue("contended", new QoreBigIntNode(contended), 0);
+   h->setKeyValue("wait_total_us", new QoreBigIntNode(wait_total), 0);
+   h->setKeyValue("wait_max_us", new QoreBigIntNode(wait_max), 0);
+   h->setKeyValue("hold_total_us", new QoreBigIntNode(hold_total), 0);
+   h->setKeyValue("hold_max_us", new QoreBigIntNode(hold_max), 0);
+}
+
+QoreLockStats::QoreLockStats(const char* n_type) : type(n_type), hold_start(0), acquisitions(0), contended(0), wait_total(0), wait_max(0), hold_total(0), hold_max(0) {
+   AutoLocker al(lock_stats_lock);
+   lock_stats_set.insert(this);
+}
+
+QoreLockStats::~QoreLockStats() {
+   AutoLocker al(lock_stats_lock);
+   lock_stats_set.erase(this);
+   QoreLockStatsTotal& t = lock_stats_retired[type];
+   ++t.locks;
+   t.add(*this);
+}
+
+QoreHashNode* QoreLockStats::getHash() const {
+   QoreHashNode* h = new QoreHashNode;
+   h->setKeyValue("type", new QoreStringNode(type), 0);
+   set_stats_keys(h, acquisitions, contended, wait_total, wait_max, hold_total, hold_max);
+   return h;
+}
+
+QoreHashNode* QoreLockStats::getAll() {
+   lock_stats_total_map_t totals;
+   {
+      AutoLocker al(lock_stats_lock);
+      totals = lock_stats_retired;
+      // the counters of live locks are read without their locks, so the result is an approximate snapshot
+      for (lock_stats_set_t::const_iterator i = lock_stats_set.begin(), e = lock_stats_set.end(); i != e; ++i) {
+         QoreLockStatsTotal& t = totals[(*i)->getType()];
+         ++t.locks;
+         t.add(**i);
+      }
+   }
+
+   QoreHashNode* rv = new QoreHashNode;
+   for (lock_stats_total_map_t::const_iterator i = totals.begin(), e = totals.end(); i != e; ++i) {
+      const QoreLockStatsTotal& t = i->second;
+      QoreHashNode* h = new QoreHashNode;
+      h->setKeyValue("locks", new QoreBigIntNode(t.locks), 0);
+      set_stats_keys(h, t.acquisitions, t.contended, t.wait_total, t.wait_max, t.hold_total, t.hold_max);
+      rv->setKeyValue(i->first.c_str(), h, 0);
+   }
+   return rv;
+}
+
+bool q_lock_stats_default() {
+   QoreProgram* pgm = getProgram();
+   return pgm && qore_program_private::getLockStats(*pgm);
+}
@@ -95,6 +95,9 @@
 #endif
 
 DLLLOCAL QoreClass* initReadOnlyFileClass(QoreNamespace& ns);
+DLLLOCAL QoreClass* initHTTPConnectionPoolClass(QoreNamespace& ns);
+DLLLOCAL QoreClass* initSocketMultiplexerClass(QoreNamespace& ns);
+DLLLOCAL QoreClass* initSocketEventLoopClass(QoreNamespace& ns);
 
 DLLLOCAL QoreClass* initAbstractDatasourceClass(QoreNamespace& ns);
 DLLLOCAL QoreClass* initAbstractIteratorClass(QoreNamespace& ns);
@@ -746,6 +749,8 @@ StaticSystemNamespace::StaticSystemNamespace() : RootQoreNamespace(new qore_root
    qns.addSystemClass(initTimeZoneClass(qns));
    qns.addSystemClass(initSSLCertificateClass(qns));
    qns.addSystemClass(initSSLPrivateKeyClass(qns));
+   // must be initialized before the Socket class, which refers to it in method signatures
+   qns.addSystemClass(initSocketEventLoopClass(qns));
    qns.addSystemClass(initSocketClass(qns));
    qns.addSystemClass(initProgramClass(qns));
 
@@ -758,6 +763,8 @@ StaticSystemNamespace::StaticSystemNamespace() : RootQoreNamespace(new qore_root
 
    // add HTTPClient namespace
    qns.addSystemClass(initHTTPClientClass(qns));
+   qns.addSystemClass(initHTTPConnectionPoolClass(qns));
+   qns.addSystemClass(initSocketMultiplexerClass(qns));
 
    qns.addSystemClass(initAbstractIteratorClass(qns));
    qns.addSystemClass(initAbstractQuantifiedIteratorClass(qns));
@@ -256,7 +256,7 @@ void QoreObject::externalDelete(qore_classid_t key, ExceptionSink* xsink) {
       priv->privateData->getAndClearPtr(key);
 #endif
       // mark status as in destructor
-      priv->status = gettid();
+      priv->status = q_gettid();
    }
 
    // run the destructor
@@ -563,7 +563,7 @@ void QoreObject::doDelete(ExceptionSink* xsink) {
       }
 
       // mark status as in destructor
-      priv->status = gettid();
+      priv->status = q_gettid();
    }
    priv->doDeleteIntern(xsink);
 }
@@ -692,7 +692,7 @@ void QoreObject::customDeref(ExceptionSink* xsink) {
       //printd(5, "QoreObject::derefImpl() class: %s this: %p going out of scope\n", getClassName(), this);
 
       // mark status as in destructor
-      priv->status = gettid();
+      priv->status = q_gettid();
 
       //printd(5, "Object lock %p unlocked (safe)\n", &priv->rml);
    }
@@ -1362,7 +1362,7 @@ bool ObjectRSetHelper::checkIntern(QoreObject& obj) {
       return false;
    }
 
-   int tid = gettid();
+   int tid = q_gettid();
 
    // see if the object has been scanned
    omap_t::iterator fi = fomap.lower_bound(&obj);
@@ -1514,12 +1514,12 @@ public:
 	 obj.rdone.wait(obj.rlck);
 	 --obj.rwaiting;
       }
-      obj.rscan = gettid();
+      obj.rscan = q_gettid();
    }
 
    DLLLOCAL ~ObjectRScanHelper() {
       AutoLocker al(obj.rlck);
-      assert(obj.rscan == gettid());
+      assert(obj.rscan == q_gettid());
       if (obj.rwaiting)
 	 obj.rdone.signal();
       obj.rscan = 0;
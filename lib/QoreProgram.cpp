@@ -125,6 +125,7 @@ ParseOptionMaps::ParseOptionMaps() {
       doMap(PO_NEW_STYLE, "PO_NEW_STYLE");
       doMap(PO_ALLOW_INJECTION, "PO_ALLOW_INJECTION");
       doMap(PO_NO_INHERIT_SYSTEM_CONSTANTS, "PO_NO_INHERIT_SYSTEM_CONSTANTS");
+      doMap(PO_NO_DEADLOCK_DETECTION, "PO_NO_DEADLOCK_DETECTION");
       doMap(PO_NO_INHERIT_USER_CONSTANTS, "PO_NO_INHERIT_USER_CONSTANTS");
 }
 
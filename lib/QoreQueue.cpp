@@ -63,7 +63,10 @@ void qore_queue_private::clearIntern(ExceptionSink* xsink) {
 
 int qore_queue_private::waitReadIntern(ExceptionSink *xsink, int timeout_ms) {
    // if there is no data, then wait for condition variable
+   int64 wait_start = 0;
    while (!head) {
+      if (stats && !wait_start)
+         wait_start = q_clock_getmicros();
       ++read_waiting;
       int rc = timeout_ms ? read_cond.wait(l, timeout_ms) : read_cond.wait(l);
       --read_waiting;
@@ -83,13 +86,18 @@ int qore_queue_private::waitReadIntern(ExceptionSink *xsink, int timeout_ms) {
 	 return QW_DEL;
       }
    }
-   
+
+   if (stats)
+      stats->acquiredShared(wait_start);
    return 0;
 }
 
 int qore_queue_private::waitWriteIntern(ExceptionSink *xsink, int timeout_ms) {
    // if the queue is full, then wait for condition variable
+   int64 wait_start = 0;
    while (max > 0 && len >= max) {
+      if (stats && !wait_start)
+         wait_start = q_clock_getmicros();
       ++write_waiting;
       int rc = timeout_ms ? write_cond.wait(l, timeout_ms) : write_cond.wait(l);
       --write_waiting;
@@ -109,7 +117,9 @@ int qore_queue_private::waitWriteIntern(ExceptionSink *xsink, int timeout_ms) {
 	 return QW_DEL;
       }
    }
-   
+
+   if (stats)
+      stats->acquiredShared(wait_start);
    return 0;
 }
 
@@ -273,6 +283,23 @@ void qore_queue_private::clear(ExceptionSink* xsink) {
       write_cond.signal();
 }
 
+void qore_queue_private::setLockStats(bool enable) {
+   AutoLocker al(&l);
+   if (enable == (bool)stats)
+      return;
+   if (enable)
+      stats = new QoreLockStats("Queue");
+   else {
+      delete stats;
+      stats = 0;
+   }
+}
+
+QoreHashNode* qore_queue_private::getLockStats() const {
+   AutoLocker al(&l);
+   return stats ? stats->getHash() : 0;
+}
+
 QoreQueue::QoreQueue(int n_max) : priv(new qore_queue_private(n_max)) {
 }
 
@@ -287,16 +314,19 @@ QoreQueue::~QoreQueue() {
 
 // push at the end of the queue and take the reference - can only be used when len == -1
 void QoreQueue::pushAndTakeRef(AbstractQoreNode* n) {
+   q_share_value(n);
    priv->pushAndTakeRef(n);
 }
 
 // push at the end of the queue
 void QoreQueue::push(ExceptionSink* xsink, const AbstractQoreNode* n, int timeout_ms, bool* to) {
+   q_share_value(n);
    priv->push(xsink, n, timeout_ms, to);
 }
 
 // insert at the beginning of the queue
 void QoreQueue::insert(ExceptionSink* xsink, const AbstractQoreNode* n, int timeout_ms, bool* to) {
+   q_share_value(n);
    priv->insert(xsink, n, timeout_ms, to);
 }
 
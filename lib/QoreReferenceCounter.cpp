@@ -30,20 +30,81 @@
 
 #include <qore/Qore.h>
 
+#ifdef QORE_BIASED_REFCOUNT
+// biased reference counting: the thread that creates the object (the owner) updates "references" without
+// atomic operations; all other threads update the atomic "shared_references" count, which can become
+// negative while the owner still holds references.  When the owner's count reaches zero or when the object
+// is published to other threads (see ROshare()), the owner's count is merged into the shared count and the
+// QRC_MERGED bit is set; from then on only the shared count is used, and the object is deleted when it
+// reaches zero.  If the owner terminates without merging, the merge is done by the first thread that
+// releases a reference and finds a negative shared count.
+
+// set in shared_references when the owner's count has been merged
+#define QRC_MERGED 1
+// one reference in shared_references
+#define QRC_ONE 2
+
+QoreReferenceCounter::QoreReferenceCounter() : references(1), shared_references(0), owner_id(q_get_owner_id()) {
+}
+#else
 QoreReferenceCounter::QoreReferenceCounter() : references(1) {
 }
+#endif
 
 QoreReferenceCounter::~QoreReferenceCounter() {
 }
 
+#ifdef QORE_BIASED_REFCOUNT
+// merges the given count from the owner into the shared count; returns the merged count or -1 if the count
+// had already been merged by another thread
+static int merge_shared(volatile int* sr, int biased) {
+   while (true) {
+      int s = qore_atomic_get(sr);
+      if (s & QRC_MERGED)
+         return -1;
+      int ns = (s + biased * QRC_ONE) | QRC_MERGED;
+      if (qore_atomic_cas(sr, s, ns))
+         return ns >> 1;
+   }
+}
+
+bool QoreReferenceCounter::is_unique() const {
+   int s = qore_atomic_get(&shared_references);
+   // after the merge, the shared count holds all references
+   if (s & QRC_MERGED)
+      return s == (QRC_ONE | QRC_MERGED);
+   // before the merge, the owner holds at least one reference, and only the owner can read its count
+   int64 oid = q_get_owner_id();
+   return oid != -1 && owner_id == oid && references + (s >> 1) == 1;
+}
+
+bool QoreReferenceCounter::ROshare() const {
+   int64 oid = q_get_owner_id();
+   if (oid == -1 || owner_id != oid)
+      return false;
+   // the merged count cannot be zero, since the caller holds a reference
+   merge_shared(&shared_references, references);
+   references = 0;
+   // the owner ID is only cleared after the merge, so other threads never treat the count as abandoned
+   owner_id = -1;
+   return true;
+}
+#endif
+
 void QoreReferenceCounter::ROreference() const {
 #ifdef DEBUG
-   if (references < 0 || references > 10000000) {
-      printd(0, "QoreReferenceCounter::ROreference() this=%p references=%d\n", this, references);
+   if (reference_count() < 0 || reference_count() > 10000000) {
+      printd(0, "QoreReferenceCounter::ROreference() this=%p references=%d\n", this, reference_count());
       assert(false);
    }
 #endif
-#ifdef HAVE_ATOMIC_MACROS
+#ifdef QORE_BIASED_REFCOUNT
+   int64 oid = q_get_owner_id();
+   if (oid != -1 && owner_id == oid)
+      ++references;
+   else
+      qore_atomic_add(&shared_references, QRC_ONE);
+#elif defined(HAVE_ATOMIC_MACROS)
    atomic_inc(&references);
 #else
    mRO.lock();
@@ -55,12 +116,43 @@ void QoreReferenceCounter::ROreference() const {
 // returns true when references reach zero
 bool QoreReferenceCounter::ROdereference() const {
 #ifdef DEBUG
-   if (references <= 0 || references > 10000000) {
-      printd(0, "QoreReferenceCounter::ROdereference() this=%p references=%d\n", this, references);
+   if (reference_count() <= 0 || reference_count() > 10000000) {
+      printd(0, "QoreReferenceCounter::ROdereference() this=%p references=%d\n", this, reference_count());
       assert(false);
    }
 #endif
-#ifdef HAVE_ATOMIC_MACROS
+#ifdef QORE_BIASED_REFCOUNT
+   int64 oid = q_get_owner_id();
+   if (oid != -1 && owner_id == oid) {
+      if (--references)
+         return false;
+      // the owner has released its last reference; any further references use the shared count
+      bool rv = !merge_shared(&shared_references, 0);
+      owner_id = -1;
+      return rv;
+   }
+
+   int rc = qore_atomic_sub(&shared_references, QRC_ONE);
+   if (rc & QRC_MERGED)
+      return rc == QRC_MERGED;
+   // if the shared count is not negative, then the reference count cannot be zero, because the owner
+   // merges its count before it terminates if its count reaches zero
+   if (rc >= 0)
+      return false;
+   // otherwise the owner holds the remaining references; if it is still running, it will merge the count
+   // when it releases its last reference
+   int64 o = qore_atomic_get(&owner_id);
+   if (o != -1 && q_owner_active(o))
+      return false;
+   // the owner has terminated (or the object was created outside a qore thread); merge its count here
+   rc = merge_shared(&shared_references, references);
+   // if the count was merged by another thread, then our release has been included in the merged count
+   // and the other thread has determined if the count reached zero
+   if (rc == -1)
+      return false;
+   references = 0;
+   return !rc;
+#elif defined(HAVE_ATOMIC_MACROS)
    // do not do a cache sync if references == 1
    // this optimization leads to a race condition on platforms without atomic reference counts
    // (i.e. using a mutex lock), as one thread could decrement from 2 -> 1, and then before
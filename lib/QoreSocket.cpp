@@ -414,6 +414,54 @@ int SSLSocketHelper::write(const char* mname, const void* buf, int size, int tim
    return doSSLRW(mname, (void*)buf, size, timeout_ms, false, xsink);
 }
 
+int SSLSocketHelper::connectStep(const char* mname, int& want, bool& closed, ExceptionSink* xsink) {
+   return doSSLStep(SSL_connect(ssl), mname, "SSL_connect", false, want, closed, xsink);
+}
+
+int SSLSocketHelper::readStep(const char* mname, char* buf, int size, int& want, bool& closed, ExceptionSink* xsink) {
+   return doSSLStep(SSL_read(ssl, buf, size), mname, "SSL_read", true, want, closed, xsink);
+}
+
+int SSLSocketHelper::writeStep(const char* mname, const void* buf, int size, int& want, bool& closed, ExceptionSink* xsink) {
+   return doSSLStep(SSL_write(ssl, buf, size), mname, "SSL_write", false, want, closed, xsink);
+}
+
+// "this" must not be accessed after sslError() reports that the connection has been closed
+int SSLSocketHelper::doSSLStep(int rc, const char* mname, const char* ssl_func, bool read, int& want, bool& closed, ExceptionSink* xsink) {
+   assert(!closed);
+   want = 0;
+   if (rc > 0)
+      return rc;
+
+   int err = SSL_get_error(ssl, rc);
+   if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+      want = err;
+      return -1;
+   }
+
+   // the remote end shut down the TLS/SSL connection
+   if (read && err == SSL_ERROR_ZERO_RETURN)
+      return 0;
+
+   if (err == SSL_ERROR_SYSCALL) {
+      int en = sock_get_error();
+      sslError(xsink, closed, mname, ssl_func, false);
+      if (!*xsink) {
+         // the error queue was empty and the socket has been closed
+         if (read && !rc)
+            return 0;
+         if (!rc)
+            xsink->raiseException("SOCKET-SSL-ERROR", "error in Socket::%s(): the openssl library reported an EOF condition that violates the SSL protocol while calling %s()", mname, ssl_func);
+         else
+            xsink->raiseErrnoException("SOCKET-SSL-ERROR", en, "error in Socket::%s(): the openssl library reported an I/O error while calling %s()", mname, ssl_func);
+      }
+      return -1;
+   }
+
+   sslError(xsink, closed, mname, ssl_func, true);
+   return -1;
+}
+
 const char* SSLSocketHelper::getCipherName() const {
    return SSL_get_cipher_name(ssl);
 }
@@ -673,6 +721,32 @@ DLLLOCAL OptionalNonBlockingHelper::~OptionalNonBlockingHelper() {
    }
 }
 
+DLLLOCAL TcpCorkHelper::TcpCorkHelper(qore_socket_private& s, bool n_set) : sock(s), set(false) {
+#ifdef TCP_CORK
+   if (n_set && sock.sock != QORE_INVALID_SOCKET) {
+      int on = 1;
+      set = !setsockopt(sock.sock, IPPROTO_TCP, TCP_CORK, (SETSOCKOPT_ARG_4)&on, sizeof(int));
+   }
+#endif
+}
+
+DLLLOCAL TcpCorkHelper::~TcpCorkHelper() {
+   uncork();
+}
+
+DLLLOCAL void TcpCorkHelper::uncork() {
+#ifdef TCP_CORK
+   // removing the cork flushes any partial segment; the socket may have been closed in the meantime
+   if (set) {
+      set = false;
+      if (sock.sock != QORE_INVALID_SOCKET) {
+         int off = 0;
+         setsockopt(sock.sock, IPPROTO_TCP, TCP_CORK, (SETSOCKOPT_ARG_4)&off, sizeof(int));
+      }
+   }
+#endif
+}
+
 int SSLSocketHelper::read(const char* mname, char* buf, int size, int timeout_ms, ExceptionSink* xsink) {
    return doSSLRW(mname, buf, size, timeout_ms, true, xsink);
 }
@@ -781,6 +855,14 @@ int QoreSocket::getNoDelay() const {
    return rc;
 }
 
+int QoreSocket::setReusePort(bool b) {
+   return priv->setReusePort(b);
+}
+
+bool QoreSocket::getReusePort() const {
+   return priv->reuseport;
+}
+
 int QoreSocket::close() {
    return priv->close();
 }
@@ -1253,6 +1335,10 @@ int QoreSocket::send(int fd, qore_offset_t size) {
    return rc;
 }
 
+int QoreSocket::sendFile(int fd, int64 offset, int64 size, int timeout_ms, ExceptionSink* xsink) {
+   return priv->sendFile(xsink, "sendFile", fd, offset, size, timeout_ms);
+}
+
 BinaryNode* QoreSocket::recvBinary(qore_offset_t bufsize, int timeout, int *rc) {
    assert(rc);
    qore_offset_t nrc;
@@ -1661,6 +1747,27 @@ QoreSocket* QoreSocket::acceptSSL(int timeout_ms, X509* cert, EVP_PKEY* pkey, Ex
    return s.release();
 }
 
+int QoreSocket::acceptMany(std::vector<QoreSocket*>& l, int max, int timeout_ms, ExceptionSink* xsink) {
+   std::vector<int> fds;
+   int rc = priv->acceptMany(fds, max, timeout_ms, xsink);
+
+   for (std::vector<int>::iterator i = fds.begin(), e = fds.end(); i != e; ++i) {
+      QoreSocket* s = new QoreSocket(*i, priv->sfamily, priv->stype, priv->sprot, priv->enc);
+      if (!priv->socketname.empty())
+         s->priv->socketname = priv->socketname;
+      l.push_back(s);
+   }
+   return rc;
+}
+
+QoreListNode* QoreSocket::recvDatagrams(int max, int size, int timeout_ms, ExceptionSink* xsink) {
+   return priv->recvDatagrams(xsink, max, size, timeout_ms);
+}
+
+int QoreSocket::sendDatagrams(const QoreListNode* l, ExceptionSink* xsink) {
+   return priv->sendDatagrams(xsink, l);
+}
+
 int QoreSocket::acceptAndReplace(int timeout_ms, ExceptionSink* xsink) {
    int rc = priv->accept_internal(0, timeout_ms, xsink);
    if (rc < 0)
@@ -0,0 +1,905 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#include <qore/Qore.h>
+#include <qore/intern/QC_Socket.h>
+#include <qore/intern/qore_socket_private.h>
+#include <qore/intern/QoreSocketEventLoop.h>
+#include <qore/intern/QoreException.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef QORE_EVLOOP_EPOLL
+#include <poll.h>
+#endif
+
+QoreSocketAsyncOp::QoreSocketAsyncOp(op_type t, QoreObject* o, QoreSocketObject* n_s, const ResolvedCallReferenceNode* n_cb, int to) :
+   loop(0), obj(o), s(n_s), cb(n_cb->refRefSelf()), error(0), type(t), id(0), fd(QORE_INVALID_SOCKET), timeout_ms(to), write(false),
+   has_deadline(false), restored(false), timed_out(false), ai(0), last_err(0), ssl(false), connecting(false), handshake(false),
+   data(0), size(0), sdata(0), sbuf(0), slen(0), soff(0) {
+   obj->ref();
+   s->ref();
+}
+
+const char* QoreSocketAsyncOp::getMethodName() const {
+   switch (type) {
+      case AO_CONNECT: return "connectAsync";
+      case AO_RECV: return "recvAsync";
+      default: return "sendAsync";
+   }
+}
+
+QoreHashNode* QoreSocketAsyncOp::getHash(ExceptionSink* xsink) {
+   QoreHashNode* h = new QoreHashNode;
+   h->setKeyValue("op", new QoreStringNode(type == AO_CONNECT ? "connect" : (type == AO_RECV ? "recv" : "send")), xsink);
+   h->setKeyValue("socket", obj, xsink);
+   obj = 0;
+   if (type == AO_RECV) {
+      h->setKeyValue("data", data, xsink);
+      data = 0;
+   }
+   else if (type == AO_SEND)
+      h->setKeyValue("bytes", new QoreBigIntNode(soff), xsink);
+   if (error) {
+      h->setKeyValue("error", error, xsink);
+      error = 0;
+   }
+   return h;
+}
+
+void QoreSocketAsyncOp::deref(ExceptionSink* xsink) {
+   if (s)
+      s->deref(xsink);
+   if (obj)
+      obj->deref(xsink);
+   if (cb)
+      cb->deref(xsink);
+   if (error)
+      error->deref(xsink);
+   if (data)
+      data->deref();
+   if (sdata)
+      sdata->deref(xsink);
+}
+
+static int evloop_set_fd_flags(int fd) {
+   return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) || fcntl(fd, F_SETFD, FD_CLOEXEC) ? -1 : 0;
+}
+
+QoreSocketEventLoop::QoreSocketEventLoop(ExceptionSink* xsink) : seq(0), poll_until(-1),
+#ifdef QORE_EVLOOP_EPOLL
+   epfd(-1),
+#endif
+   run_tid(0), polling(false), stop_req(false) {
+   wake_fd[0] = wake_fd[1] = -1;
+
+#ifdef _Q_WINDOWS
+   xsink->raiseException("SOCKET-EVENT-LOOP-ERROR", "the SocketEventLoop class is not supported on this platform");
+#else
+   if (pipe(wake_fd) || evloop_set_fd_flags(wake_fd[0]) || evloop_set_fd_flags(wake_fd[1])) {
+      xsink->raiseErrnoException("SOCKET-EVENT-LOOP-ERROR", errno, "cannot create wakeup pipe");
+      return;
+   }
+
+#ifdef QORE_EVLOOP_EPOLL
+   epfd = epoll_create(QORE_EVLOOP_MAX_EVENTS);
+   if (epfd < 0 || fcntl(epfd, F_SETFD, FD_CLOEXEC)) {
+      xsink->raiseErrnoException("SOCKET-EVENT-LOOP-ERROR", errno, "cannot create epoll descriptor");
+      return;
+   }
+   // the wakeup pipe is identified by ID 0; operation IDs start at 1
+   struct epoll_event ev;
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.u64 = 0;
+   if (epoll_ctl(epfd, EPOLL_CTL_ADD, wake_fd[0], &ev))
+      xsink->raiseErrnoException("SOCKET-EVENT-LOOP-ERROR", errno, "cannot add wakeup pipe to the epoll descriptor");
+#endif
+#endif
+}
+
+QoreSocketEventLoop::~QoreSocketEventLoop() {
+   assert(imap.empty());
+   assert(done.empty());
+#ifdef QORE_EVLOOP_EPOLL
+   if (epfd >= 0)
+      ::close(epfd);
+#endif
+   if (wake_fd[0] >= 0)
+      ::close(wake_fd[0]);
+   if (wake_fd[1] >= 0)
+      ::close(wake_fd[1]);
+}
+
+void QoreSocketEventLoop::deref(ExceptionSink* xsink) {
+   if (ROdereference()) {
+      cancelAll(xsink);
+      delete this;
+   }
+}
+
+void QoreSocketEventLoop::wakeup() {
+   char c = 0;
+   // if the pipe is full, then the polling thread will wake up anyway
+   if (::write(wake_fd[1], &c, 1) < 0) {
+   }
+}
+
+int QoreSocketEventLoop::arm(QoreSocketAsyncOp* op, ExceptionSink* xsink) {
+#ifdef QORE_EVLOOP_EPOLL
+   // sockets are registered as one-shot events and are never removed explicitly: a registration that has fired is
+   // disabled until it is rearmed, and the kernel removes registrations when the socket is closed, so removing
+   // descriptors here could affect a new socket that has been given the same descriptor number
+   struct epoll_event ev;
+   memset(&ev, 0, sizeof(ev));
+   ev.events = (op->write ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+   ev.data.u64 = op->id;
+   if (epoll_ctl(epfd, EPOLL_CTL_MOD, op->fd, &ev) && (errno != ENOENT || epoll_ctl(epfd, EPOLL_CTL_ADD, op->fd, &ev))) {
+      xsink->raiseErrnoException("SOCKET-EVENT-LOOP-ERROR", errno, "cannot add socket to the epoll descriptor");
+      return -1;
+   }
+#else
+   // the polling thread must rebuild its poll() set
+   if (polling)
+      wakeup();
+#endif
+   return 0;
+}
+
+void QoreSocketEventLoop::detach(QoreSocketAsyncOp* op) {
+   imap.erase(op->id);
+   if (op->has_deadline) {
+      dmap.erase(op->di);
+      op->has_deadline = false;
+   }
+}
+
+int QoreSocketEventLoop::pollIntern(int64 until, std::vector<int64>& ready, evloop_op_list_t& expired, ExceptionSink* xsink) {
+   int64 now = q_clock_getmillis();
+   // wake up at the earliest timeout at the latest
+   int64 wake = until;
+   if (!dmap.empty() && (wake < 0 || dmap.begin()->first < wake))
+      wake = dmap.begin()->first;
+   int to = wake < 0 ? -1 : (wake <= now ? 0 : (wake - now > INT_MAX ? INT_MAX : (int)(wake - now)));
+
+   polling = true;
+   poll_until = wake;
+
+   int rc, err;
+#ifdef QORE_EVLOOP_EPOLL
+   struct epoll_event ev[QORE_EVLOOP_MAX_EVENTS];
+   {
+      AutoUnlocker al(l);
+      rc = epoll_wait(epfd, ev, QORE_EVLOOP_MAX_EVENTS, to);
+      err = errno;
+   }
+#else
+   // the poll() set is rebuilt for each call; this is only used where epoll is not available
+   std::vector<struct pollfd> pfd;
+   std::vector<int64> ids;
+   pfd.reserve(imap.size() + 1);
+   ids.reserve(imap.size());
+   struct pollfd p;
+   p.fd = wake_fd[0];
+   p.events = POLLIN;
+   p.revents = 0;
+   pfd.push_back(p);
+   for (evloop_id_map_t::iterator i = imap.begin(), e = imap.end(); i != e; ++i) {
+      p.fd = i->second->fd;
+      p.events = i->second->write ? POLLOUT : POLLIN;
+      pfd.push_back(p);
+      ids.push_back(i->first);
+   }
+   {
+      AutoUnlocker al(l);
+      rc = ::poll(&pfd[0], pfd.size(), to);
+      err = errno;
+   }
+#endif
+   polling = false;
+   poll_until = -1;
+
+   if (rc < 0) {
+      if (err == EINTR)
+         return 0;
+      xsink->raiseErrnoException("SOCKET-EVENT-LOOP-ERROR", err, "error waiting for socket events");
+      return -1;
+   }
+
+   bool woken = false;
+#ifdef QORE_EVLOOP_EPOLL
+   for (int i = 0; i < rc; ++i) {
+      if (!ev[i].data.u64)
+         woken = true;
+      else
+         ready.push_back((int64)ev[i].data.u64);
+   }
+#else
+   if (rc && pfd[0].revents)
+      woken = true;
+   for (unsigned i = 1; rc && i < pfd.size(); ++i) {
+      if (pfd[i].revents)
+         ready.push_back(ids[i - 1]);
+   }
+#endif
+
+   if (woken) {
+      char buf[64];
+      while (::read(wake_fd[0], buf, sizeof(buf)) > 0) {
+      }
+   }
+
+   now = q_clock_getmillis();
+   while (!dmap.empty() && dmap.begin()->first <= now) {
+      QoreSocketAsyncOp* op = dmap.begin()->second;
+      detach(op);
+      op->timed_out = true;
+      expired.push_back(op);
+   }
+   return 0;
+}
+
+int QoreSocketEventLoop::claim(QoreSocketAsyncOp* op, bool open, ExceptionSink* xsink) {
+   qore_socket_private* sp = op->s->priv->socket->priv;
+   if (sp->in_op) {
+      xsink->raiseException("SOCKET-ASYNC-ERROR", "Socket::%s() cannot be called while another operation is in progress on the socket", op->getMethodName());
+      return -1;
+   }
+   if (open) {
+      if (sp->sock == QORE_INVALID_SOCKET) {
+         se_not_open(op->getMethodName(), xsink);
+         return -1;
+      }
+      if (sp->set_non_blocking(true, xsink))
+         return -1;
+      op->fd = sp->sock;
+   }
+   else
+      sp->close();
+   sp->in_op = true;
+   op->loop = this;
+   op->s->priv->async_op = op;
+   return 0;
+}
+
+void QoreSocketEventLoop::complete(QoreSocketAsyncOp* op, ExceptionSink& xs) {
+   qore_socket_private* sp = op->s->priv->socket->priv;
+   // if the socket was closed while the operation was in progress, then it may have been reopened with the same
+   // descriptor for other operations and must not be changed
+   if (op->s->priv->async_op == op) {
+      if (op->fd != QORE_INVALID_SOCKET && sp->sock == op->fd)
+         sp->set_non_blocking(false);
+      sp->in_op = false;
+      op->s->priv->async_op = 0;
+   }
+   op->restored = true;
+   if (xs) {
+      QoreException* e = xs.catchException();
+      op->error = e->makeExceptionObjectAndDelete(&xs);
+   }
+}
+
+int QoreSocketEventLoop::advance(QoreSocketAsyncOp* op, ExceptionSink* xsink) {
+   qore_socket_private* sp = op->s->priv->socket->priv;
+
+   // the socket was closed while the operation was in progress (closing the socket also releases it)
+   if (op->s->priv->async_op != op || ((op->type != QoreSocketAsyncOp::AO_CONNECT || op->connecting || op->handshake) && (sp->sock != op->fd || !sp->in_op))) {
+      op->fd = QORE_INVALID_SOCKET;
+      xsink->raiseException("SOCKET-CLOSED", "error in Socket::%s(): the socket was closed while the operation was in progress", op->getMethodName());
+      return 1;
+   }
+
+   if (op->timed_out) {
+      // a partially-established connection cannot be used
+      if (op->type == QoreSocketAsyncOp::AO_CONNECT) {
+         sp->close_internal();
+         op->fd = QORE_INVALID_SOCKET;
+      }
+      se_timeout(op->getMethodName(), op->timeout_ms, xsink);
+      return 1;
+   }
+
+   switch (op->type) {
+      case QoreSocketAsyncOp::AO_CONNECT: return advanceConnect(op, sp, xsink);
+      case QoreSocketAsyncOp::AO_RECV: return advanceRecv(op, sp, xsink);
+      default: return advanceSend(op, sp, xsink);
+   }
+}
+
+int QoreSocketEventLoop::advanceConnect(QoreSocketAsyncOp* op, qore_socket_private* sp, ExceptionSink* xsink) {
+   const char* mname = op->getMethodName();
+   while (true) {
+      if (op->handshake) {
+         int want;
+         bool closed = false;
+         if (sp->ssl->connectStep(mname, want, closed, xsink) > 0) {
+            op->handshake = false;
+            sp->do_ssl_established_event();
+            return 1;
+         }
+         if (want) {
+            op->write = (want == SSL_ERROR_WANT_WRITE);
+            return 0;
+         }
+         // if the connection was closed, then the SSLSocketHelper object has already been deleted
+         if (!closed) {
+            delete sp->ssl;
+            sp->ssl = 0;
+         }
+         sp->close_internal();
+         op->fd = QORE_INVALID_SOCKET;
+         return 1;
+      }
+
+      bool connected = false;
+      if (op->connecting) {
+         // the non-blocking connect() has completed; check the result
+         int val = 0;
+         socklen_t len = sizeof(int);
+         if (getsockopt(sp->sock, SOL_SOCKET, SO_ERROR, (GETSOCKOPT_ARG_4)(&val), &len) == QORE_SOCKET_ERROR)
+            val = sock_get_error();
+         op->connecting = false;
+         if (!val)
+            connected = true;
+         else {
+            op->last_err = val;
+            // try addresses that could not be connected last in subsequent connections
+            if (op->addrs[op->ai].family != AF_UNIX)
+               qore_dns_cache.reportFailure(op->host.c_str(), op->service.c_str(), AF_UNSPEC, SOCK_STREAM, 0, (struct sockaddr*)&op->addrs[op->ai].addr, op->addrs[op->ai].addrlen);
+            sp->close_and_reset();
+            op->fd = QORE_INVALID_SOCKET;
+            ++op->ai;
+         }
+      }
+
+      if (connected) {
+         const QoreDnsAddr& a = op->addrs[op->ai];
+         sp->sfamily = a.family;
+         sp->stype = a.socktype;
+         sp->sprot = a.protocol;
+         if (a.family == AF_UNIX)
+            sp->socketname = op->host;
+         else
+            sp->port = q_get_port_from_addr((struct sockaddr*)&a.addr);
+         sp->do_connected_event();
+
+         if (!op->ssl)
+            return 1;
+
+         // negotiate the SSL connection without blocking
+         SSLSocketHelperHelper sshh(sp);
+         sp->do_start_ssl_event();
+         if (sp->ssl->setClient(mname, sp->sock, op->s->priv->cert ? op->s->priv->cert->getData() : 0, op->s->priv->pk ? op->s->priv->pk->getData() : 0, xsink)) {
+            sshh.error();
+            sp->close_internal();
+            op->fd = QORE_INVALID_SOCKET;
+            return 1;
+         }
+         op->handshake = true;
+         continue;
+      }
+
+      if (op->ai == op->addrs.size()) {
+         qore_socket_error_intern(op->last_err, xsink, "SOCKET-CONNECT-ERROR", "error in connect()", mname, op->host.c_str(), op->service.empty() ? 0 : op->service.c_str());
+         return 1;
+      }
+
+      // start connecting to the next address
+      const QoreDnsAddr& a = op->addrs[op->ai];
+      if ((sp->sock = socket(a.family, a.socktype, a.protocol)) == QORE_INVALID_SOCKET) {
+         op->last_err = sock_get_error();
+         ++op->ai;
+         continue;
+      }
+      op->fd = sp->sock;
+      if (sp->set_non_blocking(true, xsink)) {
+         op->fd = QORE_INVALID_SOCKET;
+         return 1;
+      }
+
+      struct sockaddr* addr = (struct sockaddr*)&a.addr;
+      sp->do_connect_event(a.family, addr, op->host.c_str(), op->service.empty() ? 0 : op->service.c_str(), a.family == AF_UNIX ? -1 : q_get_port_from_addr(addr));
+      int rc;
+      while ((rc = ::connect(sp->sock, addr, a.addrlen)) && sock_get_error() == EINTR) {
+      }
+      if (!rc) {
+         op->connecting = true;
+         continue;
+      }
+      if (errno == EINPROGRESS) {
+         op->connecting = true;
+         op->write = true;
+         return 0;
+      }
+      op->last_err = errno;
+      if (a.family != AF_UNIX)
+         qore_dns_cache.reportFailure(op->host.c_str(), op->service.c_str(), AF_UNSPEC, SOCK_STREAM, 0, addr, a.addrlen);
+      sp->close_and_reset();
+      op->fd = QORE_INVALID_SOCKET;
+      ++op->ai;
+   }
+}
+
+int QoreSocketEventLoop::advanceRecv(QoreSocketAsyncOp* op, qore_socket_private* sp, ExceptionSink* xsink) {
+   const char* mname = op->getMethodName();
+   while (true) {
+      // data already read from the socket is returned first
+      if (sp->buflen) {
+         size_t n = sp->buflen;
+         if (op->size > 0 && (int64)n > op->size - (int64)op->data->size())
+            n = op->size - op->data->size();
+         op->data->append(sp->rbuf + sp->bufoffset, n);
+         sp->buflen -= n;
+         sp->bufoffset = sp->buflen ? sp->bufoffset + n : 0;
+         if (op->size <= 0 || (int64)op->data->size() >= op->size)
+            return 1;
+      }
+
+      qore_offset_t rc;
+      if (sp->ssl) {
+         int want;
+         bool closed = false;
+         rc = sp->ssl->readStep(mname, sp->rbuf, DEFAULT_SOCKET_BUFSIZE, want, closed, xsink);
+         if (want) {
+            op->write = (want == SSL_ERROR_WANT_WRITE);
+            return 0;
+         }
+         if (closed)
+            op->fd = QORE_INVALID_SOCKET;
+         if (rc < 0)
+            return 1;
+      }
+      else {
+         while ((rc = ::recv(sp->sock, sp->rbuf, DEFAULT_SOCKET_BUFSIZE, 0)) == QORE_SOCKET_ERROR && sock_get_error() == EINTR) {
+         }
+         if (rc == QORE_SOCKET_ERROR) {
+            if (errno == EAGAIN
+#ifdef EWOULDBLOCK
+                || errno == EWOULDBLOCK
+#endif
+               ) {
+               op->write = false;
+               return 0;
+            }
+            qore_socket_error(xsink, "SOCKET-RECV-ERROR", "error in recv()", mname);
+#ifdef ECONNRESET
+            if (errno == ECONNRESET) {
+               sp->close();
+               op->fd = QORE_INVALID_SOCKET;
+            }
+#endif
+            return 1;
+         }
+      }
+
+      // the remote end closed the connection; the data received so far is returned
+      if (!rc) {
+         if (sp->sock != QORE_INVALID_SOCKET)
+            sp->close();
+         op->fd = QORE_INVALID_SOCKET;
+         return 1;
+      }
+
+      sp->buflen = rc;
+      sp->bufoffset = 0;
+      sp->tp_bytes_recv += rc;
+      sp->do_read_event(rc, op->data->size() + rc);
+   }
+}
+
+int QoreSocketEventLoop::advanceSend(QoreSocketAsyncOp* op, qore_socket_private* sp, ExceptionSink* xsink) {
+   const char* mname = op->getMethodName();
+   while (op->soff < op->slen) {
+      qore_offset_t rc;
+      if (sp->ssl) {
+         int want;
+         bool closed = false;
+         rc = sp->ssl->writeStep(mname, op->sbuf + op->soff, op->slen - op->soff, want, closed, xsink);
+         if (want) {
+            op->write = (want == SSL_ERROR_WANT_WRITE);
+            return 0;
+         }
+         if (rc <= 0) {
+            if (closed)
+               op->fd = QORE_INVALID_SOCKET;
+            return 1;
+         }
+      }
+      else {
+         while ((rc = ::send(sp->sock, op->sbuf + op->soff, op->slen - op->soff, 0)) == QORE_SOCKET_ERROR && sock_get_error() == EINTR) {
+         }
+         if (rc == QORE_SOCKET_ERROR) {
+            if (errno == EAGAIN
+#ifdef EWOULDBLOCK
+                || errno == EWOULDBLOCK
+#endif
+               ) {
+               op->write = true;
+               return 0;
+            }
+            xsink->raiseErrnoException("SOCKET-SEND-ERROR", errno, "error while executing Socket::%s()", mname);
+            if (false
+#ifdef EPIPE
+                || errno == EPIPE
+#endif
+#ifdef ECONNRESET
+                || errno == ECONNRESET
+#endif
+               ) {
+               sp->close();
+               op->fd = QORE_INVALID_SOCKET;
+            }
+            return 1;
+         }
+      }
+
+      op->soff += rc;
+      sp->tp_bytes_sent += rc;
+      sp->do_send_event(rc, op->soff, op->slen);
+   }
+   return 1;
+}
+
+int QoreSocketEventLoop::process(QoreSocketAsyncOp* op) {
+   ExceptionSink xs;
+   AutoLocker al(op->s->priv->m);
+   // the operation has already been completed because its socket was closed
+   if (op->restored)
+      return -1;
+   int rc = advance(op, &xs);
+   if (rc)
+      complete(op, xs);
+   return rc;
+}
+
+void QoreSocketEventLoop::cancel(QoreSocketAsyncOp* op, ExceptionSink* xsink) {
+   if (!op->restored) {
+      AutoLocker al(op->s->priv->m);
+      qore_socket_private* sp = op->s->priv->socket->priv;
+      // a partially-established connection cannot be used
+      if (op->type == QoreSocketAsyncOp::AO_CONNECT && sp->sock == op->fd && sp->in_op) {
+         sp->close_internal();
+         op->fd = QORE_INVALID_SOCKET;
+      }
+      ExceptionSink xs;
+      complete(op, xs);
+   }
+   op->deref(xsink);
+   delete op;
+}
+
+void QoreSocketEventLoop::cancelAll(ExceptionSink* xsink) {
+   evloop_op_list_t tmp;
+   {
+      AutoLocker al(l);
+      for (evloop_id_map_t::iterator i = imap.begin(), e = imap.end(); i != e; ++i)
+         tmp.push_back(i->second);
+      imap.clear();
+      dmap.clear();
+      tmp.insert(tmp.end(), done.begin(), done.end());
+      done.clear();
+   }
+
+   for (evloop_op_list_t::iterator i = tmp.begin(), e = tmp.end(); i != e; ++i)
+      cancel(*i, xsink);
+}
+
+int QoreSocketEventLoop::start(QoreSocketAsyncOp* op, ExceptionSink* xsink) {
+   // try to complete the operation immediately
+   int rc = process(op);
+
+   {
+      AutoLocker al(l);
+      op->id = ++seq;
+      if (rc) {
+         done.push_back(op);
+         if (polling)
+            wakeup();
+         return 0;
+      }
+
+      if (!arm(op, xsink)) {
+         imap[op->id] = op;
+         if (op->timeout_ms >= 0) {
+            int64 deadline = q_clock_getmillis() + op->timeout_ms;
+            op->di = dmap.insert(evloop_deadline_map_t::value_type(deadline, op));
+            op->has_deadline = true;
+            if (polling && (poll_until < 0 || deadline < poll_until))
+               wakeup();
+         }
+         return 0;
+      }
+   }
+
+   cancel(op, xsink);
+   return -1;
+}
+
+int QoreSocketEventLoop::connect(QoreObject* obj, QoreSocketObject* s, const char* target, const ResolvedCallReferenceNode* cb, int timeout_ms, bool ssl, ExceptionSink* xsink) {
+   std::auto_ptr<QoreSocketAsyncOp> op(new QoreSocketAsyncOp(QoreSocketAsyncOp::AO_CONNECT, obj, s, cb, timeout_ms));
+   op->ssl = ssl;
+
+   // the target is interpreted like with Socket::connect()
+   int family = AF_UNSPEC;
+   const char* p = strrchr(target, ':');
+   if (p) {
+      op->host.assign(target, p - target);
+      op->service = p + 1;
+      if (op->host.size() > 2 && op->host[0] == '[' && op->host[op->host.size() - 1] == ']') {
+         op->host = op->host.substr(1, op->host.size() - 2);
+         family = AF_INET6;
+      }
+   }
+   else {
+#ifdef _Q_WINDOWS
+      xsink->raiseException("SOCKET-CONNECTUNIX-ERROR", "UNIX sockets are not available under Windows");
+      op->deref(xsink);
+      return -1;
+#else
+      op->host = target;
+      QoreDnsAddr a;
+      memset(&a, 0, sizeof(a));
+      struct sockaddr_un* addr = (struct sockaddr_un*)&a.addr;
+      addr->sun_family = AF_UNIX;
+      strncpy(addr->sun_path, target, sizeof(addr->sun_path) - 1);
+      a.addrlen = sizeof(struct sockaddr_un);
+      a.family = AF_UNIX;
+      a.socktype = SOCK_STREAM;
+      op->addrs.push_back(a);
+#endif
+   }
+
+   {
+      AutoLocker al(s->priv->m);
+      if (claim(op.get(), false, xsink)) {
+         op->deref(xsink);
+         return -1;
+      }
+      if (p)
+         s->priv->socket->priv->do_resolve_event(op->host.c_str(), op->service.c_str());
+   }
+
+   // the name is resolved synchronously through the process-wide DNS cache
+   if (p) {
+      int rc = qore_dns_cache.lookup(xsink, op->host.c_str(), op->service.c_str(), family, SOCK_STREAM, 0, op->addrs);
+      AutoLocker al(s->priv->m);
+      qore_socket_private* sp = s->priv->socket->priv;
+      if (rc) {
+         ExceptionSink xs;
+         complete(op.get(), xs);
+         op->deref(xsink);
+         return -1;
+      }
+      if (sp->cb_queue)
+         for (dns_addr_list_t::iterator i = op->addrs.begin(), e = op->addrs.end(); i != e; ++i)
+            sp->do_resolved_event((struct sockaddr*)&i->addr);
+   }
+
+   return start(op.release(), xsink);
+}
+
+int QoreSocketEventLoop::recv(QoreObject* obj, QoreSocketObject* s, int64 size, const ResolvedCallReferenceNode* cb, int timeout_ms, ExceptionSink* xsink) {
+   std::auto_ptr<QoreSocketAsyncOp> op(new QoreSocketAsyncOp(QoreSocketAsyncOp::AO_RECV, obj, s, cb, timeout_ms));
+   op->size = size;
+   op->data = new BinaryNode;
+
+   {
+      AutoLocker al(s->priv->m);
+      if (claim(op.get(), true, xsink)) {
+         op->deref(xsink);
+         return -1;
+      }
+   }
+
+   return start(op.release(), xsink);
+}
+
+int QoreSocketEventLoop::send(QoreObject* obj, QoreSocketObject* s, const AbstractQoreNode* data, const ResolvedCallReferenceNode* cb, int timeout_ms, ExceptionSink* xsink) {
+   std::auto_ptr<QoreSocketAsyncOp> op(new QoreSocketAsyncOp(QoreSocketAsyncOp::AO_SEND, obj, s, cb, timeout_ms));
+
+   {
+      AutoLocker al(s->priv->m);
+      if (get_node_type(data) == NT_STRING) {
+         // strings are sent in the socket's encoding
+         const QoreStringNode* str = reinterpret_cast<const QoreStringNode*>(data);
+         const QoreEncoding* enc = s->priv->socket->priv->enc;
+         QoreStringNode* cstr = str->getEncoding() == enc ? str->stringRefSelf() : str->convertEncoding(enc, xsink);
+         if (!cstr) {
+            op->deref(xsink);
+            return -1;
+         }
+         op->sdata = cstr;
+         op->sbuf = cstr->getBuffer();
+         op->slen = cstr->strlen();
+      }
+      else {
+         const BinaryNode* b = reinterpret_cast<const BinaryNode*>(data);
+         op->sdata = b->refSelf();
+         op->sbuf = (const char*)b->getPtr();
+         op->slen = b->size();
+      }
+
+      if (claim(op.get(), true, xsink)) {
+         op->deref(xsink);
+         return -1;
+      }
+   }
+
+   return start(op.release(), xsink);
+}
+
+int QoreSocketEventLoop::runCallbacks(ExceptionSink* xsink) {
+   int rv = 0;
+   while (true) {
+      QoreSocketAsyncOp* op;
+      {
+         AutoLocker al(l);
+         if (done.empty())
+            break;
+         op = done.front();
+         done.pop_front();
+      }
+
+      ReferenceHolder<ResolvedCallReferenceNode> cb(op->cb, xsink);
+      op->cb = 0;
+      ReferenceHolder<QoreListNode> args(new QoreListNode, xsink);
+      args->push(op->getHash(xsink));
+      op->deref(xsink);
+      delete op;
+
+      cb->execValue(*args, xsink).discard(xsink);
+      ++rv;
+      // the remaining callbacks are run with the next call
+      if (*xsink)
+         break;
+   }
+   return rv;
+}
+
+int QoreSocketEventLoop::runIntern(int64 timeout_ms, ExceptionSink* xsink) {
+   std::vector<int64> ready;
+   evloop_op_list_t expired;
+   {
+      AutoLocker al(l);
+      if (done.empty() && !stop_req && pollIntern(timeout_ms < 0 ? -1 : q_clock_getmillis() + timeout_ms, ready, expired, xsink))
+         return -1;
+   }
+
+   for (evloop_op_list_t::iterator i = expired.begin(), e = expired.end(); i != e; ++i) {
+      process(*i);
+      AutoLocker al(l);
+      done.push_back(*i);
+   }
+
+   for (std::vector<int64>::iterator i = ready.begin(), e = ready.end(); i != e; ++i) {
+      QoreSocketAsyncOp* op;
+      {
+         AutoLocker al(l);
+         // ignore operations that timed out in the same poll
+         evloop_id_map_t::iterator mi = imap.find(*i);
+         if (mi == imap.end())
+            continue;
+         op = mi->second;
+      }
+
+      int rc = process(op);
+      // the socket was closed and the operation has already been queued for its callback
+      if (rc < 0)
+         continue;
+      ExceptionSink xs;
+      {
+         AutoLocker al(l);
+         if (!rc && !arm(op, &xs))
+            continue;
+         detach(op);
+      }
+      if (xs) {
+         // the socket could not be monitored; the operation fails with the error
+         AutoLocker sal(op->s->priv->m);
+         complete(op, xs);
+      }
+      AutoLocker al(l);
+      done.push_back(op);
+   }
+
+   return runCallbacks(xsink);
+}
+
+int QoreSocketEventLoop::enter(ExceptionSink* xsink) {
+   AutoLocker al(l);
+   if (run_tid) {
+      xsink->raiseException("SOCKET-EVENT-LOOP-ERROR", "the event loop is already being run by TID %d", run_tid);
+      return -1;
+   }
+   run_tid = q_gettid();
+   return 0;
+}
+
+void QoreSocketEventLoop::exit() {
+   AutoLocker al(l);
+   run_tid = 0;
+   stop_req = false;
+}
+
+int QoreSocketEventLoop::runOnce(int64 timeout_ms, ExceptionSink* xsink) {
+   if (enter(xsink))
+      return -1;
+   int rc = runIntern(timeout_ms, xsink);
+   exit();
+   return rc;
+}
+
+void QoreSocketEventLoop::run(ExceptionSink* xsink) {
+   if (enter(xsink))
+      return;
+   while (true) {
+      {
+         AutoLocker al(l);
+         if (stop_req)
+            break;
+      }
+      if (runIntern(-1, xsink) < 0 || *xsink)
+         break;
+   }
+   exit();
+}
+
+void QoreSocketEventLoop::stop() {
+   AutoLocker al(l);
+   if (!run_tid)
+      return;
+   stop_req = true;
+   if (polling)
+      wakeup();
+}
+
+void QoreSocketEventLoop::closed(QoreSocketAsyncOp* op) {
+   QoreSocketEventLoop* loop = op->loop;
+   AutoLocker al(loop->l);
+   // operations being processed or already completed detect the closed socket themselves
+   if (loop->imap.find(op->id) == loop->imap.end())
+      return;
+   loop->detach(op);
+   op->fd = QORE_INVALID_SOCKET;
+   ExceptionSink xs;
+   xs.raiseException("SOCKET-CLOSED", "error in Socket::%s(): the socket was closed while the operation was in progress", op->getMethodName());
+   complete(op, xs);
+   loop->done.push_back(op);
+   if (loop->polling)
+      loop->wakeup();
+}
+
+int64 QoreSocketEventLoop::size() {
+   AutoLocker al(l);
+   return imap.size() + done.size();
+}
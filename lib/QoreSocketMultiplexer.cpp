@@ -0,0 +1,428 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+  Qore Programming Language
+
+  Copyright (C) 2003 - 2015 David Nichols
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+
+  Note that the Qore library is released under a choice of three open-source
+  licenses: MIT (as above), LGPL 2+, or GPL 2+; see README-LICENSE for more
+  information.
+*/
+
+#include <qore/Qore.h>
+#include <qore/intern/QC_Socket.h>
+#include <qore/intern/qore_socket_private.h>
+#include <qore/intern/QoreSocketMultiplexer.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef QORE_MUX_EPOLL
+#include <poll.h>
+#include <vector>
+#endif
+
+QoreHashNode* QoreSocketMuxEntry::getHash(ExceptionSink* xsink) {
+   QoreHashNode* h = new QoreHashNode;
+   h->setKeyValue("socket", obj, xsink);
+   h->setKeyValue("arg", arg, xsink);
+   h->setKeyValue("timeout", get_bool_node(timeout), xsink);
+   obj = 0;
+   arg = 0;
+   s->deref(xsink);
+   s = 0;
+   return h;
+}
+
+void QoreSocketMuxEntry::deref(ExceptionSink* xsink) {
+   if (s)
+      s->deref(xsink);
+   if (obj)
+      obj->deref(xsink);
+   if (arg)
+      arg->deref(xsink);
+}
+
+static int mux_set_fd_flags(int fd) {
+   return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) || fcntl(fd, F_SETFD, FD_CLOEXEC) ? -1 : 0;
+}
+
+QoreSocketMultiplexer::QoreSocketMultiplexer(ExceptionSink* xsink) : seq(0), poll_until(-1),
+#ifdef QORE_MUX_EPOLL
+   epfd(-1),
+#endif
+   polling(false), stopped(false) {
+   wake_fd[0] = wake_fd[1] = -1;
+
+#ifdef _Q_WINDOWS
+   xsink->raiseException("SOCKET-MULTIPLEXER-ERROR", "the SocketMultiplexer class is not supported on this platform");
+#else
+   if (pipe(wake_fd) || mux_set_fd_flags(wake_fd[0]) || mux_set_fd_flags(wake_fd[1])) {
+      xsink->raiseErrnoException("SOCKET-MULTIPLEXER-ERROR", errno, "cannot create wakeup pipe");
+      return;
+   }
+
+#ifdef QORE_MUX_EPOLL
+   epfd = epoll_create(QORE_MUX_MAX_EVENTS);
+   if (epfd < 0 || fcntl(epfd, F_SETFD, FD_CLOEXEC)) {
+      xsink->raiseErrnoException("SOCKET-MULTIPLEXER-ERROR", errno, "cannot create epoll descriptor");
+      return;
+   }
+   // the wakeup pipe is identified by ID 0; entry IDs start at 1
+   struct epoll_event ev;
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.u64 = 0;
+   if (epoll_ctl(epfd, EPOLL_CTL_ADD, wake_fd[0], &ev))
+      xsink->raiseErrnoException("SOCKET-MULTIPLEXER-ERROR", errno, "cannot add wakeup pipe to the epoll descriptor");
+#endif
+#endif
+}
+
+QoreSocketMultiplexer::~QoreSocketMultiplexer() {
+   assert(smap.empty());
+#ifdef QORE_MUX_EPOLL
+   if (epfd >= 0)
+      ::close(epfd);
+#endif
+   if (wake_fd[0] >= 0)
+      ::close(wake_fd[0]);
+   if (wake_fd[1] >= 0)
+      ::close(wake_fd[1]);
+}
+
+void QoreSocketMultiplexer::deref(ExceptionSink* xsink) {
+   if (ROdereference()) {
+      discard(stop(xsink), xsink);
+      delete this;
+   }
+}
+
+void QoreSocketMultiplexer::wakeup() {
+   char c = 0;
+   // if the pipe is full, then the polling thread will wake up anyway
+   if (::write(wake_fd[1], &c, 1) < 0) {
+   }
+}
+
+void QoreSocketMultiplexer::detach(QoreSocketMuxEntry* e) {
+   // the kernel registration is left as it is; see add()
+   imap.erase(e->id);
+   if (e->has_deadline) {
+      dmap.erase(e->di);
+      e->has_deadline = false;
+   }
+}
+
+void QoreSocketMultiplexer::unpark(QoreSocketObject* s) {
+   AutoLocker al(s->priv->m);
+   if (s->priv->mux == this)
+      s->priv->mux = 0;
+}
+
+void QoreSocketMultiplexer::expire(int64 now) {
+   while (!dmap.empty() && dmap.begin()->first <= now) {
+      QoreSocketMuxEntry* e = dmap.begin()->second;
+      detach(e);
+      e->timeout = true;
+      ready.push_back(e);
+   }
+}
+
+int QoreSocketMultiplexer::pollIntern(int64 until, ExceptionSink* xsink) {
+   int64 now = q_clock_getmillis();
+   // wake up at the earliest idle timeout at the latest
+   int64 wake = until;
+   if (!dmap.empty() && (wake < 0 || dmap.begin()->first < wake))
+      wake = dmap.begin()->first;
+   int to = wake < 0 ? -1 : (wake <= now ? 0 : (wake - now > INT_MAX ? INT_MAX : (int)(wake - now)));
+
+   polling = true;
+   poll_until = wake;
+
+   int rc, err;
+#ifdef QORE_MUX_EPOLL
+   struct epoll_event ev[QORE_MUX_MAX_EVENTS];
+   {
+      AutoUnlocker al(l);
+      rc = epoll_wait(epfd, ev, QORE_MUX_MAX_EVENTS, to);
+      err = errno;
+   }
+#else
+   // the poll() set is rebuilt for each call; this is only used where epoll is not available
+   std::vector<struct pollfd> pfd;
+   std::vector<int64> ids;
+   pfd.reserve(imap.size() + 1);
+   ids.reserve(imap.size());
+   struct pollfd p;
+   p.fd = wake_fd[0];
+   p.events = POLLIN;
+   p.revents = 0;
+   pfd.push_back(p);
+   for (mux_id_map_t::iterator i = imap.begin(), e = imap.end(); i != e; ++i) {
+      p.fd = i->second->fd;
+      pfd.push_back(p);
+      ids.push_back(i->first);
+   }
+   {
+      AutoUnlocker al(l);
+      rc = ::poll(&pfd[0], pfd.size(), to);
+      err = errno;
+   }
+#endif
+   polling = false;
+   poll_until = -1;
+
+   if (rc < 0) {
+      if (err == EINTR)
+         return 0;
+      xsink->raiseErrnoException("SOCKET-MULTIPLEXER-ERROR", err, "error waiting for socket events");
+      return -1;
+   }
+
+   bool woken = false;
+#ifdef QORE_MUX_EPOLL
+   for (int i = 0; i < rc; ++i) {
+      if (!ev[i].data.u64) {
+         woken = true;
+         continue;
+      }
+      mux_id_map_t::iterator mi = imap.find((int64)ev[i].data.u64);
+#else
+   if (rc && pfd[0].revents)
+      woken = true;
+   for (unsigned i = 1; rc && i < pfd.size(); ++i) {
+      if (!pfd[i].revents)
+         continue;
+      mux_id_map_t::iterator mi = imap.find(ids[i - 1]);
+#endif
+      // ignore sockets removed while polling
+      if (mi == imap.end())
+         continue;
+      QoreSocketMuxEntry* e = mi->second;
+      detach(e);
+      ready.push_back(e);
+   }
+
+   if (woken) {
+      char buf[64];
+      while (::read(wake_fd[0], buf, sizeof(buf)) > 0) {
+      }
+   }
+
+   expire(q_clock_getmillis());
+   return 0;
+}
+
+int QoreSocketMultiplexer::add(QoreObject* obj, QoreSocketObject* s, AbstractQoreNode* arg, int64 idle_timeout_ms, ExceptionSink* xsink) {
+   ReferenceHolder<AbstractQoreNode> holder(arg, xsink);
+   ReferenceHolder<QoreSocketObject> sh(s, xsink);
+
+   // the socket's lock is held until the socket is parked so that it cannot be closed in the meantime; see closed()
+   AutoLocker sal(s->priv->m);
+   int fd = s->priv->socket->getSocket();
+   if (fd < 0) {
+      xsink->raiseException("SOCKET-MULTIPLEXER-ERROR", "cannot add a socket that is not open");
+      return -1;
+   }
+   bool buffered = s->priv->socket->priv->hasBufferedData();
+
+   AutoLocker al(l);
+   if (stopped) {
+      xsink->raiseException("SOCKET-MULTIPLEXER-ERROR", "the SocketMultiplexer has been stopped");
+      return -1;
+   }
+   if (smap.find(s) != smap.end()) {
+      xsink->raiseException("SOCKET-MULTIPLEXER-ERROR", "the socket has already been added to the SocketMultiplexer");
+      return -1;
+   }
+
+   // data already read from the socket will not be signaled by the kernel
+   if (buffered) {
+      QoreSocketMuxEntry* e = new QoreSocketMuxEntry(obj, sh.release(), holder.release(), ++seq, fd);
+      obj->ref();
+      smap[s] = e;
+      s->priv->mux = this;
+      ready.push_back(e);
+      cond.signal();
+      if (polling)
+         wakeup();
+      return 0;
+   }
+
+   int64 id = ++seq;
+#ifdef QORE_MUX_EPOLL
+   // sockets are registered as one-shot events and are never removed explicitly: a registration that has fired is
+   // disabled until the socket is added again, and the kernel removes registrations when the socket is closed, so
+   // removing descriptors here could affect a new socket that has been given the same descriptor number; events for
+   // registrations that are still armed after their entry has been removed are ignored
+   struct epoll_event ev;
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN | EPOLLONESHOT;
+   ev.data.u64 = id;
+   if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) && (errno != ENOENT || epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev))) {
+      xsink->raiseErrnoException("SOCKET-MULTIPLEXER-ERROR", errno, "cannot add socket to the epoll descriptor");
+      return -1;
+   }
+#endif
+
+   QoreSocketMuxEntry* e = new QoreSocketMuxEntry(obj, sh.release(), holder.release(), id, fd);
+   obj->ref();
+   smap[s] = e;
+   imap[id] = e;
+   s->priv->mux = this;
+   if (idle_timeout_ms > 0) {
+      int64 deadline = q_clock_getmillis() + idle_timeout_ms;
+      e->di = dmap.insert(mux_deadline_map_t::value_type(deadline, e));
+      e->has_deadline = true;
+#ifdef QORE_MUX_EPOLL
+      if (polling && (poll_until < 0 || deadline < poll_until))
+         wakeup();
+#endif
+   }
+#ifndef QORE_MUX_EPOLL
+   // the polling thread must rebuild its poll() set
+   if (polling)
+      wakeup();
+#endif
+   return 0;
+}
+
+void QoreSocketMultiplexer::closed(QoreSocketObject* s) {
+   AutoLocker al(l);
+   mux_socket_map_t::iterator i = smap.find(s);
+   if (i == smap.end() || imap.find(i->second->id) == imap.end())
+      return;
+   detach(i->second);
+   ready.push_back(i->second);
+   cond.signal();
+   // the polling thread must take the socket if it is the only waiting thread and, with poll(), rebuild its poll() set
+   if (polling)
+      wakeup();
+}
+
+bool QoreSocketMultiplexer::remove(QoreSocketObject* s, ExceptionSink* xsink) {
+   QoreSocketMuxEntry* e;
+   {
+      AutoLocker al(l);
+      mux_socket_map_t::iterator i = smap.find(s);
+      if (i == smap.end())
+         return false;
+      e = i->second;
+      smap.erase(i);
+      if (imap.find(e->id) != imap.end())
+         detach(e);
+      else {
+         for (mux_ready_list_t::iterator ri = ready.begin(), re = ready.end(); ri != re; ++ri) {
+            if (*ri == e) {
+               ready.erase(ri);
+               break;
+            }
+         }
+      }
+   }
+
+   unpark(s);
+   // references are released outside the lock in case they are objects with destructors
+   e->deref(xsink);
+   delete e;
+   return true;
+}
+
+QoreHashNode* QoreSocketMultiplexer::wait(int64 timeout_ms, ExceptionSink* xsink) {
+   int64 until = timeout_ms < 0 ? -1 : q_clock_getmillis() + timeout_ms;
+
+   QoreSocketMuxEntry* e = 0;
+   {
+      AutoLocker al(l);
+      while (true) {
+         if (!ready.empty()) {
+            e = ready.front();
+            ready.pop_front();
+            smap.erase(e->s);
+            break;
+         }
+         if (stopped)
+            break;
+
+         int64 now = q_clock_getmillis();
+         if (until >= 0 && now >= until)
+            break;
+
+         // only one thread polls the kernel; the others wait until sockets are ready or polling is free
+         if (polling) {
+            if (until < 0)
+               cond.wait(l);
+            else
+               cond.wait2(l, until - now);
+            continue;
+         }
+
+         if (pollIntern(until, xsink))
+            break;
+      }
+
+      // wake up another thread to take the next ready socket or to take over polling
+      if (!stopped && (!ready.empty() || !polling))
+         cond.signal();
+   }
+
+   if (!e)
+      return 0;
+
+   unpark(e->s);
+   QoreHashNode* rv = e->getHash(xsink);
+   delete e;
+   return rv;
+}
+
+QoreListNode* QoreSocketMultiplexer::stop(ExceptionSink* xsink) {
+   mux_socket_map_t tmp;
+   {
+      AutoLocker al(l);
+      stopped = true;
+      for (mux_socket_map_t::iterator i = smap.begin(), e = smap.end(); i != e; ++i) {
+         if (imap.find(i->second->id) != imap.end())
+            detach(i->second);
+      }
+      tmp.swap(smap);
+      ready.clear();
+      cond.broadcast();
+      if (polling)
+         wakeup();
+   }
+
+   ReferenceHolder<QoreListNode> rv(new QoreListNode, xsink);
+   for (mux_socket_map_t::iterator i = tmp.begin(), e = tmp.end(); i != e; ++i) {
+      unpark(i->second->s);
+      rv->push(i->second->getHash(xsink));
+      delete i->second;
+   }
+   return rv.release();
+}
+
+int64 QoreSocketMultiplexer::size() {
+   AutoLocker al(l);
+   return smap.size();
+}
@@ -34,6 +34,8 @@
 #include <qore/QoreSocketObject.h>
 #include <qore/intern/qore_socket_private.h>
 #include <qore/intern/QC_Socket.h>
+#include <qore/intern/QoreSocketMultiplexer.h>
+#include <qore/intern/QoreSocketEventLoop.h>
 #include <qore/intern/QC_SSLCertificate.h>
 #include <qore/intern/QC_SSLPrivateKey.h>
 
@@ -155,6 +157,12 @@ int QoreSocketObject::send(int fd, int size) {
    return priv->socket->send(fd, size);
 }
 
+// send file data from an offset
+int QoreSocketObject::sendFile(int fd, int64 offset, int64 size, int timeout_ms, ExceptionSink* xsink) {
+   AutoLocker al(priv->m);
+   return priv->socket->sendFile(fd, offset, size, timeout_ms, xsink);
+}
+
 // send bytes and convert to network order
 int QoreSocketObject::sendi1(char b, int timeout_ms, ExceptionSink* xsink) {
    AutoLocker al(priv->m);
@@ -371,6 +379,16 @@ int QoreSocketObject::getRecvTimeout() {
 
 int QoreSocketObject::close() { 
    AutoLocker al(priv->m);
+   // a parked socket is returned by the multiplexer, as the kernel stops monitoring it when it is closed
+   if (priv->mux) {
+      priv->mux->closed(this);
+      priv->mux = 0;
+   }
+   // a pending asynchronous operation fails, as the kernel stops monitoring the socket when it is closed
+   if (priv->async_op) {
+      QoreSocketEventLoop::closed(priv->async_op);
+      priv->async_op = 0;
+   }
    return priv->socket->close();
 }
 
@@ -498,6 +516,28 @@ QoreSocketObject* QoreSocketObject::acceptSSL(int timeout_ms, ExceptionSink* xsi
    return s ? new QoreSocketObject(s, priv->cert ? priv->cert->certRefSelf() : 0, priv->pk ? priv->pk->pkRefSelf() : 0) : 0;
 }
 
+int QoreSocketObject::acceptMany(std::vector<QoreSocketObject*>& l, int max, int timeout_ms, ExceptionSink* xsink) {
+   std::vector<QoreSocket*> sl;
+   int rc;
+   {
+      AutoLocker al(priv->m);
+      rc = priv->socket->acceptMany(sl, max, timeout_ms, xsink);
+   }
+   for (std::vector<QoreSocket*>::iterator i = sl.begin(), e = sl.end(); i != e; ++i)
+      l.push_back(new QoreSocketObject(*i, priv->cert ? priv->cert->certRefSelf() : 0, priv->pk ? priv->pk->pkRefSelf() : 0));
+   return rc;
+}
+
+QoreListNode* QoreSocketObject::recvDatagrams(int max, int size, int timeout_ms, ExceptionSink* xsink) {
+   AutoLocker al(priv->m);
+   return priv->socket->recvDatagrams(max, size, timeout_ms, xsink);
+}
+
+int QoreSocketObject::sendDatagrams(const QoreListNode* l, ExceptionSink* xsink) {
+   AutoLocker al(priv->m);
+   return priv->socket->sendDatagrams(l, xsink);
+}
+
 // c must be already referenced before this call
 void QoreSocketObject::setCertificate(QoreSSLCertificate* c) {
    AutoLocker al(priv->m);
@@ -549,6 +589,16 @@ int QoreSocketObject::getNoDelay() {
    return priv->socket->getNoDelay();
 }
 
+int QoreSocketObject::setReusePort(bool b) {
+   AutoLocker al(priv->m);
+   return priv->socket->setReusePort(b);
+}
+
+bool QoreSocketObject::getReusePort() {
+   AutoLocker al(priv->m);
+   return priv->socket->getReusePort();
+}
+
 QoreHashNode* QoreSocketObject::getPeerInfo(ExceptionSink* xsink, bool host_lookup) const {
    AutoLocker al(priv->m);
    return priv->socket->getPeerInfo(xsink, host_lookup);
@@ -130,12 +130,8 @@ int RWLock::grabImpl(int mtid, VLock *nvl, ExceptionSink *xsink, int64 timeout_m
    }
    while (tid >= 0 || (tid == Lock_Unlocked && num_readers)) {
       ++waiting;
-      int rc;
-      // if the write lock is grabbed, send vl (only one thread owns the lock)
-      if (tid >= 0)
-	 rc = nvl->waitOn((AbstractSmartLock *)this, vl, xsink, timeout_ms);
-      else  // otherwise the read lock is grabbed, so send vmap (many threads own the lock) 
-	 rc = nvl->waitOn((AbstractSmartLock *)this, vmap, xsink, timeout_ms);
+      // send vmap, as the lock can be held by the writer or by many readers
+      int rc = nvl->waitOn((AbstractSmartLock *)this, vmap, xsink, timeout_ms);
       --waiting;
       if (rc)
 	 return -1;
@@ -172,7 +168,7 @@ void RWLock::signalImpl() {
 void RWLock::destructorImpl(ExceptionSink *xsink) {
    cond_map_t::iterator i = cmap.begin(), e = cmap.end();
    if (i != e) {
-      xsink->raiseException("RWLOCK-ERROR", "%s object deleted in TID %d while one or more Condition variables were waiting on it", getName(), gettid());
+      xsink->raiseException("RWLOCK-ERROR", "%s object deleted in TID %d while one or more Condition variables were waiting on it", getName(), q_gettid());
       // wake up all condition variables waiting on this mutex
       for (; i != e; i++)
          i->first->broadcast();
@@ -214,7 +210,7 @@ int RWLock::releaseImpl() {
       if (!--num_readers && waiting)
 	 asl_cond.signal();
 
-      int mtid = gettid();
+      int mtid = q_gettid();
       // remove reader for this thread
       tid_map_t::iterator ti = tmap.find(mtid);
       assert(ti != tmap.end());
@@ -233,7 +229,7 @@ int RWLock::releaseImpl() {
 void RWLock::cleanupImpl() {
    // if it was a read lock
    if (num_readers) {
-      int mtid = gettid();
+      int mtid = q_gettid();
       // remove reader for this thread
       vlock_map_t::iterator vi = vmap.find(mtid);
 
@@ -261,10 +257,13 @@ void RWLock::cleanupImpl() {
    }
    else if (tid >= 0) { // if it was the write lock
       // this thread must own the lock
-      assert(tid == gettid());
+      assert(tid == q_gettid());
       // mark lock as unlocked
       tid = -1;
 
+      if (stats)
+         stats->released();
+
       // delete entry from the thread lock list
       vl->pop(this);
       
@@ -275,7 +274,7 @@ void RWLock::cleanupImpl() {
 }
 
 int RWLock::releaseImpl(ExceptionSink *xsink) {
-   int mtid = gettid();
+   int mtid = q_gettid();
    if (tid == Lock_Deleted) {
       xsink->raiseException("LOCK-ERROR", "The %s object has been deleted in another thread", getName());
       return -1;
@@ -322,7 +321,7 @@ void RWLock::mark_read_lock_intern(int mtid, VLock *nvl) {
 }
 
 int RWLock::readLock(ExceptionSink *xsink, int64 timeout_ms) {
-   int mtid = gettid();
+   int mtid = q_gettid();
    VLock *nvl = getVLock();
    SafeLocker sl(&asl_lock);
 
@@ -331,7 +330,13 @@ int RWLock::readLock(ExceptionSink *xsink, int64 timeout_ms) {
       return -1;
    }
 
-   return grab_read_lock_intern(mtid, nvl, timeout_ms, xsink);
+   int rc = grab_read_lock_intern(mtid, nvl, timeout_ms, xsink);
+   if (stats) {
+      int64 wait_start = nvl->takeWaitStart();
+      if (!rc)
+         stats->acquiredShared(wait_start);
+   }
+   return rc;
 }
 
 // assumes the write lock is not grabbed by this thread
@@ -340,7 +345,7 @@ int RWLock::grab_read_lock_intern(int mtid, VLock *nvl, int64 timeout_ms, Except
       do {
 	 ++readRequests;
 	 int rc;
-	 rc = nvl->waitOn((AbstractSmartLock *)this, &read, vl, xsink, timeout_ms);
+	 rc = nvl->waitOn((AbstractSmartLock *)this, &read, xsink, timeout_ms);
 	 --readRequests;
 	 if (rc)
 	    return -1;
@@ -379,7 +384,7 @@ void RWLock::release_read_lock_intern(tid_map_t::iterator i) {
 }
 
 int RWLock::readUnlock(ExceptionSink* xsink) {
-   int mtid = gettid();
+   int mtid = q_gettid();
    AutoLocker al(&asl_lock);
    if (tid == mtid) {
       xsink->raiseException("LOCK-ERROR", "TID %d called %s::readUnlock() while holding the write lock", mtid, getName());
@@ -406,7 +411,9 @@ int RWLock::tryReadLock() {
    if (tid != Lock_Unlocked)
       return -1;
 
-   mark_read_lock_intern(gettid(), getVLock());
+   mark_read_lock_intern(q_gettid(), getVLock());
+   if (stats)
+      stats->acquiredShared(0);
 
    return 0;
 }
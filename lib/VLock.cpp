@@ -145,97 +145,95 @@ void AutoVLock::addMemberNotification(QoreObject *obj, const char *member) {
    priv->add(obj, member);
 }
 
-int VLock::waitOn(AbstractSmartLock *asl, VLock *vl, ExceptionSink *xsink, int timeout_ms) {
-   waiting_on = asl;
-   
-   int rc = 0;
-   AbstractSmartLock *vl_wait = vl->waiting_on;
-   //printd(5, "VLock::waitOn(asl=%p) vl_wait=%p other_tid=%d\n", asl, vl_wait, vl->tid);
-   if (vl_wait && find(vl_wait)) {
-      // NOTE: we throw an exception here anyway as a deadlock is a programming mistake and therefore should be visible to the programmer
-      // (even if it really wouldn't technically deadlock at this point due to the timeout)
-      if (timeout_ms)
-	 xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d would deadlock on the same resources; this represents a programming error so even though a %s method was called with a timeout and therefore would not technically deadlock at this point, this exception is thrown anyway.", vl->tid, tid, asl->getName());
-      else
-	 xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d have deadlocked trying to acquire the same resources", vl->tid, tid);
-      rc = -1;
+// serializes deadlock checks so that only one thread in a cycle raises an exception
+static QoreThreadLock deadlock_lock;
+// the sequence of waits with deadlock detection
+static volatile int64 deadlock_wait_seq = 0;
+
+int VLock::checkDeadlock(AbstractSmartLock *asl, vlock_map_t *vmap, ExceptionSink *xsink, int64 timeout_ms) {
+   AutoLocker al(deadlock_lock);
+
+   // the lock may have changed hands while this thread was blocked, so the current owners are checked;
+   // they cannot release the lock or exit while asl_lock is held
+   VLock *vl = asl->get_vl();
+   if (!vl && vmap) {
+      for (vlock_map_t::iterator i = vmap->begin(), e = vmap->end(); i != e; ++i) {
+         AbstractSmartLock *vl_wait = i->second->getWaitingOn();
+         if (vl_wait && find(vl_wait)) {
+            vl = i->second;
+            break;
+         }
+      }
    }
-
-   if (!rc) {
-      //printd(0, "AbstractSmartLock::block() this=%p asl=%p about to block on VRMutex owned by TID %d\n", this, asl, vl ? vl->tid : -1);
-      rc = asl->self_wait(timeout_ms);
-      //printd(0, "AbstractSmartLock::block() this=%p asl=%p regrabbed lock\n", this, asl);
+   else if (vl) {
+      AbstractSmartLock *vl_wait = vl->getWaitingOn();
+      if (!vl_wait || !find(vl_wait))
+         vl = 0;
    }
-   
-   waiting_on = 0;
-   
-   return rc;
-}
+   //printd(5, "VLock::checkDeadlock(asl=%p) deadlock with tid=%d\n", asl, vl ? vl->tid : -1);
+   if (!vl)
+      return 0;
 
-int VLock::waitOn(AbstractSmartLock *asl, QoreCondition *cond, VLock *vl, ExceptionSink *xsink, int timeout_ms) {
-   waiting_on = asl;
-
-   int rc = 0;
-   AbstractSmartLock *vl_wait = vl->waiting_on;
-   //printd(5, "VLock::waitOn(asl=%p) vl_wait=%p other_tid=%d\n", asl, vl_wait, vl->tid);
-   if (vl_wait && find(vl_wait)) {
-      // NOTE: we throw an exception here anyway as a deadlock is a programming mistake and therefore should be visible to the programmer
-      // (even if it really wouldn't technically deadlock at this point due to the timeout)
-      if (timeout_ms)
-	 xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d would deadlock on the same resources; this represents a programming error so even though a %s method was called with a timeout and therefore would not technically deadlock at this point, this exception is thrown anyway.", vl->tid, tid, asl->getName());
-      else
-	 xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d have deadlocked trying to acquire the same resources", vl->tid, tid);
-      rc = -1;
-   }
-   
-   if (!rc) {
-      //printd(0, "AbstractSmartLock::block() this=%p asl=%p about to block on VRMutex owned by TID %d\n", this, asl, vl ? vl->tid : -1);
-      rc = asl->self_wait(cond, timeout_ms);
-      //printd(0, "AbstractSmartLock::block() this=%p asl=%p regrabbed lock\n", this, asl);
-   }
+   // the other thread started waiting later, so its wait closed the cycle and it raises the exception when it
+   // checks; if it does not check for deadlocks, this thread raises the exception
+   int64 vl_seq = qore_atomic_get(&vl->wait_seq);
+   if (vl_seq > wait_seq)
+      return 0;
 
-   waiting_on = 0;
-   
-   return rc;
+   // this thread is no longer waiting once the exception has been raised, so the other thread in the cycle cannot
+   // find the deadlock again when it checks
+   qore_atomic_set(&waiting_on, (AbstractSmartLock *)0);
+
+   // NOTE: we throw an exception here anyway as a deadlock is a programming mistake and therefore should be visible to the programmer
+   // (even if it really wouldn't technically deadlock at this point due to the timeout)
+   if (timeout_ms)
+      xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d would deadlock on the same resources; this represents a programming error so even though a %s method was called with a timeout and therefore would not technically deadlock at this point, this exception is thrown anyway.", vl->tid, tid, asl->getName());
+   else
+      xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d have deadlocked trying to acquire the same resources", vl->tid, tid);
+   return -1;
 }
 
-int VLock::waitOn(AbstractSmartLock *asl, vlock_map_t &vmap, ExceptionSink *xsink, int timeout_ms) {
-   waiting_on = asl;
-
-   int rc = 0;
-   for (vlock_map_t::iterator i = vmap.begin(), e = vmap.end(); i != e; ++i) {
-      AbstractSmartLock *vl_wait = i->second->waiting_on;
-      //printd(5, "VLock::waitOn(asl=%p, vmap size=%d) vl_wait=%p other_tid=%d\n", asl, vmap.size(), vl_wait, i->second->tid);
-      if (vl_wait && find(vl_wait)) {
-	 // NOTE: we throw an exception here anyway as a deadlock is a programming mistake and therefore should be visible to the programmer
-	 // (even if it really wouldn't technically deadlock at this point due to the timeout)
-	 if (timeout_ms)
-	    xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d would deadlock on the same resources; this represents a programming error so even though a %s method was called with a timeout and therefore would not technically deadlock at this point, this exception is thrown anyway.", i->second->tid, tid, asl->getName());
-	 else
-	    xsink->raiseException("THREAD-DEADLOCK", "TID %d and %d have deadlocked trying to acquire the same resources", i->second->tid, tid);
-	 rc = -1;
-	 break;
+int VLock::waitIntern(AbstractSmartLock *asl, QoreCondition *cond, vlock_map_t *vmap, ExceptionSink *xsink, int64 timeout_ms) {
+   if (!cond)
+      cond = &asl->asl_cond;
+
+   startWait(asl);
+   bool detect = !runtime_check_parse_option(PO_NO_DEADLOCK_DETECTION);
+   // the sequence number is published before the lock being waited on, so it is valid for any thread that finds
+   // this thread waiting
+   qore_atomic_set(&wait_seq, detect ? qore_atomic_add(&deadlock_wait_seq, (int64)1) : (int64)0);
+   qore_atomic_set(&waiting_on, asl);
+
+   int rc;
+   if (!detect)
+      rc = asl->self_wait(cond, timeout_ms);
+   else {
+      // most waits are short, so the deadlock check is only made once the first wait has timed out; a deadlock with
+      // a thread that blocks later is detected by that thread
+      int64 first = timeout_ms && timeout_ms < QORE_DEADLOCK_CHECK_MS ? timeout_ms : QORE_DEADLOCK_CHECK_MS;
+      //printd(0, "VLock::waitIntern() this=%p asl=%p about to block\n", this, asl);
+      rc = asl->self_wait(cond, first);
+      if (rc) {
+         if (checkDeadlock(asl, vmap, xsink, timeout_ms))
+            rc = -1;
+         else if (timeout_ms != first)
+            rc = asl->self_wait(cond, timeout_ms ? timeout_ms - first : 0);
       }
-   }
-   
-   if (!rc) {
-      //printd(0, "AbstractSmartLock::block() this=%p asl=%p about to block on VRMutex owned by TID %d\n", this, asl, vl ? vl->tid : -1);
-      rc = asl->self_wait(timeout_ms);
-      //printd(0, "AbstractSmartLock::block() this=%p asl=%p regrabbed lock\n", this, asl);
+      //printd(0, "VLock::waitIntern() this=%p asl=%p regrabbed lock\n", this, asl);
    }
 
-   waiting_on = 0;
+   qore_atomic_set(&waiting_on, (AbstractSmartLock *)0);
 
    return rc;
 }
 
 #ifdef DEBUG
 void VLock::show(class VLock *vl) const {
-   //printd(0, "VLock::show() this=%p, vl=%p vl->waiting_on=%p (in this=%p)\n", this, vl, vl ? vl->waiting_on : 0, vl ? find(vl->waiting_on) : 0);
+   //printd(0, "VLock::show() this=%p, vl=%p vl->waiting_on=%p (in this=%p)\n", this, vl, vl ? vl->getWaitingOn() : 0, vl ? find(vl->getWaitingOn()) : 0);
 }
 #endif
 
-VLock::VLock(int n_tid) : waiting_on(0), tid(n_tid) {
+VLock::VLock(int n_tid) : waiting_on(0), wait_seq(0), tid(n_tid), wait_start(0) {
 }
 
 VLock::~VLock() {
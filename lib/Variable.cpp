@@ -106,6 +106,18 @@ const char* Var::getName() const {
 QoreValue Var::eval() const {
    if (val.type == QV_Ref)
       return val.v.getPtr()->eval();
+
+   // values of optimized scalar types are copied without side effects, so they can be read optimistically
+   // without locking and discarded if a writer acquired the lock in the meantime
+   if (val.optimized() && val.type != QV_Node) {
+      unsigned s;
+      if (rwl.readBegin(s)) {
+         QoreValue rv = val.getReferencedValue();
+         if (rwl.readValidate(s))
+            return rv;
+      }
+   }
+
    QoreAutoVarRWReadLocker al(rwl);
    return val.getReferencedValue();
 }
@@ -537,6 +549,11 @@ int LValueHelper::assign(QoreValue n, const char* desc) {
       return -1;
    }
 
+   // values assigned to locked lvalues (global and closure-bound variables and object members) can be
+   // accessed by other threads
+   if (vl && n.type == QV_Node)
+      q_share_value(n.v.n);
+
    if (val) {
       saveTemp(val->assign(n));
       return 0;
@@ -35,6 +35,7 @@
 
 #include <qore/intern/QoreSignal.h>
 #include <qore/intern/ModuleInfo.h>
+#include <qore/intern/QoreDnsCache.h>
 
 #include <stdio.h>
 #include <string.h>
@@ -117,6 +118,11 @@ void qore_init(qore_license_t license, const char *def_charset, bool show_module
    // init threading infrastructure
    init_qore_threads();
 
+   // enable the DNS cache if requested in the environment
+   const char* dns_ttl = getenv("QORE_DNS_CACHE_TTL");
+   if (dns_ttl && atoll(dns_ttl) > 0)
+      qore_dns_cache.set(atoll(dns_ttl), QORE_DNS_CACHE_DEFAULT_NEGATIVE_TTL, QORE_DNS_CACHE_DEFAULT_MAX_ENTRIES);
+
    // initialize charset encoding support
    QEM.init(def_charset);
 
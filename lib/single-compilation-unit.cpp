@@ -119,6 +119,12 @@
 #include "QoreRWLock.cpp"
 #include "AbstractSmartLock.cpp"
 #include "SmartMutex.cpp"
+#include "QoreCache.cpp"
+#include "QoreHttpConnectionPool.cpp"
+#include "QoreDnsCache.cpp"
+#include "QoreSocketMultiplexer.cpp"
+#include "QoreSocketEventLoop.cpp"
+#include "QoreLockStats.cpp"
 #ifdef QORE_RUNTIME_THREAD_STACK_TRACE
 #include "CallStack.cpp"
 #endif
@@ -142,7 +148,6 @@
 #include "QoreRegexBase.cpp"
 #include "RegexSubstNode.cpp"
 #include "RegexTransNode.cpp"
-#include "Sequence.cpp"
 #include "QoreReferenceCounter.cpp"
 #include "QoreHTTPClient.cpp"
 #include "QoreHttpClientObject.cpp"
@@ -213,6 +218,8 @@
 #include "qc_errno.cpp"
 #include "qc_qore.cpp"
 #include "QC_Socket.cpp"
+#include "QC_SocketMultiplexer.cpp"
+#include "QC_SocketEventLoop.cpp"
 #include "QC_Program.cpp"
 #include "QC_ReadOnlyFile.cpp"
 #include "QC_File.cpp"
@@ -256,10 +263,14 @@
 #include "QC_RWLock.cpp"
 #include "QC_Gate.cpp"
 #include "QC_Sequence.cpp"
+#include "QC_AtomicInteger.cpp"
+#include "QC_ConcurrentHash.cpp"
+#include "QC_Cache.cpp"
 #include "QC_Counter.cpp"
 #include "QC_SSLCertificate.cpp"
 #include "QC_SSLPrivateKey.cpp"
 #include "QC_HTTPClient.cpp"
+#include "QC_HTTPConnectionPool.cpp"
 #include "QC_AutoLock.cpp"
 #include "QC_AutoGate.cpp"
 #include "QC_AutoReadLock.cpp"
@@ -46,6 +46,7 @@
 #include <qore/intern/QC_RWLock.h>
 #include <qore/intern/QC_Gate.h>
 #include <qore/intern/QC_Sequence.h>
+#include <qore/intern/QC_AtomicInteger.h>
 #include <qore/intern/QC_Counter.h>
 #include <qore/intern/QC_AutoLock.h>
 #include <qore/intern/QC_AutoGate.h>
@@ -55,17 +56,15 @@
 
 #include <pthread.h>
 #include <sys/time.h>
+#include <unistd.h>
 #include <assert.h>
 
 #include <vector>
+#include <deque>
 #include <map>
 #include <set>
 #include <string>
 
-#if defined(__ia64) && defined(__LP64__)
-#define IA64_64
-#endif
-
 // global background thread counter
 QoreCounter thread_counter;
 
@@ -98,6 +97,8 @@ QorePThreadAttr ta_default;
 DLLLOCAL QoreThreadList thread_list;
 
 DLLLOCAL QoreClass* initThreadPoolClass(QoreNamespace& ns);
+DLLLOCAL QoreClass* initConcurrentHashClass(QoreNamespace& ns);
+DLLLOCAL QoreClass* initCacheClass(QoreNamespace& ns);
 
 const qore_class_private* ClassObj::getClass() const {
    if (!ptr)
@@ -108,343 +109,99 @@ const qore_class_private* ClassObj::getClass() const {
    return (const qore_class_private*)(ptr & ~1);
 }
 
-class ArgvRefStack {
-protected:
-   typedef std::vector<int> rvec_t;
-   rvec_t stack;
-   // ignore numeric count
-   int in;
-
-public:
-   DLLLOCAL ArgvRefStack() : in(0) {
-      stack.push_back(0);
-   }
-   DLLLOCAL ~ArgvRefStack() {
-   }
-   DLLLOCAL void push() {
-      stack.push_back(0);
-   }
-   DLLLOCAL int pop() {
-      int rc = stack[stack.size() - 1];
-      if (stack.size() > 1)
-	 stack.pop_back();
-      else
-	 stack[0] = 0;
-      return rc;
-   }
-   DLLLOCAL int get() {
-      assert(stack.size() == 1);
-      int rc = stack[0];
-      stack[0] = 0;
-      return rc;
-   }
-   DLLLOCAL void push_numeric() {
-      ++in;
-   }
-   DLLLOCAL void pop_numeric() {
-      --in;
-      assert(in >= 0);
-   }
-   DLLLOCAL void inc_numeric() {
-      if (in)
-	 return;
-      inc();
-   }
-   DLLLOCAL void inc() {
-      ++stack[stack.size() - 1];
-   }
-   DLLLOCAL void clear() {
-      stack.clear();
-      stack.push_back(0);
-   }
-};
-
-struct ParseCountHelper {
-   unsigned count;
-
-   DLLLOCAL ParseCountHelper() : count(0) {
-   }
-
-   DLLLOCAL void inc() {
-      ++count;
-   }
-
-   DLLLOCAL bool dec() {
-      if (!count) {
-         parse_error("unmatched %%endtry");
-         return false;
-      }
-      return !--count;
-   }
-
-   DLLLOCAL void purge() {
-      if (count) {
-         parse_error("%d %%try-module block%s left open at end of file", count, count == 1 ? "" : "s");
-         count = 0;
-      }
-   }
-};
-
-struct ParseConditionalStack {
-   unsigned count;
-   typedef std::vector<unsigned> ui_vec_t;
-   ui_vec_t markvec;
-
-   DLLLOCAL ParseConditionalStack() : count(0) {
-   }
-
-   DLLLOCAL void push(bool do_mark = false) {
-      if (do_mark) {
-         markvec.push_back(count);
-      }
-      ++count;
-   }
-
-   DLLLOCAL bool checkElse() {
-      return count;
-   }
-
-   DLLLOCAL bool test() const {
-      if (!count) {
-         parse_error("%%else without %%ifdef");
-         return false;
-      }
-      if (markvec.empty())
-         return false;
-      return markvec.back() == (count - 1);
-   }
-
-   DLLLOCAL bool pop() {
-      if (!count) {
-         parse_error("unmatched %%endif");
-         return false;
-      }
-      --count;
-      assert(!markvec.empty());
-      if (count == markvec.back()) {
-         markvec.pop_back();
-         return true;
-      }
-      return false;
-   }
-
-   DLLLOCAL void purge() {
-      if (count) {
-         parse_error("%d conditional block%s left open at end of file", count, count == 1 ? "" : "s");
-         count = 0;
-         markvec.clear();
-      }
-   }
-};
-
-class ProgramParseContext {
-public:
-   const char* file, * src;
-   void* parseState;
-   int offset;
-   ParseConditionalStack* pcs;
-   ProgramParseContext* next;
-
-   DLLLOCAL ProgramParseContext(const char* fname, void* ps, const char* psrc, int off, ParseConditionalStack* ppcs, ProgramParseContext* n) : file(fname), src(psrc), parseState(ps), offset(off), pcs(ppcs), next(n) {
-   }
-};
-
-// for detecting circular references at runtime
-typedef std::set<const lvalue_ref*> ref_set_t;
-
-// this structure holds all thread-specific data
-class ThreadData {
-public:
-   int64 runtime_po;
-   int tid;
-   VLock vlock;     // for deadlock detection
-   Context* context_stack;
-   ProgramParseContext* plStack;
-   QoreProgramLocation parse_loc;
-   QoreProgramLocation runtime_loc;
-   const char* parse_code; // the current function, method, or closure being parsed
-   void* parseState;
-   VNode* vstack;  // used during parsing (local variable stack)
-   CVNode* cvarstack;
-   QoreClass* parseClass; // current class being parsed
-   QoreException* catchException;
-   std::list<block_list_t::iterator> on_block_exit_list;
-   ThreadResourceList* trlist;
-
-   // for detecting circular references at runtime
-   ref_set_t ref_set;
-
-   // current function/method name
-   const char* current_code;
-
-   // current object context
-   ClassObj current_classobj;
-
-   // current program context
-   QoreProgram* current_pgm;
-
-   // current namespace context for parsing
-   qore_ns_private* current_ns;
-
-   // current implicit argument
-   QoreListNode* current_implicit_arg;
-
-   // this data structure is stored in the current Program object on a per-thread basis
-   ThreadLocalProgramData* tlpd;
-
-   // this data structure contains the set of Program objects that this thread has data in
-   ThreadProgramData* tpd;
-
-   // current parsing closure environment
-   ClosureParseEnvironment* closure_parse_env;
-
-   // current runtime closure environment
-   const QoreClosureBase* closure_rt_env;
-
-   ArgvRefStack argv_refs;
-
-#ifdef QORE_MANAGE_STACK
-   size_t stack_limit;
-#ifdef IA64_64
-   size_t rse_limit;
-#endif
-#endif
-
-   // used to detect output of recursive data structures at runtime
-   const_node_set_t node_set;
-
-   // currently-executing/parsing block's return type
-   const QoreTypeInfo* returnTypeInfo;
-
-   // parse-time block return type
-   const QoreTypeInfo* parse_return_type_info;
-
-   // current implicit element offset
-   int element;
-
-   // start of global thread-local variables for the current thread and program being parsed
-   VNode* global_vnode;
-
-   // Maintains the conditional parse block count for each file parsed
-   ParseConditionalStack* pcs;
-
-   // Maintains the %try-module block count for each file
-   ParseCountHelper tm;
-
-   // for capturing namespace and class names while parsing
-   typedef std::vector<std::string> npvec_t;
-   npvec_t npvec;
-
-   // used for error handling when merging module code into a Program object
-   QoreModuleContext* qmc;
-
-   // used to capture the module definition in user modules
-   QoreModuleDefContext* qmd;
-
-   // user to track the current user module context
-   const char* user_module_context_name;
-
-   // AbstractQoreModule* with boolean ptr in bit 0
-   uintptr_t qmi;
-
-   bool
-   foreign : 1; // true if the thread is a foreign thread
-
-   DLLLOCAL ThreadData(int ptid, QoreProgram* p, bool n_foreign = false) :
-      runtime_po(0), tid(ptid), vlock(ptid), context_stack(0), plStack(0),
-      parse_code(0), parseState(0), vstack(0), cvarstack(0),
-      parseClass(0), catchException(0), trlist(new ThreadResourceList), current_code(0),
-      current_pgm(p), current_ns(0), current_implicit_arg(0), tlpd(0), tpd(new ThreadProgramData(this)),
-      closure_parse_env(0), closure_rt_env(0),
-      returnTypeInfo(0), parse_return_type_info(0), element(0), global_vnode(0), pcs(0),
-      qmc(0), qmd(0), user_module_context_name(0), qmi(0), foreign(n_foreign) {
+ThreadData::ThreadData(int ptid, QoreProgram* p, bool n_foreign) :
+   runtime_po(0), tid(ptid), vlock(ptid), context_stack(0), plStack(0),
+   parse_code(0), parseState(0), vstack(0), cvarstack(0),
+   parseClass(0), catchException(0), trlist(new ThreadResourceList), current_code(0),
+   current_pgm(p), current_ns(0), current_implicit_arg(0), tlpd(0), tpd(new ThreadProgramData(this)),
+   closure_parse_env(0), closure_rt_env(0),
+   returnTypeInfo(0), parse_return_type_info(0), element(0), global_vnode(0), pcs(0),
+   qmc(0), qmd(0), user_module_context_name(0), qmi(0), foreign(n_foreign) {
 
 #ifdef QORE_MANAGE_STACK
 
 #ifdef STACK_DIRECTION_DOWN
-      stack_limit = get_stack_pos() - qore_thread_stack_limit;
+   stack_limit = get_stack_pos() - qore_thread_stack_limit;
 #else
-      stack_limit = get_stack_pos() + qore_thread_stack_limit;
+   stack_limit = get_stack_pos() + qore_thread_stack_limit;
 #endif // #ifdef STACK_DIRECTION_DOWN
 
 #ifdef IA64_64
-      // RSE stack grows up
-      rse_limit = get_rse_bsp() + qore_thread_stack_limit;
+   // RSE stack grows up
+   rse_limit = get_rse_bsp() + qore_thread_stack_limit;
 #endif // #ifdef IA64_64
 
 #endif // #ifdef QORE_MANAGE_STACK
-   }
-
-   DLLLOCAL ~ThreadData() {
-      assert(on_block_exit_list.empty());
-      assert(!tpd);
-      assert(!trlist->prev);
-      delete pcs;
-      delete trlist;
-   }
-
-   DLLLOCAL void endFileParsing() {
-      if (pcs) {
-         pcs->purge();
-         delete pcs;
-         pcs = 0;
-      }
-      tm.purge();
-   }
-
-   DLLLOCAL int getElement() {
-      return element;
-   }
-
-   DLLLOCAL int saveElement(int n_element) {
-      int rc = element;
-      element = n_element;
-      return rc;
-   }
-
-   DLLLOCAL void del(ExceptionSink* xsink) {
-      tpd->del(xsink);
-      tpd->deref();
-      tpd = 0;
-   }
+}
 
-   DLLLOCAL void pushName(const char* name) {
-      npvec.push_back(name);
-   }
+ThreadData::~ThreadData() {
+   assert(on_block_exit_list.empty());
+   assert(!tpd);
+   assert(!trlist->prev);
+   delete pcs;
+   delete trlist;
+}
 
-   DLLLOCAL std::string popName() {
-      assert(!npvec.empty());
-      std::string rv = npvec.back();
-      npvec.pop_back();
-      return rv;
-   }
+#ifdef QORE_HAVE_NATIVE_TLS
+DLLLOCAL QORE_TLS ThreadData* q_thread_data = 0;
+DLLLOCAL QORE_TLS int q_thread_tid = -1;
+#ifdef QORE_BIASED_REFCOUNT
+DLLLOCAL QORE_TLS int64 q_thread_owner_id = -1;
+// the owner ID published in the current thread's entry
+static QORE_TLS volatile int64* q_thread_owner_flag = 0;
+#endif
 
-   DLLLOCAL void parseRollback() {
-      npvec.clear();
+// provides the QoreThreadLocalStorage interface for the current thread's data with native thread-local variables
+class ThreadDataTls {
+public:
+   DLLLOCAL ThreadData* get() const {
+      return q_thread_data;
+   }
+
+   DLLLOCAL void set(ThreadData* td) {
+      q_thread_data = td;
+      q_thread_tid = td ? td->tid : -1;
+#ifdef QORE_BIASED_REFCOUNT
+      // after the thread's data has been deleted, references made in this thread use the shared count; the
+      // entry is marked immediately so that other threads merge the counts this thread leaves behind, even if
+      // the entry is released much later or not at all
+      if (!td && q_thread_owner_flag) {
+         q_thread_owner_id = -1;
+         qore_atomic_set(q_thread_owner_flag, (int64)-1);
+         q_thread_owner_flag = 0;
+      }
+#endif
    }
 
-   DLLLOCAL qore_ns_private* set_ns(qore_ns_private* ns) {
-      if (ns == current_ns)
-         return ns;
-
-      qore_ns_private* rv = current_ns;
-      current_ns = ns;
-      return rv;
+#ifdef QORE_BIASED_REFCOUNT
+   DLLLOCAL void setOwner(volatile int64* flag, int64 owner_id) {
+      q_thread_owner_id = owner_id;
+      q_thread_owner_flag = flag;
+      qore_atomic_set(flag, owner_id);
    }
+#endif
 };
 
+static ThreadDataTls thread_data;
+#else
 static QoreThreadLocalStorage<ThreadData> thread_data;
 
-void ThreadEntry::allocate(tid_node* tn, int stat) {
+ThreadData* q_get_thread_data() {
+   return thread_data.get();
+}
+#endif
+
+void ThreadEntry::allocate(int stat) {
    assert(status == QTS_AVAIL);
    status = stat;
-   tidnode = tn;
 #ifdef QORE_RUNTIME_THREAD_STACK_TRACE
    assert(!callStack);
    callStack = new CallStack;
 #endif
    joined = false;
    assert(!thread_data);
+   // a new generation distinguishes this thread from previous threads with the same TID
+   ++generation;
 }
 
 void ThreadEntry::activate(int tid, pthread_t n_ptid, QoreProgram* p, bool foreign) {
@@ -456,6 +213,9 @@ void ThreadEntry::activate(int tid, pthread_t n_ptid, QoreProgram* p, bool forei
    assert(!thread_data);
    thread_data = new ThreadData(tid, p, foreign);
    ::thread_data.set(thread_data);
+#if defined(QORE_BIASED_REFCOUNT) && defined(QORE_HAVE_NATIVE_TLS)
+   ::thread_data.setOwner(&owner_id, ((int64)generation << 32) | tid);
+#endif
    status = QTS_ACTIVE;
    // set lvstack if QoreProgram set
    if (p)
@@ -553,30 +313,6 @@ public:
    }
 };
 
-// this constructor must only be called with the QoreThreadList lock held
-tid_node::tid_node(int ntid) {
-   tid = ntid;
-   next = 0;
-   prev = thread_list.tid_tail;
-   if (!thread_list.tid_head)
-      thread_list.tid_head = this;
-   else
-      thread_list.tid_tail->next = this;
-   thread_list.tid_tail = this;
-}
-
-// this destructor must only be called with the QoreThreadList lock held
-tid_node::~tid_node() {
-   if (prev)
-      prev->next = next;
-   else
-      thread_list.tid_head = next;
-   if (next)
-      next->prev = prev;
-   else
-      thread_list.tid_tail = prev;
-}
-
 class BGThreadParams {
 private:
    // callobj: get and reference the current stack object, if any, for the new call stack
@@ -821,32 +557,6 @@ void thread_ref_remove(const lvalue_ref* r) {
    td->ref_set.erase(r);
 }
 
-LocalVarValue* thread_instantiate_lvar() {
-   return thread_data.get()->tlpd->lvstack.instantiate();
-}
-
-void thread_uninstantiate_lvar(ExceptionSink* xsink) {
-   ThreadData* td = thread_data.get();
-   td->tlpd->lvstack.uninstantiate(xsink);
-}
-
-LocalVarValue* thread_find_lvar(const char* id) {
-   ThreadData* td = thread_data.get();
-   return td->tlpd->lvstack.find(id);
-}
-
-ClosureVarValue* thread_instantiate_closure_var(const char* n_id, const QoreTypeInfo* typeInfo, QoreValue& nval) {
-   return thread_data.get()->tlpd->cvstack.instantiate(n_id, typeInfo, nval);
-}
-
-void thread_uninstantiate_closure_var(ExceptionSink* xsink) {
-   thread_data.get()->tlpd->cvstack.uninstantiate(xsink);
-}
-
-ClosureVarValue* thread_find_closure_var(const char* id) {
-   return thread_data.get()->tlpd->cvstack.find(id);
-}
-
 const QoreClosureBase* thread_set_runtime_closure_env(const QoreClosureBase* current) {
    ThreadData* td = thread_data.get();
    const QoreClosureBase* rv = td->closure_rt_env;
@@ -858,10 +568,6 @@ void thread_set_closure_parse_env(ClosureParseEnvironment* cenv) {
    thread_data.get()->closure_parse_env = cenv;
 }
 
-ClosureVarValue* thread_get_runtime_closure_var(const LocalVar* id) {
-   return thread_data.get()->closure_rt_env->find(id);
-}
-
 ClosureParseEnvironment* thread_get_closure_parse_env() {
    return thread_data.get()->closure_parse_env;
 }
@@ -1046,34 +752,6 @@ int gettid() {
    return (thread_data.get())->tid;
 }
 
-VLock* getVLock() {
-   ThreadData* td = thread_data.get();
-   return &td->vlock;
-}
-
-Context* get_context_stack() {
-   return (thread_data.get())->context_stack;
-}
-
-void update_context_stack(Context* cstack) {
-   ThreadData* td    = thread_data.get();
-   td->context_stack = cstack;
-}
-
-QoreProgramLocation get_runtime_location() {
-   return thread_data.get()->runtime_loc;
-}
-
-QoreProgramLocation update_get_runtime_location(const QoreProgramLocation& loc) {
-   QoreProgramLocation rv = thread_data.get()->runtime_loc;
-   thread_data.get()->runtime_loc = loc;
-   return rv;
-}
-
-void update_runtime_location(const QoreProgramLocation& loc) {
-   thread_data.get()->runtime_loc = loc;
-}
-
 void set_parse_file_info(QoreProgramLocation& loc) {
    ThreadData* td = thread_data.get();
    loc.file       = td->parse_loc.file;
@@ -1119,17 +797,6 @@ const QoreTypeInfo* parse_get_return_type_info() {
    return (thread_data.get())->parse_return_type_info;
 }
 
-const QoreTypeInfo* getReturnTypeInfo() {
-   return (thread_data.get())->returnTypeInfo;
-}
-
-const QoreTypeInfo* saveReturnTypeInfo(const QoreTypeInfo* returnTypeInfo) {
-   ThreadData* td = thread_data.get();
-   const QoreTypeInfo* rv = td->returnTypeInfo;
-   td->returnTypeInfo = returnTypeInfo;
-   return rv;
-}
-
 const AbstractQoreZoneInfo* currentTZ() {
    ThreadData* td = thread_data.get();
    if (td->tpd) {
@@ -1211,14 +878,6 @@ void clear_argv_ref() {
    thread_data.get()->argv_refs.clear();
 }
 
-int get_implicit_element() {
-   return thread_data.get()->getElement();
-}
-
-int save_implicit_element(int n_element) {
-   return thread_data.get()->saveElement(n_element);
-}
-
 void end_signal_thread(ExceptionSink* xsink) {
    thread_data.get()->tpd->del(xsink);
 }
@@ -1559,8 +1218,7 @@ ProgramRuntimeParseAccessHelper::~ProgramRuntimeParseAccessHelper() {
 }
 
 QoreProgram* getProgram() {
-   return (thread_data.get())->current_pgm;
-   //return (thread_data.get())->pgmStack->getProgram();
+   return q_get_program();
 }
 
 RootQoreNamespace* getRootNS() {
@@ -1662,6 +1320,13 @@ int get_thread_entry() {
    return thread_list.get();
 }
 
+#ifdef QORE_BIASED_REFCOUNT
+bool q_owner_active(int64 owner_id) {
+   // the owner's last updates are visible once it has been seen to clear its owner ID
+   return thread_list.activeOwner(owner_id);
+}
+#endif
+
 void deregister_thread(int tid) {
    thread_list.release(tid);
 }
@@ -1688,6 +1353,547 @@ static void qore_thread_cleanup(void* n = 0) {
    ERR_remove_state(0);
 }
 
+// maximum time in milliseconds a pooled background worker stays parked before exiting
+#define QORE_BG_POOL_IDLE_TIMEOUT 60000
+
+extern "C" void* op_background_pool_thread(void* x);
+
+// pool of parked pthreads that run background expressions when pooling is enabled; each task
+// still gets a new TID, ThreadData and call stack, only the pthread itself is reused
+class BackgroundThreadPool {
+protected:
+   typedef std::deque<BGThreadParams*> bgq_t;
+
+   QoreThreadLock l;
+   // signaled when work is queued or the pool is shut down
+   QoreCondition cond;
+   // signaled when a worker leaves the pool after shutdown
+   QoreCondition exit_cond;
+   // work handed to parked workers that have not yet picked it up
+   bgq_t work;
+   // maximum number of parked workers; 0 = pooling disabled
+   volatile unsigned max_idle;
+   // parked workers without assigned work
+   unsigned idle;
+   // all pool workers that have not yet exited
+   unsigned workers;
+   // pool workers currently running a task; workers that have finished their task but have not yet
+   // parked or exited are counted in "workers" only, so that stop() waits for them
+   unsigned busy;
+   bool shutdown;
+
+public:
+   DLLLOCAL BackgroundThreadPool() : max_idle(0), idle(0), workers(0), busy(0), shutdown(false) {
+   }
+
+   DLLLOCAL bool enabled() const {
+      return max_idle;
+   }
+
+   DLLLOCAL unsigned getMax() const {
+      return max_idle;
+   }
+
+   DLLLOCAL void setMax(unsigned n) {
+      AutoLocker al(l);
+      max_idle = n;
+      // wake up parked workers so that surplus workers can exit
+      if (idle > n)
+         cond.broadcast();
+   }
+
+   // returns true if the work was handed to a parked worker
+   DLLLOCAL bool submit(BGThreadParams* btp) {
+      if (!max_idle)
+         return false;
+      AutoLocker al(l);
+      if (!idle || shutdown)
+         return false;
+      --idle;
+      ++busy;
+      work.push_back(btp);
+      cond.signal();
+      return true;
+   }
+
+   // starts a new pool worker for the given task; returns 0 for success or an errno value
+   DLLLOCAL int start(pthread_t& ptid, BGThreadParams* btp) {
+      {
+         AutoLocker al(l);
+         ++workers;
+         ++busy;
+      }
+      int rc = pthread_create(&ptid, ta_default.get_ptr(), op_background_pool_thread, btp);
+      if (rc) {
+         AutoLocker al(l);
+         --workers;
+         --busy;
+         return rc;
+      }
+      pthread_detach(ptid);
+      return 0;
+   }
+
+   // called by a worker after finishing a task and before the thread counter is decremented
+   DLLLOCAL void finished() {
+      AutoLocker al(l);
+      --busy;
+   }
+
+   // called by a worker after finished(); returns the next task or 0 if the worker should exit
+   DLLLOCAL BGThreadParams* park() {
+      AutoLocker al(l);
+      if (shutdown || idle >= max_idle)
+         return 0;
+      ++idle;
+      while (true) {
+         if (!work.empty()) {
+            BGThreadParams* btp = work.front();
+            work.pop_front();
+            return btp;
+         }
+         if (shutdown || idle > max_idle || cond.wait(l, QORE_BG_POOL_IDLE_TIMEOUT)) {
+            // check for work assigned to this worker before the pool was stopped or while waiting
+            if (!work.empty())
+               continue;
+            --idle;
+            return 0;
+         }
+      }
+   }
+
+   // called when a worker leaves the pool
+   DLLLOCAL void exited() {
+      AutoLocker al(l);
+      --workers;
+      if (shutdown)
+         exit_cond.broadcast();
+   }
+
+   // signals all parked workers to exit and waits for them; called when the library is shut down
+   DLLLOCAL void stop() {
+      AutoLocker al(l);
+      shutdown = true;
+      cond.broadcast();
+      // wait for parked workers and for workers between finished() and park(); workers still running a
+      // task exit on their own like unpooled background threads
+      while (workers > busy)
+         exit_cond.wait(l);
+   }
+};
+
+static BackgroundThreadPool bg_pool;
+
+void qore_set_background_thread_pool(unsigned max_idle) {
+   bg_pool.setMax(max_idle);
+}
+
+unsigned qore_get_background_thread_pool() {
+   return bg_pool.getMax();
+}
+
+// maximum number of containers waiting to be freed; further containers are freed by the releasing thread
+#define QORE_DEFERRED_FREE_MAX_PENDING 1024
+
+volatile unsigned qore_deferred_free_min = 0;
+
+// frees large lists and hashes in a background pthread so that threads releasing them are not blocked while
+// all of their elements are freed; only containers without objects, closures and call references are queued (as
+// tracked by their object counts; see get_container_obj()), so no Qore code can run in the reclaimer and
+// destructors are always run synchronously
+class DeferredReclaimer {
+protected:
+   typedef std::deque<AbstractQoreNode*> nq_t;
+
+   QoreThreadLock l;
+   // signaled when a container is queued or the reclaimer is shut down
+   QoreCondition cond;
+   nq_t pending;
+   pthread_t ptid;
+   // the number of containers freed by the reclaimer thread
+   int64 freed;
+   bool running, shutdown;
+
+   DLLLOCAL static void* reclaimThread(void* x) {
+      reinterpret_cast<DeferredReclaimer*>(x)->run();
+      return 0;
+   }
+
+   DLLLOCAL void run() {
+      ExceptionSink xsink;
+      AutoLocker al(l);
+      while (true) {
+         if (pending.empty()) {
+            // pending containers are always freed before the thread exits
+            if (shutdown)
+               return;
+            cond.wait(l);
+            continue;
+         }
+         AbstractQoreNode* n = pending.front();
+         pending.pop_front();
+         {
+            AutoUnlocker au(l);
+            n->deref(&xsink);
+         }
+         ++freed;
+      }
+   }
+
+#ifdef QORE_BIASED_REFCOUNT
+   // hands off the releasing thread's references to all values in the container to the shared counts, so that the
+   // reclaimer can release them; this must be done by the releasing thread, which owns the biased counts, and
+   // nested containers are processed even if they are not owned by the releasing thread, as their elements can be
+   DLLLOCAL static void share(const AbstractQoreNode* n) {
+      if (!n || !n->isReferenceCounted())
+         return;
+      n->ROshare();
+      switch (n->getType()) {
+         case NT_LIST: {
+            const QoreListNode* l = reinterpret_cast<const QoreListNode*>(n);
+            for (qore_size_t i = 0, e = l->size(); i < e; ++i)
+               share(l->retrieve_entry(i));
+            break;
+         }
+         case NT_HASH: {
+            ConstHashIterator hi(reinterpret_cast<const QoreHashNode*>(n));
+            while (hi.next())
+               share(hi.getValue());
+            break;
+         }
+      }
+   }
+#endif
+
+public:
+   DLLLOCAL DeferredReclaimer() : freed(0), running(false), shutdown(false) {
+   }
+
+   // returns true if a container without objects, closures and call references can be queued
+   DLLLOCAL bool check() {
+      // nested containers released by the reclaimer itself are freed immediately
+      return !running || !pthread_equal(ptid, pthread_self());
+   }
+
+   // returns true if the container was queued
+   DLLLOCAL bool queue(AbstractQoreNode* n) {
+      {
+         AutoLocker al(l);
+         if (shutdown || pending.size() >= QORE_DEFERRED_FREE_MAX_PENDING)
+            return false;
+         if (!running) {
+            if (pthread_create(&ptid, ta_default.get_ptr(), reclaimThread, this))
+               return false;
+            running = true;
+         }
+      }
+#ifdef QORE_BIASED_REFCOUNT
+      // the container is released in another thread
+      share(n);
+#endif
+      AutoLocker al(l);
+      // the reclaimer thread may have exited in the meantime
+      if (shutdown)
+         return false;
+      pending.push_back(n);
+      cond.signal();
+      return true;
+   }
+
+   DLLLOCAL int64 getFreed() {
+      AutoLocker al(l);
+      return freed;
+   }
+
+   // frees all pending containers and stops the reclaimer thread; called when the library is shut down
+   DLLLOCAL void stop() {
+      {
+         AutoLocker al(l);
+         shutdown = true;
+         if (!running)
+            return;
+         cond.signal();
+      }
+      pthread_join(ptid, 0);
+      running = false;
+   }
+};
+
+static DeferredReclaimer reclaimer;
+
+bool qore_check_deferred_free(const AbstractQoreNode* n, size_t size) {
+   return size >= qore_deferred_free_min && reclaimer.check();
+}
+
+bool qore_deferred_free(AbstractQoreNode* n) {
+   return reclaimer.queue(n);
+}
+
+int64 qore_get_deferred_free_count() {
+   return reclaimer.getFreed();
+}
+
+void qore_set_deferred_free(unsigned min_size) {
+   qore_deferred_free_min = min_size;
+}
+
+unsigned qore_get_deferred_free() {
+   return qore_deferred_free_min;
+}
+
+// shared state of a parallel_map() call; worker threads take chunks of consecutive elements until
+// the list is exhausted or an exception has been raised
+class ParallelMapJob {
+public:
+   QoreThreadLock l;
+   QoreCondition cond;
+   const QoreListNode* in;
+   const ResolvedCallReferenceNode* f;
+   std::vector<AbstractQoreNode*> out;
+   size_t next, chunk;
+   int running;          // worker threads that have not terminated yet
+   bool error;
+   ExceptionSink err;    // the first exception raised
+
+   DLLLOCAL ParallelMapJob(const QoreListNode* l, const ResolvedCallReferenceNode* n_f, size_t n_chunk) : in(l), f(n_f), out(l->size()), next(0), chunk(n_chunk), running(0), error(false) {
+   }
+
+   DLLLOCAL void work(ExceptionSink* xsink) {
+      size_t size = out.size();
+      while (true) {
+         size_t start, end;
+         {
+            AutoLocker al(l);
+            if (error || next >= size)
+               return;
+            start = next;
+            end = next + chunk < size ? next + chunk : size;
+            next = end;
+         }
+
+         for (size_t i = start; i < end; ++i) {
+            ReferenceHolder<QoreListNode> args(new QoreListNode, xsink);
+            const AbstractQoreNode* v = in->retrieve_entry(i);
+            args->push(v ? v->refSelf() : 0);
+            out[i] = f->execValue(*args, xsink).takeNode();
+            if (*xsink) {
+               AutoLocker al(l);
+               // only the first exception is reported
+               if (!error) {
+                  error = true;
+                  err.assimilate(xsink);
+               }
+               else
+                  xsink->clear();
+               return;
+            }
+         }
+      }
+   }
+
+   DLLLOCAL void done() {
+      AutoLocker al(l);
+      if (!--running)
+         cond.signal();
+   }
+};
+
+extern "C" void* op_parallel_map_thread(void* x);
+
+// a bounded set of persistent pthreads shared by all parallel_map() calls; like pooled background threads, each
+// job gets a new TID and ThreadData, only the pthread itself is reused; parked workers exit after
+// QORE_BG_POOL_IDLE_TIMEOUT ms
+class ParallelMapPool {
+protected:
+   typedef std::deque<ParallelMapJob*> pmq_t;
+
+   QoreThreadLock l;
+   // signaled when a job is queued or the pool is shut down
+   QoreCondition cond;
+   // signaled when a worker exits after shutdown
+   QoreCondition exit_cond;
+   // jobs handed to parked workers that have not yet picked them up
+   pmq_t work;
+   // parked workers without an assigned job
+   unsigned idle;
+   // all workers that have not yet exited
+   unsigned workers;
+   // the maximum number of workers: the number of online CPUs
+   unsigned max_workers;
+   bool shutdown;
+
+public:
+   DLLLOCAL ParallelMapPool() : idle(0), workers(0), max_workers(0), shutdown(false) {
+   }
+
+   // hands the job to a parked worker or starts a new worker; returns false if all workers are busy
+   DLLLOCAL bool submit(ParallelMapJob* job) {
+      AutoLocker al(l);
+      if (shutdown)
+         return false;
+      if (idle) {
+         --idle;
+         work.push_back(job);
+         cond.signal();
+         return true;
+      }
+      if (!max_workers) {
+         long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+         max_workers = ncpus > 0 ? ncpus : 1;
+      }
+      if (workers >= max_workers)
+         return false;
+      pthread_t ptid;
+      if (pthread_create(&ptid, ta_default.get_ptr(), op_parallel_map_thread, job))
+         return false;
+      pthread_detach(ptid);
+      ++workers;
+      return true;
+   }
+
+   // called by a worker after finishing a job; returns the next job or 0 if the worker should exit
+   DLLLOCAL ParallelMapJob* park() {
+      AutoLocker al(l);
+      if (shutdown)
+         return 0;
+      ++idle;
+      while (true) {
+         if (!work.empty()) {
+            ParallelMapJob* job = work.front();
+            work.pop_front();
+            return job;
+         }
+         if (shutdown || cond.wait(l, QORE_BG_POOL_IDLE_TIMEOUT)) {
+            // check for a job assigned to this worker before the pool was stopped or while waiting
+            if (!work.empty())
+               continue;
+            --idle;
+            return 0;
+         }
+      }
+   }
+
+   // called when a worker exits
+   DLLLOCAL void exited() {
+      AutoLocker al(l);
+      --workers;
+      if (shutdown)
+         exit_cond.broadcast();
+   }
+
+   // signals all parked workers to exit and waits for all workers; called when the library is shut down
+   DLLLOCAL void stop() {
+      AutoLocker al(l);
+      shutdown = true;
+      cond.broadcast();
+      while (workers)
+         exit_cond.wait(l);
+   }
+};
+
+static ParallelMapPool pm_pool;
+
+// processes chunks of the job as a new qore thread; all thread data is released before the job is marked as done
+static void run_parallel_map_job(ParallelMapJob* job) {
+   int tid = get_thread_entry();
+   if (tid == -1) {
+      // the calling thread processes the remaining chunks
+      job->done();
+      return;
+   }
+   register_thread(tid, pthread_self(), 0);
+   // the pthread outlives the qore thread and must not be detached when the TID is released
+   thread_list.setJoined(tid);
+
+   ExceptionSink xsink;
+   // exceptions raised by the code are saved in the job
+   job->work(&xsink);
+
+   thread_data.get()->del(&xsink);
+   purge_thread_resources(&xsink);
+   xsink.handleExceptions();
+   thread_list.deleteDataRelease(tid);
+   tclist.exec();
+
+   job->done();
+}
+
+namespace {
+   extern "C" void* op_parallel_map_thread(void* x) {
+      ParallelMapJob* job = (ParallelMapJob*)x;
+      pthread_cleanup_push(qore_thread_cleanup, (void*)0);
+      while (job) {
+         run_parallel_map_job(job);
+         // reset library thread-local state so the next job starts like a new thread
+         qore_thread_cleanup();
+         thread_counter.dec();
+         job = pm_pool.park();
+      }
+      pthread_cleanup_pop(1);
+      pm_pool.exited();
+      pthread_exit(0);
+      return 0;
+   }
+}
+
+QoreListNode* qore_parallel_map(const QoreListNode* l, const ResolvedCallReferenceNode* f, int64 chunk, int64 max_threads, ExceptionSink* xsink) {
+   size_t size = l->size();
+
+   if (max_threads <= 0) {
+      long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+      max_threads = ncpus > 0 ? ncpus : 1;
+   }
+   // by default each thread gets about 4 chunks so that uneven work is balanced between threads
+   if (chunk <= 0) {
+      chunk = size / (max_threads * 4);
+      if (!chunk)
+         chunk = 1;
+   }
+   int64 nchunks = (size + chunk - 1) / chunk;
+   // the calling thread also processes chunks, so one less thread is started
+   int64 nthreads = (nchunks < max_threads ? nchunks : max_threads) - 1;
+
+   ParallelMapJob job(l, f, chunk);
+   for (int64 i = 0; i < nthreads; ++i) {
+      {
+         AutoLocker al(job.l);
+         ++job.running;
+      }
+      thread_counter.inc();
+      if (!pm_pool.submit(&job)) {
+         // continue with the workers already assigned; the calling thread ensures that all elements are processed
+         thread_counter.dec();
+         AutoLocker al(job.l);
+         --job.running;
+         break;
+      }
+   }
+
+   job.work(xsink);
+
+   // wait for all worker threads to terminate
+   {
+      AutoLocker al(job.l);
+      while (job.running)
+         job.cond.wait(job.l);
+   }
+
+   if (*xsink || job.error) {
+      for (size_t i = 0; i < size; ++i)
+         discard(job.out[i], xsink);
+      if (!*xsink)
+         xsink->assimilate(job.err);
+      else
+         job.err.clear();
+      return 0;
+   }
+
+   QoreListNode* rv = new QoreListNode;
+   for (size_t i = 0; i < size; ++i)
+      rv->push(job.out[i]);
+   return rv;
+}
+
 int q_register_foreign_thread() {
    // see if the current thread has already been registered
    ThreadData* td = thread_data.get();
@@ -1742,17 +1948,11 @@ int q_reserve_foreign_thread_id() {
 }
 
 int q_release_reserved_foreign_thread_id(int tid) {
-   if (tid < 0 || tid >= MAX_QORE_THREADS)
-      return -1;
-
    // release the thread entry
    return thread_list.releaseReserved(tid);
 }
 
 int q_register_reserved_foreign_thread(int tid) {
-   if (tid < 0 || tid >= MAX_QORE_THREADS)
-      return -1;
-
    return thread_list.activateReserved(tid);
 }
 
@@ -1860,14 +2060,17 @@ namespace {
       return 0;
    }
 
-   extern "C" void* op_background_thread(void* x) {
-      BGThreadParams* btp = (BGThreadParams*) x;
+   // runs a background expression as a new qore thread; the pthread is registered with the
+   // given TID for the duration of the call, and all thread data is released before returning
+   static void run_background_thread(BGThreadParams* btp, bool pooled) {
       // register thread
       register_thread(btp->tid, pthread_self(), btp->pgm);
       printd(5, "op_background_thread() btp: %p TID %d started\n", btp, btp->tid);
       //printf("op_background_thread() btp: %p TID %d started\n", btp, btp->tid);
 
-      pthread_cleanup_push(qore_thread_cleanup, (void*)0);
+      // pooled pthreads outlive the qore thread and must not be detached when the TID is released
+      if (pooled)
+         thread_list.setJoined(btp->tid);
 
       {
          ExceptionSink xsink;
@@ -1920,12 +2123,33 @@ namespace {
             tclist.exec();
          }
       }
+   }
 
+   extern "C" void* op_background_thread(void* x) {
+      pthread_cleanup_push(qore_thread_cleanup, (void*)0);
+      run_background_thread((BGThreadParams*)x, false);
       pthread_cleanup_pop(1);
       thread_counter.dec();
       pthread_exit(0);
       return 0;
    }
+
+   extern "C" void* op_background_pool_thread(void* x) {
+      BGThreadParams* btp = (BGThreadParams*)x;
+      pthread_cleanup_push(qore_thread_cleanup, (void*)0);
+      while (btp) {
+         run_background_thread(btp, true);
+         // reset library thread-local state so the next task starts like a new thread
+         qore_thread_cleanup();
+         bg_pool.finished();
+         thread_counter.dec();
+         btp = bg_pool.park();
+      }
+      pthread_cleanup_pop(1);
+      bg_pool.exited();
+      pthread_exit(0);
+      return 0;
+   }
 }
 
 static AbstractQoreNode* op_background(const AbstractQoreNode* left, const AbstractQoreNode* ignored, bool ref_rv, ExceptionSink* xsink) {
@@ -1965,7 +2189,13 @@ static AbstractQoreNode* op_background(const AbstractQoreNode* left, const Abstr
    //printd(5, "calling pthread_create(%p, %p, %p, %p)\n", &ptid, &ta_default, op_background_thread, tp);
    thread_counter.inc();
 
-   if ((rc = pthread_create(&ptid, ta_default.get_ptr(), op_background_thread, tp))) {
+   // hand the expression to a parked worker if background thread pooling is enabled
+   if (bg_pool.submit(tp))
+      return ref_rv ? new QoreBigIntNode(tid) : 0;
+
+   if ((rc = bg_pool.enabled()
+        ? bg_pool.start(ptid, tp)
+        : pthread_create(&ptid, ta_default.get_ptr(), op_background_thread, tp))) {
       tp->cleanup(xsink);
       tp->del(xsink);
 
@@ -2092,6 +2322,9 @@ QoreNamespace* get_thread_ns(QoreNamespace &qorens) {
    Thread->addSystemClass(initRWLockClass(*Thread));
    Thread->addSystemClass(initGateClass(*Thread));
    Thread->addSystemClass(initSequenceClass(*Thread));
+   Thread->addSystemClass(initAtomicIntegerClass(*Thread));
+   Thread->addSystemClass(initConcurrentHashClass(*Thread));
+   Thread->addSystemClass(initCacheClass(*Thread));
    Thread->addSystemClass(initCounterClass(*Thread));
 
    Thread->addSystemClass(initAutoLockClass(*Thread));
@@ -2124,6 +2357,15 @@ void delete_qore_threads() {
    // mark threading as inactive
    threads_initialized = false;
 
+   // release any parked background workers
+   bg_pool.stop();
+
+   // release any parked parallel_map() workers
+   pm_pool.stop();
+
+   // free any containers queued for background reclamation
+   reclaimer.stop();
+
    pthread_mutexattr_destroy(&ma_recursive);
 
    assert(initial_thread);
@@ -2179,8 +2421,8 @@ QoreHashNode* QoreThreadList::getAllCallStacks() {
 
    while (i.next()) {
       // get call stack
-      if (entry[*i].callStack) {
-         QoreListNode* l = entry[*i].callStack->getCallStack();
+      if (entry(*i).callStack) {
+         QoreListNode* l = entry(*i).callStack->getCallStack();
          if (!l->empty()) {
             // make hash entry
             str.clear();
@@ -2197,10 +2439,7 @@ QoreHashNode* QoreThreadList::getAllCallStacks() {
 #endif
 
 void ThreadEntry::cleanup() {
-   //printf("ThreadEntry::cleanup() TID %d\n", tidnode ? tidnode->tid : 0);
    assert(status != QTS_AVAIL);
-   // delete tidnode from tid_list
-   delete tidnode;
 
 #ifdef QORE_RUNTIME_THREAD_STACK_TRACE
    // delete call stack
@@ -2226,7 +2465,7 @@ void QoreThreadList::deleteData(int tid) {
 
 #ifdef DEBUG
    AutoLocker al(l);
-   entry[tid].thread_data = 0;
+   entry(tid).thread_data = 0;
 #endif
 }
 
@@ -2236,7 +2475,7 @@ void QoreThreadList::deleteDataRelease(int tid) {
 
    AutoLocker al(l);
 #ifdef DEBUG
-   entry[tid].thread_data = 0;
+   entry(tid).thread_data = 0;
 #endif
 
    releaseIntern(tid);
@@ -2260,13 +2499,13 @@ unsigned QoreThreadList::cancelAllActiveThreads() {
 
    while (i.next()) {
       if (*i != (unsigned)tid) {
-         //printf("QoreThreadList::cancelAllActiveThreads() canceling TID %d ptid: %p (this TID: %d)\n", *i, entry[*i].ptid, tid);
-         int trc = pthread_cancel(entry[*i].ptid);
+         //printf("QoreThreadList::cancelAllActiveThreads() canceling TID %d ptid: %p (this TID: %d)\n", *i, entry(*i).ptid, tid);
+         int trc = pthread_cancel(entry(*i).ptid);
          if (!trc)
             ++tcc;
 #ifdef DEBUG
          else
-            printd(0, "pthread_cancel() returned %d (%s) on tid %d (%p)\n", trc, strerror(trc), tid, entry[*i].ptid);
+            printd(0, "pthread_cancel() returned %d (%s) on tid %d (%p)\n", trc, strerror(trc), tid, entry(*i).ptid);
 #endif
       }
    }
@@ -2276,14 +2515,14 @@ unsigned QoreThreadList::cancelAllActiveThreads() {
 
 #ifdef QORE_RUNTIME_THREAD_STACK_TRACE
 void QoreThreadList::pushCall(CallNode* cn) {
-   entry[gettid()].callStack->push(cn);
+   entry(gettid()).callStack->push(cn);
 }
 
 void QoreThreadList::popCall(ExceptionSink* xsink) {
-   entry[gettid()].callStack->pop(xsink);
+   entry(gettid()).callStack->pop(xsink);
 }
 
 QoreListNode* QoreThreadList::getCallStackList() {
-   return entry[gettid()].callStack->getCallStack();
+   return entry(gettid()).callStack->getCallStack();
 }
 #endif
@@ -0,0 +1,60 @@
+// measures the latency of starting short background threads with and without background thread pooling
+// usage: bg-bench [tasks] [pool size]
+
+#include <qore/Qore.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEF_TASKS 20000
+
+static const char* code =
+   "int sub run(int $n) {\n"
+   "   my Counter $c();\n"
+   "   for (my int $i = 0; $i < $n; ++$i) {\n"
+   "      $c.inc();\n"
+   "      background $c.dec();\n"
+   "      # wait for each task so the latency of a single start is measured\n"
+   "      $c.waitForZero();\n"
+   "   }\n"
+   "   return $n;\n"
+   "}\n";
+
+static double now() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void run(QoreProgram* pgm, const char* name, long tasks, ExceptionSink& xsink) {
+   ReferenceHolder<QoreListNode> args(new QoreListNode, &xsink);
+   args->push(new QoreBigIntNode(tasks));
+   double start = now();
+   discard(pgm->callFunction("run", *args, &xsink), &xsink);
+   double secs = now() - start;
+   printf("%-12s %8.2f us/background start and exit\n", name, secs * 1000000.0 / tasks);
+}
+
+int main(int argc, char* argv[]) {
+   long tasks = argc > 1 ? atol(argv[1]) : DEF_TASKS;
+   unsigned pool = argc > 2 ? atoi(argv[2]) : 8;
+
+   qore_init();
+
+   ExceptionSink xsink;
+   QoreProgram* pgm = new QoreProgram;
+   pgm->parse(code, "bg-bench", &xsink);
+   if (xsink) {
+      xsink.handleExceptions();
+      return 1;
+   }
+
+   run(pgm, "new thread", tasks, xsink);
+   qore_set_background_thread_pool(pool);
+   run(pgm, "pooled", tasks, xsink);
+
+   pgm->waitForTerminationAndDeref(&xsink);
+   qore_cleanup();
+   return 0;
+}
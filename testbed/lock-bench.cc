@@ -0,0 +1,97 @@
+// measures the uncontended and contended cost of the locking primitives used by the qore library
+// and the Qore-level thread classes built on them
+// usage: lock-bench [iterations] [threads]
+
+#include <qore/Qore.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEF_ITERS 1000000
+
+static const char* code =
+   "our Mutex $m();\n"
+   "our Gate $g();\n"
+   "our RWLock $rw();\n"
+   "our Counter $c();\n"
+   "our Queue $q();\n"
+   "sub mutex(int $n) { for (my int $i = 0; $i < $n; ++$i) { $m.lock(); $m.unlock(); } }\n"
+   "sub gate(int $n) { for (my int $i = 0; $i < $n; ++$i) { $g.enter(); $g.exit(); } }\n"
+   "sub rwlock_read(int $n) { for (my int $i = 0; $i < $n; ++$i) { $rw.readLock(); $rw.readUnlock(); } }\n"
+   "sub rwlock_write(int $n) { for (my int $i = 0; $i < $n; ++$i) { $rw.writeLock(); $rw.writeUnlock(); } }\n"
+   "sub counter(int $n) { for (my int $i = 0; $i < $n; ++$i) { $c.inc(); $c.dec(); } }\n"
+   "sub queue(int $n) { for (my int $i = 0; $i < $n; ++$i) { $q.push($i); $q.get(); } }\n";
+
+static const char* qore_funcs[] = { "mutex", "gate", "rwlock_read", "rwlock_write", "counter", "queue" };
+#define NUM_FUNCS (sizeof(qore_funcs) / sizeof(const char*))
+
+static long iters = DEF_ITERS;
+static QoreProgram* pgm;
+static QoreThreadLock lck;
+static long shared_count;
+
+static double now() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+// raw QoreThreadLock with a short critical section
+static void* lock_thread(void* arg) {
+   for (long i = 0; i < iters; ++i) {
+      AutoLocker al(lck);
+      ++shared_count;
+   }
+   return 0;
+}
+
+static void* qore_thread(void* arg) {
+   QoreForeignThreadHelper tfh;
+   ExceptionSink xsink;
+   ReferenceHolder<QoreListNode> args(new QoreListNode, &xsink);
+   args->push(new QoreBigIntNode(iters));
+   discard(pgm->callFunction((const char*)arg, *args, &xsink), &xsink);
+   return 0;
+}
+
+static void run(const char* name, void* (*f)(void*), void* arg, int threads) {
+   pthread_t* ptid = new pthread_t[threads];
+   double start = now();
+   for (int i = 0; i < threads; ++i)
+      pthread_create(&ptid[i], 0, f, arg);
+   for (int i = 0; i < threads; ++i)
+      pthread_join(ptid[i], 0);
+   double secs = now() - start;
+   delete [] ptid;
+
+   printf("%-14s %3d threads: %8.2f ns/op\n", name, threads, secs * 1000000000.0 / ((double)iters * threads));
+}
+
+int main(int argc, char* argv[]) {
+   if (argc > 1)
+      iters = atol(argv[1]);
+   int threads = argc > 2 ? atoi(argv[2]) : 4;
+
+   qore_init();
+
+   ExceptionSink xsink;
+   pgm = new QoreProgram;
+   pgm->parse(code, "lock-bench", &xsink);
+   if (xsink) {
+      xsink.handleExceptions();
+      return 1;
+   }
+
+   // uncontended (1 thread) and contended costs
+   for (int t = 1; t <= threads; t *= 2) {
+      run("QoreThreadLock", lock_thread, 0, t);
+      for (unsigned i = 0; i < NUM_FUNCS; ++i)
+         run(qore_funcs[i], qore_thread, (void*)qore_funcs[i], t);
+   }
+
+   pgm->waitForTerminationAndDeref(&xsink);
+   qore_cleanup();
+   return 0;
+}
@@ -0,0 +1,91 @@
+// measures reference counting overhead with list- and hash-building workloads in one or more threads
+// usage: refcount-bench [iterations] [threads]
+
+#include <qore/Qore.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEF_ITERS 200000
+#define ELEMENTS 20
+
+static long iters = DEF_ITERS;
+
+static double now() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void report(const char* name, double start, long ops) {
+   double ns = (now() - start) * 1000000000.0 / ops;
+   printf("%-26s %6.2f ns/element\n", name, ns);
+}
+
+static void run_bench() {
+   ExceptionSink xsink;
+   QoreStringNode* str = new QoreStringNode("value");
+
+   // builds lists of shared strings, then copies and releases them
+   double start = now();
+   for (long i = 0; i < iters; ++i) {
+      QoreListNode* l = new QoreListNode;
+      for (int j = 0; j < ELEMENTS; ++j)
+         l->push(str->refSelf());
+      QoreListNode* c = l->copy();
+      l->deref(&xsink);
+      c->deref(&xsink);
+   }
+   report("list build/copy/free", start, iters * ELEMENTS);
+
+   // builds hashes of new integer values and shared strings
+   start = now();
+   for (long i = 0; i < iters; ++i) {
+      QoreHashNode* h = new QoreHashNode;
+      for (int j = 0; j < ELEMENTS; ++j) {
+         QoreString key;
+         key.sprintf("k%d", j);
+         h->setKeyValue(key.getBuffer(), j & 1 ? str->refSelf() : new QoreBigIntNode(j), &xsink);
+      }
+      QoreHashNode* c = h->copy();
+      h->deref(&xsink);
+      c->deref(&xsink);
+   }
+   report("hash build/copy/free", start, iters * ELEMENTS);
+
+   // plain reference and dereference of a single value
+   start = now();
+   for (long i = 0; i < iters * ELEMENTS; ++i) {
+      str->ref();
+      str->deref();
+   }
+   report("ref/deref", start, iters * ELEMENTS);
+
+   str->deref();
+}
+
+static void* thread_bench(void* arg) {
+   QoreForeignThreadHelper tfh;
+   run_bench();
+   return 0;
+}
+
+int main(int argc, char* argv[]) {
+   if (argc > 1)
+      iters = atol(argv[1]);
+   int threads = argc > 2 ? atoi(argv[2]) : 1;
+
+   qore_init();
+
+   pthread_t* ptid = new pthread_t[threads];
+   for (int i = 0; i < threads; ++i)
+      pthread_create(&ptid[i], 0, thread_bench, 0);
+   for (int i = 0; i < threads; ++i)
+      pthread_join(ptid[i], 0);
+   delete [] ptid;
+
+   qore_cleanup();
+   return 0;
+}
@@ -0,0 +1,107 @@
+// measures the per-call cost of the thread-local data accessors in the qore library and the cost of local variable
+// access in Qore code, which uses the inline accessors for the current thread's data in the library
+// usage: tls-bench [iterations] [threads]
+
+#include <qore/Qore.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEF_ITERS 50000000
+
+static const char* code =
+   "int sub locals(int $n) { my int $rv; for (my int $i = 0; $i < $n; ++$i) $rv += $i; return $rv; }\n";
+
+static long iters = DEF_ITERS;
+static pthread_key_t key;
+static QoreProgram* pgm;
+
+static double now() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void report(const char* name, double start, long sum) {
+   double ns = (now() - start) * 1000000000.0 / iters;
+   // the sum is printed so the calls cannot be optimized away
+   printf("%-26s %6.2f ns/call (%ld)\n", name, ns, sum);
+}
+
+static void run_bench() {
+   long sum = 0;
+   double start = now();
+   for (long i = 0; i < iters; ++i)
+      sum += gettid();
+   report("gettid()", start, sum);
+
+   sum = 0;
+   start = now();
+   for (long i = 0; i < iters; ++i)
+      sum += (long)getProgram() & 1;
+   report("getProgram()", start, sum);
+
+   sum = 0;
+   start = now();
+   for (long i = 0; i < iters; ++i)
+      sum += is_valid_qore_thread();
+   report("is_valid_qore_thread()", start, sum);
+
+   // baseline: the raw cost of a pthread key lookup
+   pthread_setspecific(key, (void*)&sum);
+   sum = 0;
+   start = now();
+   for (long i = 0; i < iters; ++i)
+      sum += (long)pthread_getspecific(key) & 1;
+   report("pthread_getspecific()", start, sum);
+
+   // local variable lookups in Qore code; fewer iterations are run, as each one executes several statements
+   ExceptionSink xsink;
+   ReferenceHolder<QoreListNode> args(new QoreListNode, &xsink);
+   args->push(new QoreBigIntNode(iters / 10));
+   start = now();
+   discard(pgm->callFunction("locals", *args, &xsink), &xsink);
+   double ns = (now() - start) * 1000000000.0 / (iters / 10);
+   printf("%-26s %6.2f ns/iteration\n", "local variable loop", ns);
+}
+
+static void* thread_bench(void* arg) {
+   QoreForeignThreadHelper tfh;
+   run_bench();
+   return 0;
+}
+
+int main(int argc, char* argv[]) {
+   if (argc > 1)
+      iters = atol(argv[1]);
+   int threads = argc > 2 ? atoi(argv[2]) : 1;
+
+   qore_init();
+   pthread_key_create(&key, 0);
+
+   ExceptionSink xsink;
+   pgm = new QoreProgram;
+   pgm->parse(code, "tls-bench", &xsink);
+   if (xsink) {
+      xsink.handleExceptions();
+      return 1;
+   }
+
+   if (threads <= 1)
+      run_bench();
+   else {
+      pthread_t* ptid = new pthread_t[threads];
+      for (int i = 0; i < threads; ++i)
+         pthread_create(&ptid[i], 0, thread_bench, 0);
+      for (int i = 0; i < threads; ++i)
+         pthread_join(ptid[i], 0);
+      delete [] ptid;
+   }
+
+   pthread_key_delete(key);
+   pgm->waitForTerminationAndDeref(&xsink);
+   qore_cleanup();
+   return 0;
+}
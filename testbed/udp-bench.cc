@@ -0,0 +1,83 @@
+// measures UDP datagram throughput over the loopback interface with Socket::sendDatagrams() and Socket::recvDatagrams()
+// for different batch sizes; a batch size of 1 corresponds to one system call per datagram
+// usage: udp-bench [datagrams] [datagram size]
+
+#include <qore/Qore.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEF_DGRAMS 1000000
+#define DEF_SIZE 128
+
+static const char* code =
+   "int sub run(int $n, int $size, int $batch) {\n"
+   "   my Socket $rs();\n"
+   "   $rs.bindINET(\"127.0.0.1\", 0, False, AF_INET, SOCK_DGRAM);\n"
+   "   my hash $peer = (\"address\": \"127.0.0.1\", \"port\": $rs.getSocketInfo(False).port);\n"
+   "   my Socket $ss();\n"
+   "   $ss.bindINET(\"127.0.0.1\", 0, False, AF_INET, SOCK_DGRAM);\n"
+   "   my hash $dgram = (\"data\": strmul(\"x\", $size), \"peer\": $peer);\n"
+   "   my list $l = ();\n"
+   "   for (my int $i = 0; $i < $batch; ++$i)\n"
+   "      $l += $dgram;\n"
+   "   my int $recv;\n"
+   // send and receive in lockstep so that no datagrams are dropped when the receive buffer is full
+   "   for (my int $i = 0; $i < $n; $i += $batch) {\n"
+   "      $ss.sendDatagrams($l);\n"
+   "      my int $got;\n"
+   "      while ($got < $batch) {\n"
+   "         my int $c = $rs.recvDatagrams($batch, 1s, $size).size();\n"
+   "         if (!$c)\n"
+   "            break;\n"
+   "         $got += $c;\n"
+   "      }\n"
+   "      $recv += $got;\n"
+   "   }\n"
+   "   return $recv;\n"
+   "}\n";
+
+static double now() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+int main(int argc, char* argv[]) {
+   long dgrams = argc > 1 ? atol(argv[1]) : DEF_DGRAMS;
+   int size = argc > 2 ? atoi(argv[2]) : DEF_SIZE;
+
+   qore_init();
+
+   ExceptionSink xsink;
+   QoreProgram* pgm = new QoreProgram;
+   pgm->parse(code, "udp-bench", &xsink);
+   if (xsink) {
+      xsink.handleExceptions();
+      return 1;
+   }
+
+   static const int batches[] = { 1, 8, 64, 256 };
+   for (unsigned i = 0; i < sizeof(batches) / sizeof(int); ++i) {
+      ReferenceHolder<QoreListNode> args(new QoreListNode, &xsink);
+      args->push(new QoreBigIntNode(dgrams));
+      args->push(new QoreBigIntNode(size));
+      args->push(new QoreBigIntNode(batches[i]));
+
+      double start = now();
+      ReferenceHolder<AbstractQoreNode> rv(pgm->callFunction("run", *args, &xsink), &xsink);
+      double secs = now() - start;
+      if (xsink)
+         break;
+
+      int64 recv = rv ? rv->getAsBigInt() : 0;
+      printf("batch %3d: %8.2f ns/datagram, %8.2f Kdatagrams/s (%lld/%ld received)\n", batches[i],
+             secs * 1000000000.0 / recv, recv / secs / 1000.0, (long long)recv, dgrams);
+   }
+   xsink.handleExceptions();
+
+   pgm->waitForTerminationAndDeref(&xsink);
+   qore_cleanup();
+   return 0;
+}
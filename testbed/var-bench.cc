@@ -0,0 +1,102 @@
+// measures global variable read throughput with concurrent readers and an optional writer
+// usage: var-bench [iterations] [threads] [writer sleep us (0 = no writer)]
+
+#include <qore/Qore.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEF_ITERS 1000000
+
+static const char* code =
+   "our hash $config = (\"a\": 1, \"b\": \"two\", \"c\": (1, 2, 3));\n"
+   "our int $counter = 1;\n"
+   "int sub read_hash(int $n) { my int $rv; for (my int $i = 0; $i < $n; ++$i) $rv += $config.a; return $rv; }\n"
+   "int sub read_int(int $n) { my int $rv; for (my int $i = 0; $i < $n; ++$i) $rv += $counter; return $rv; }\n"
+   "sub write() { $config.a = 1; $counter = 1; }\n";
+
+static long iters = DEF_ITERS;
+static QoreProgram* pgm;
+static volatile bool done;
+
+static double now() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void call(const char* f, ExceptionSink& xsink) {
+   ReferenceHolder<QoreListNode> args(new QoreListNode, &xsink);
+   args->push(new QoreBigIntNode(iters));
+   discard(pgm->callFunction(f, *args, &xsink), &xsink);
+}
+
+static void* reader(void* arg) {
+   QoreForeignThreadHelper tfh;
+   ExceptionSink xsink;
+   call((const char*)arg, xsink);
+   return 0;
+}
+
+static void* writer(void* arg) {
+   QoreForeignThreadHelper tfh;
+   ExceptionSink xsink;
+   long us = (long)arg;
+   while (!done) {
+      discard(pgm->callFunction("write", 0, &xsink), &xsink);
+      usleep(us);
+   }
+   return 0;
+}
+
+static void run(const char* f, int threads, long us) {
+   pthread_t wtid;
+   done = false;
+   if (us)
+      pthread_create(&wtid, 0, writer, (void*)us);
+
+   pthread_t* ptid = new pthread_t[threads];
+   double start = now();
+   for (int i = 0; i < threads; ++i)
+      pthread_create(&ptid[i], 0, reader, (void*)f);
+   for (int i = 0; i < threads; ++i)
+      pthread_join(ptid[i], 0);
+   double secs = now() - start;
+   delete [] ptid;
+
+   done = true;
+   if (us)
+      pthread_join(wtid, 0);
+
+   printf("%-10s %3d threads: %8.2f ns/read, %8.2f Mreads/s total\n", f, threads,
+          secs * 1000000000.0 / iters, (double)iters * threads / secs / 1000000.0);
+}
+
+int main(int argc, char* argv[]) {
+   if (argc > 1)
+      iters = atol(argv[1]);
+   int threads = argc > 2 ? atoi(argv[2]) : 8;
+   long us = argc > 3 ? atol(argv[3]) : 0;
+
+   qore_init();
+
+   ExceptionSink xsink;
+   pgm = new QoreProgram;
+   pgm->parse(code, "var-bench", &xsink);
+   if (xsink) {
+      xsink.handleExceptions();
+      return 1;
+   }
+
+   for (int t = 1; t <= threads; t *= 2) {
+      run("read_hash", t, us);
+      run("read_int", t, us);
+   }
+
+   pgm->waitForTerminationAndDeref(&xsink);
+   qore_cleanup();
+   return 0;
+}